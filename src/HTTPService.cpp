@@ -4,16 +4,39 @@
 #include "Version.h"
 
 #include "util/debug.h"
+#include "util/GzipStream.h"
+#include "util/MemoryStats.h"
+#include <StreamString.h>
+#if defined(ESP32)
+#include <lwip/sockets.h>
+#endif
 
 static const char UserAgent[] PROGMEM = "influxdb-client-arduino/" INFLUXDB_CLIENT_VERSION " (" INFLUXDB_CLIENT_PLATFORM " " INFLUXDB_CLIENT_PLATFORM_VERSION ")";
+#if defined(INFLUXDB_CLIENT_HTTP_ACCEPT_ENCODING)
+// Accept-Encoding header HTTPClient sends by default
+static const char DefaultAcceptEncoding[] PROGMEM = "identity;q=1,chunked;q=0.1,*;q=0";
+#endif
 
 #if defined(ESP8266)         
 bool checkMFLN(BearSSL::WiFiClientSecure  *client, String url);
 #endif
 
+// Max TLS fragment length requested from server
+static const uint16_t MaxFragmentLength = 1024;
+
+// Estimated size of TLS buffers the secure client allocates, as they cannot be read from it
+#if defined(ESP8266)
+// BearSSL input and output buffers of default size or of negotiated fragment length, with record overhead
+static uint32_t tlsBuffersSize(uint16_t maxFragmentLength) { return maxFragmentLength ? 2*maxFragmentLength + 325 + 85 : 16709 + 597; }
+#else
+// mbedTLS input and output buffers of default size
+static uint32_t tlsBuffersSize(uint16_t) { return 16384 + 4096; }
+#endif
+
 // This cannot be put to PROGMEM due to the way how it is used
 static const char *RetryAfter = "Retry-After";
 const char *TransferEncoding = "Transfer-Encoding";
+const char *ContentEncoding = "Content-Encoding";
 
 HTTPService::HTTPService(ConnectionInfo *pConnInfo):_pConnInfo(pConnInfo) {
   _apiURL = pConnInfo->serverUrl;
@@ -32,7 +55,9 @@ HTTPService::HTTPService(ConnectionInfo *pConnInfo):_pConnInfo(pConnInfo) {
          wifiClientSec->setFingerprint(pConnInfo->certInfo);
       }
     }
-    checkMFLN(wifiClientSec, pConnInfo->serverUrl);
+    if(checkMFLN(wifiClientSec, pConnInfo->serverUrl)) {
+      _maxFragmentLength = MaxFragmentLength;
+    }
 #elif defined(ESP32)
     WiFiClientSecure *wifiClientSec = new WiFiClientSecure;  
     if (pConnInfo->insecure) {
@@ -45,8 +70,11 @@ HTTPService::HTTPService(ConnectionInfo *pConnInfo):_pConnInfo(pConnInfo) {
     }
 #endif    
     _wifiClient = wifiClientSec;
+    _secure = true;
+    _accounted = sizeof(*wifiClientSec) + tlsBuffersSize(_maxFragmentLength);
   } else {
     _wifiClient = new WiFiClient;
+    _accounted = sizeof(WiFiClient);
   }
   if(!_httpClient) {
     _httpClient = new HTTPClient;
@@ -54,9 +82,16 @@ HTTPService::HTTPService(ConnectionInfo *pConnInfo):_pConnInfo(pConnInfo) {
   _httpClient->setReuse(_pConnInfo->httpOptions._connectionReuse);
 
   _httpClient->setUserAgent(FPSTR(UserAgent));
+  _accounted += sizeof(HTTPService) + sizeof(HTTPClient);
+  MemoryAccounting::allocated(MemorySubsystem::Http, _accounted);
 };
 
+uint16_t HTTPService::getSendBlockSize() const { 
+  return _maxFragmentLength ? _maxFragmentLength : DefaultSendBlockSize; 
+}
+
 HTTPService::~HTTPService() {
+  abortRequest();
   if(_httpClient) {
     delete _httpClient;
     _httpClient = nullptr;
@@ -71,6 +106,7 @@ HTTPService::~HTTPService() {
     _cert = nullptr;
 }
 #endif
+  MemoryAccounting::released(MemorySubsystem::Http, _accounted);
 }
 
 
@@ -85,15 +121,13 @@ void HTTPService::setHTTPOptions() {
 #endif
 }
 
-// parse URL for host and port and call probeMaxFragmentLength
-#if defined(ESP8266)         
-bool checkMFLN(BearSSL::WiFiClientSecure  *client, String url) {
+// Parses URL for host, port and path
+static bool parseUrl(String url, String &host, uint16_t &port, String &path) {
     int index = url.indexOf(':');
-     if(index < 0) {
+    if(index < 0) {
         return false;
     }
     String protocol = url.substring(0, index);
-    int port = -1;
     url.remove(0, (index + 3)); // remove http:// or https://
 
     if (protocol == "http") {
@@ -106,8 +140,13 @@ bool checkMFLN(BearSSL::WiFiClientSecure  *client, String url) {
         return false;
     }
     index = url.indexOf('/');
-    String host = url.substring(0, index);
-    url.remove(0, index); // remove host 
+    if(index < 0) {
+        host = url;
+        path = "/";
+    } else {
+        host = url.substring(0, index);
+        path = url.substring(index);
+    }
     // check Authorization
     index = host.indexOf('@');
     if(index >= 0) {
@@ -121,17 +160,34 @@ bool checkMFLN(BearSSL::WiFiClientSecure  *client, String url) {
         portS.remove(0, (index + 1)); // remove hostname + :
         port = portS.toInt(); // get port
     }
+    return true;
+}
+
+// parse URL for host and port and call probeMaxFragmentLength
+#if defined(ESP8266)         
+bool checkMFLN(BearSSL::WiFiClientSecure  *client, String url) {
+    String host, path;
+    uint16_t port;
+    if(!parseUrl(url, host, port, path)) {
+        return false;
+    }
     INFLUXDB_CLIENT_DEBUG("[D] probeMaxFragmentLength to %s:%d\n", host.c_str(), port);
-    bool mfln = client->probeMaxFragmentLength(host, port, 1024);
+    bool mfln = client->probeMaxFragmentLength(host, port, MaxFragmentLength);
     INFLUXDB_CLIENT_DEBUG("[D]  MFLN:%s\n", mfln ? "yes" : "no");
     if (mfln) {
-        client->setBufferSizes(1024, 1024);
+        client->setBufferSizes(MaxFragmentLength, MaxFragmentLength);
     } 
     return mfln;
 }
 #endif //ESP8266
 
 bool HTTPService::beforeRequest(const char *url) {
+  if(_reqState != RequestState::Idle && _reqState != RequestState::Done) {
+    // blocking request cannot share connection with the asynchronous one
+    INFLUXDB_CLIENT_DEBUG("[W] Interrupting asynchronous request\n");
+    _wifiClient->stop();
+    endRequest(HTTPC_ERROR_CONNECTION_LOST);
+  }
    if(!_httpClient->begin(*_wifiClient, url)) {
     _pConnInfo->lastError = F("begin failed");
     return false;
@@ -139,12 +195,12 @@ bool HTTPService::beforeRequest(const char *url) {
   if(_pConnInfo->authToken.length() > 0) {
     _httpClient->addHeader(F("Authorization"), "Token " + _pConnInfo->authToken);
   }
-  const char * headerKeys[] = {RetryAfter, TransferEncoding} ;
-  _httpClient->collectHeaders(headerKeys, 2);
+  const char * headerKeys[] = {RetryAfter, TransferEncoding, ContentEncoding} ;
+  _httpClient->collectHeaders(headerKeys, 3);
   return true;
 }
 
-bool HTTPService::doPOST(const char *url, const char *data, const char *contentType, int expectedCode, httpResponseCallback cb) {
+bool HTTPService::doPOST(const char *url, const char *data, const char *contentType, int expectedCode, httpResponseCallback cb, const char *acceptEncoding) {
   INFLUXDB_CLIENT_DEBUG("[D] POST request - %s, data: %dbytes, type %s\n", url, strlen(data), contentType);
   if(!beforeRequest(url)) {
     return false;
@@ -152,11 +208,29 @@ bool HTTPService::doPOST(const char *url, const char *data, const char *contentT
   if(contentType) {
     _httpClient->addHeader(F("Content-Type"), FPSTR(contentType));
   }
+  if(acceptEncoding) {
+#if defined(INFLUXDB_CLIENT_HTTP_ACCEPT_ENCODING)
+    // request stays HTTP/1.1, connection is kept and chunked response is decoded before inflating
+    _httpClient->setAcceptEncoding(FPSTR(acceptEncoding));
+#else
+    // HTTPClient adds its own Accept-Encoding header to HTTP/1.1 requests, and servers usually take only the first one
+    _httpClient->useHTTP10(true);
+    _httpClient->addHeader(F("Accept-Encoding"), FPSTR(acceptEncoding));
+#endif
+  }
   _lastStatusCode = _httpClient->POST((uint8_t *) data, strlen(data));
+  if(acceptEncoding) {
+#if defined(INFLUXDB_CLIENT_HTTP_ACCEPT_ENCODING)
+    _httpClient->setAcceptEncoding(FPSTR(DefaultAcceptEncoding));
+#else
+    _httpClient->useHTTP10(false);
+    _httpClient->setReuse(_pConnInfo->httpOptions._connectionReuse);
+#endif
+  }
   return afterRequest(expectedCode, cb);
 }
 
-bool HTTPService::doPOST(const char *url, Stream *stream, const char *contentType, int expectedCode, httpResponseCallback cb) {
+bool HTTPService::doPOST(const char *url, Stream *stream, const char *contentType, int expectedCode, httpResponseCallback cb, const char *contentEncoding) {
   INFLUXDB_CLIENT_DEBUG("[D] POST request - %s, data: %dbytes, type %s\n", url, stream->available(), contentType);
   if(!beforeRequest(url)) {
     return false;
@@ -164,10 +238,364 @@ bool HTTPService::doPOST(const char *url, Stream *stream, const char *contentTyp
   if(contentType) {
     _httpClient->addHeader(F("Content-Type"), FPSTR(contentType));
   }
+  if(contentEncoding) {
+    _httpClient->addHeader(F("Content-Encoding"), FPSTR(contentEncoding));
+  }
   _lastStatusCode = _httpClient->sendRequest("POST", stream, stream->available());
   return afterRequest(expectedCode, cb);
 }
 
+bool HTTPService::startPOST(const char *url, Stream *stream, const char *contentType, int expectedCode, uint16_t connectTimeout, const char *contentEncoding) {
+  INFLUXDB_CLIENT_DEBUG("[D] Async POST request - %s, data: %dbytes, type %s\n", url, stream->available(), contentType);
+  if(_reqState != RequestState::Idle) {
+    _pConnInfo->lastError = F("Request in progress");
+    return false;
+  }
+  String path;
+  if(!parseUrl(url, _reqHost, _reqPort, path)) {
+    _pConnInfo->lastError = F("Invalid url");
+    return false;
+  }
+  _reqBuff = new uint8_t[getSendBlockSize()];
+  if(!_reqBuff) {
+    _pConnInfo->lastError = F("Not enough memory");
+    return false;
+  }
+  MemoryAccounting::allocated(MemorySubsystem::Http, getSendBlockSize());
+  _reqBody = stream;
+  _reqBodyLength = stream->available();
+  _reqHead = F("POST ");
+  _reqHead += path;
+  _reqHead += F(" HTTP/1.1\r\nHost: ");
+  _reqHead += _reqHost;
+  if(_reqPort != 80 && _reqPort != 443) {
+    _reqHead += ':';
+    _reqHead += _reqPort;
+  }
+  _reqHead += F("\r\nUser-Agent: ");
+  _reqHead += FPSTR(UserAgent);
+  _reqHead += _pConnInfo->httpOptions._connectionReuse ? F("\r\nConnection: keep-alive") : F("\r\nConnection: close");
+  if(_pConnInfo->authToken.length() > 0) {
+    _reqHead += F("\r\nAuthorization: Token ");
+    _reqHead += _pConnInfo->authToken;
+  }
+  if(contentType) {
+    _reqHead += F("\r\nContent-Type: ");
+    _reqHead += FPSTR(contentType);
+  }
+  if(contentEncoding) {
+    _reqHead += F("\r\nContent-Encoding: ");
+    _reqHead += FPSTR(contentEncoding);
+  }
+  _reqHead += F("\r\nContent-Length: ");
+  _reqHead += _reqBodyLength;
+  _reqHead += F("\r\n\r\n");
+  _reqExpectedCode = expectedCode;
+  _reqConnectTimeout = connectTimeout;
+  _reqSent = 0;
+  _reqBuffPos = 0;
+  _reqBuffLen = 0;
+  _reqStatus = 0;
+  _reqRetryAfter = 0;
+  _respRemaining = -1;
+  _respChunked = false;
+  _respClose = false;
+  _reqTime = millis();
+  _reqState = RequestState::Connect;
+  return true;
+}
+
+bool HTTPService::pollRequest(uint16_t budget) {
+  uint32_t start = millis();
+  while(_reqState != RequestState::Done) {
+    if(_reqState == RequestState::Idle) {
+      return true;
+    }
+    if(!stepRequest()) {
+      if(millis() - _reqTime > (uint32_t)_pConnInfo->httpOptions._httpReadTimeout) {
+        INFLUXDB_CLIENT_DEBUG("[E] Async request timeout\n");
+        endRequest(HTTPC_ERROR_READ_TIMEOUT);
+        continue;
+      }
+      if(budget) {
+        // nothing to do now, don't wait
+        return false;
+      }
+      delay(1);
+    } else {
+      _reqTime = millis();
+    }
+    if(budget && millis() - start >= budget) {
+      return false;
+    }
+  }
+  // report result, like afterRequest
+  _reqState = RequestState::Idle;
+  _lastStatusCode = _reqStatus;
+  _lastRequestTime = millis();
+  _lastRetryAfter = _reqStatus >= 429 ? _reqRetryAfter : 0;
+  INFLUXDB_CLIENT_DEBUG("[D] Async HTTP status code - %d\n", _lastStatusCode);
+  _pConnInfo->lastError = (char *)nullptr;
+  if(_reqStatus < 0) {
+    _pConnInfo->lastError = _httpClient->errorToString(_reqStatus);
+    INFLUXDB_CLIENT_DEBUG("[E] Error - %s\n", _pConnInfo->lastError.c_str());
+  } else if(_reqStatus != _reqExpectedCode) {
+    _pConnInfo->lastError = _reqResponse;
+    INFLUXDB_CLIENT_DEBUG("[D] Response:\n%s\n", _pConnInfo->lastError.c_str());
+  }
+  _reqResponse = (char *)nullptr;
+  return true;
+}
+
+bool HTTPService::stepRequest() {
+  switch(_reqState) {
+    case RequestState::Connect: {
+      if(_pConnInfo->httpOptions._connectionReuse && _wifiClient->connected()) {
+        // discard any leftovers of the previous response
+        while(_wifiClient->available()) {
+          _wifiClient->read();
+        }
+      } else {
+        INFLUXDB_CLIENT_DEBUG("[D] Connecting to %s:%d\n", _reqHost.c_str(), _reqPort);
+        _wifiClient->stop();
+#if defined(ESP32)
+#ifndef ARDUINO_ESP32_RELEASE_1_0_4
+        if(_secure) {
+          // TLS handshake would take up to 120s by default, it is limited like the TCP connect, in whole seconds
+          static_cast<WiFiClientSecure *>(_wifiClient)->setHandshakeTimeout((_reqConnectTimeout + 999)/1000);
+        }
+#endif
+        bool connected = _wifiClient->connect(_reqHost.c_str(), _reqPort, _reqConnectTimeout);
+#ifndef ARDUINO_ESP32_RELEASE_1_0_4
+        if(_secure) {
+          // restore default for requests of HTTPClient
+          static_cast<WiFiClientSecure *>(_wifiClient)->setHandshakeTimeout(120);
+        }
+#endif
+#else
+        _wifiClient->setTimeout(_reqConnectTimeout);
+        bool connected = _wifiClient->connect(_reqHost, _reqPort);
+#endif
+        if(!connected) {
+          endRequest(HTTPC_ERROR_CONNECTION_REFUSED);
+          return true;
+        }
+      }
+#if defined(ESP8266)
+      // restore timeout used by HTTPClient, writes are limited to the available space so they don't wait
+      _wifiClient->setTimeout(_pConnInfo->httpOptions._httpReadTimeout);
+#endif
+      _reqState = RequestState::SendHead;
+      return true;
+    }
+    case RequestState::SendHead:
+    case RequestState::SendBody: {
+      const uint8_t *data;
+      size_t len;
+      if(_reqState == RequestState::SendHead) {
+        data = (const uint8_t *)_reqHead.c_str() + _reqSent;
+        len = _reqHead.length() - _reqSent;
+      } else {
+        if(_reqBuffPos == _reqBuffLen) {
+          uint32_t rem = _reqBodyLength - _reqSent;
+          _reqBuffLen = _reqBody->readBytes((char *)_reqBuff, rem < getSendBlockSize() ? rem : getSendBlockSize());
+          _reqBuffPos = 0;
+          if(!_reqBuffLen) {
+            // body is shorter than announced
+            endRequest(HTTPC_ERROR_CONNECTION_LOST);
+            return true;
+          }
+        }
+        data = _reqBuff + _reqBuffPos;
+        len = _reqBuffLen - _reqBuffPos;
+      }
+#if defined(ESP8266)
+      size_t space = _wifiClient->availableForWrite();
+      if(len > space) {
+        len = space;
+      }
+      size_t written = len ? _wifiClient->write(data, len) : 0;
+#else
+      size_t written = 0;
+      if(len && !_secure) {
+        // WiFiClient::write waits up to seconds for free space of the socket, so the socket is written without waiting
+        int sent = ::send(_wifiClient->fd(), data, len, MSG_DONTWAIT);
+        written = sent > 0 ? sent : 0;
+      } else if(len) {
+        // WiFiClientSecure waits until the whole TLS record is sent, see WriteOptions::asyncWrite
+        written = _wifiClient->write(data, len);
+      }
+#endif
+      if(!written) {
+        if(!_wifiClient->connected()) {
+          endRequest(HTTPC_ERROR_CONNECTION_LOST);
+          return true;
+        }
+        return false;
+      }
+      if(_reqState == RequestState::SendHead) {
+        _reqSent += written;
+        if(_reqSent == _reqHead.length()) {
+          _reqHead = (char *)nullptr;
+          _reqSent = 0;
+          _reqState = _reqBodyLength ? RequestState::SendBody : RequestState::AwaitStatus;
+        }
+      } else {
+        _reqBuffPos += written;
+        _reqSent += written;
+        if(_reqSent == _reqBodyLength) {
+          freeRequestBuffer();
+          _reqState = RequestState::AwaitStatus;
+        }
+      }
+      return true;
+    }
+    case RequestState::AwaitStatus:
+    case RequestState::ReadHeaders:
+    case RequestState::ReadChunkSize:
+    case RequestState::ReadChunkEnd:
+    case RequestState::ReadTrailer:
+      if(!readLine()) {
+        if(!_wifiClient->available() && !_wifiClient->connected()) {
+          endRequest(HTTPC_ERROR_CONNECTION_LOST);
+          return true;
+        }
+        return false;
+      }
+      if(_reqState == RequestState::AwaitStatus) {
+        // HTTP/1.1 204 No Content
+        int i = _reqLine.indexOf(' ');
+        if(!_reqLine.startsWith(F("HTTP/")) || i < 0) {
+          endRequest(HTTPC_ERROR_CONNECTION_LOST);
+          return true;
+        }
+        _reqStatus = _reqLine.substring(i + 1).toInt();
+        _reqState = RequestState::ReadHeaders;
+      } else if(_reqState == RequestState::ReadHeaders) {
+        if(_reqLine.length()) {
+          processHeader();
+        } else if(_reqStatus == 204 || _reqStatus == 304 || (!_respChunked && _respRemaining == 0)) {
+          endRequest(_reqStatus);
+        } else {
+          _reqState = _respChunked ? RequestState::ReadChunkSize : RequestState::ReadBody;
+        }
+      } else if(_reqState == RequestState::ReadChunkSize) {
+        _respRemaining = strtol(_reqLine.c_str(), nullptr, 16);
+        _reqState = _respRemaining ? RequestState::ReadBody : RequestState::ReadTrailer;
+      } else if(_reqState == RequestState::ReadChunkEnd) {
+        _reqState = RequestState::ReadChunkSize;
+      } else if(!_reqLine.length()) {
+        endRequest(_reqStatus);
+      }
+      _reqLine = (char *)nullptr;
+      return true;
+    case RequestState::ReadBody: {
+      int avail = _wifiClient->available();
+      if(!avail) {
+        if(!_wifiClient->connected()) {
+          // body without length ends by closing connection
+          endRequest(_respRemaining < 0 ? _reqStatus : HTTPC_ERROR_CONNECTION_LOST);
+          return true;
+        }
+        return false;
+      }
+      char buff[65];
+      int n = avail < (int)sizeof(buff) - 1 ? avail : (int)sizeof(buff) - 1;
+      if(_respRemaining >= 0 && n > _respRemaining) {
+        n = _respRemaining;
+      }
+      n = _wifiClient->read((uint8_t *)buff, n);
+      if(n > 0) {
+        if(_reqStatus != _reqExpectedCode) {
+          buff[n] = 0;
+          _reqResponse += buff;
+        }
+        if(_respRemaining > 0) {
+          _respRemaining -= n;
+          if(!_respRemaining) {
+            if(_respChunked) {
+              _reqState = RequestState::ReadChunkEnd;
+            } else {
+              endRequest(_reqStatus);
+            }
+          }
+        }
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool HTTPService::readLine() {
+  while(_wifiClient->available()) {
+    int c = _wifiClient->read();
+    if(c == '\n') {
+      if(_reqLine.endsWith("\r")) {
+        _reqLine.remove(_reqLine.length() - 1);
+      }
+      return true;
+    }
+    // headers we need are short
+    if(_reqLine.length() < 200) {
+      _reqLine += (char)c;
+    }
+  }
+  return false;
+}
+
+void HTTPService::processHeader() {
+  int i = _reqLine.indexOf(':');
+  if(i < 0) {
+    return;
+  }
+  String name = _reqLine.substring(0, i);
+  String value = _reqLine.substring(i + 1);
+  value.trim();
+  if(name.equalsIgnoreCase(F("Content-Length"))) {
+    _respRemaining = value.toInt();
+  } else if(name.equalsIgnoreCase(TransferEncoding)) {
+    _respChunked = value.equalsIgnoreCase(F("chunked"));
+  } else if(name.equalsIgnoreCase(RetryAfter)) {
+    _reqRetryAfter = value.toInt();
+  } else if(name.equalsIgnoreCase(F("Connection"))) {
+    _respClose = value.equalsIgnoreCase(F("close"));
+  }
+}
+
+void HTTPService::endRequest(int statusCode) {
+  _reqStatus = statusCode;
+  _reqState = RequestState::Done;
+  if(statusCode < 0 || _respClose || !_pConnInfo->httpOptions._connectionReuse) {
+    _wifiClient->stop();
+  }
+  _reqHead = (char *)nullptr;
+  _reqLine = (char *)nullptr;
+  _reqBody = nullptr;
+  freeRequestBuffer();
+}
+
+void HTTPService::freeRequestBuffer() {
+  if(_reqBuff) {
+    delete [] _reqBuff;
+    _reqBuff = nullptr;
+    MemoryAccounting::released(MemorySubsystem::Http, getSendBlockSize());
+  }
+}
+
+void HTTPService::abortRequest() {
+  if(_reqState == RequestState::Idle) {
+    return;
+  }
+  if(_reqState != RequestState::Done) {
+    _wifiClient->stop();
+  }
+  endRequest(HTTPC_ERROR_CONNECTION_LOST);
+  _reqResponse = (char *)nullptr;
+  _reqState = RequestState::Idle;
+}
+
 bool HTTPService::doGET(const char *url, int expectedCode, httpResponseCallback cb) {
   INFLUXDB_CLIENT_DEBUG("[D] GET request - %s\n", url);
   if(!beforeRequest(url)) {
@@ -186,6 +614,23 @@ bool HTTPService::doDELETE(const char *url, int expectedCode, httpResponseCallba
   return afterRequest(expectedCode, cb, false);
 }
 
+void HTTPService::inflateError() {
+    StreamString compressed;
+    compressed += _pConnInfo->lastError;
+    // error messages are short
+    GunzipStream gunzip(&compressed, 1024);
+    _pConnInfo->lastError = (char *)nullptr;
+    char buff[65];
+    size_t n;
+    while((n = gunzip.readBytes(buff, sizeof(buff) - 1)) > 0) {
+        buff[n] = 0;
+        _pConnInfo->lastError += buff;
+    }
+    if(gunzip.getError() != GunzipError::None) {
+        _pConnInfo->lastError = F("Invalid compressed response");
+    }
+}
+
 bool HTTPService::afterRequest(int expectedStatusCode, httpResponseCallback cb,  bool modifyLastConnStatus) {
     if(modifyLastConnStatus) {
         _lastRequestTime = millis();
@@ -204,6 +649,9 @@ bool HTTPService::afterRequest(int expectedStatusCode, httpResponseCallback cb,
     if(!ret) {
         if(_lastStatusCode > 0) {
             _pConnInfo->lastError = _httpClient->getString();
+            if(_httpClient->header(ContentEncoding).equalsIgnoreCase("gzip")) {
+                inflateError();
+            }
             INFLUXDB_CLIENT_DEBUG("[D] Response:\n%s\n", _pConnInfo->lastError.c_str());
         } else {
             _pConnInfo->lastError = _httpClient->errorToString(_lastStatusCode);
@@ -44,6 +44,7 @@
 class Test;
 typedef std::function<bool(HTTPClient *client)> httpResponseCallback;
 extern const char *TransferEncoding;
+extern const char *ContentEncoding;
 
 struct ConnectionInfo {
     // Connection info
@@ -93,13 +94,70 @@ friend class Test;
 #endif
     // Store retry timeout suggested by server after last request
     int _lastRetryAfter = 0;     
+    // Negotiated TLS max fragment length, 0 if not negotiated
+    uint16_t _maxFragmentLength = 0;
+    // True if connection uses TLS
+    bool _secure = false;
+    // State of the asynchronous request
+    enum class RequestState : uint8_t { Idle, Connect, SendHead, SendBody, AwaitStatus, ReadHeaders, ReadBody, ReadChunkSize, ReadChunkEnd, ReadTrailer, Done };
+    RequestState _reqState = RequestState::Idle;
+    // Server host and port of the asynchronous request
+    String _reqHost;
+    uint16_t _reqPort = 0;
+    // Request line and headers, released when sent
+    String _reqHead;
+    // Number of bytes of the head or of the body already sent
+    uint32_t _reqSent = 0;
+    // Request body and its length
+    Stream *_reqBody = nullptr;
+    uint32_t _reqBodyLength = 0;
+    // Block of the body being sent
+    uint8_t *_reqBuff = nullptr;
+    uint16_t _reqBuffPos = 0;
+    uint16_t _reqBuffLen = 0;
+    int _reqExpectedCode = 0;
+    // Time of the last progress, for detecting timeout
+    uint32_t _reqTime = 0;
+    // Max time [ms] of a blocking connect 
+    uint16_t _reqConnectTimeout = 0;
+    // Response status code, or an error code
+    int _reqStatus = 0;
+    int _reqRetryAfter = 0;
+    // Response line being read
+    String _reqLine;
+    // Response body of a failed request
+    String _reqResponse;
+    // Remaining bytes of the response body or chunk, -1 if body ends by closing connection
+    int32_t _respRemaining = 0;
+    bool _respChunked = false;
+    bool _respClose = false;
+    // Bytes reported to memory accounting for the clients
+    uint32_t _accounted = 0;
    
 protected:
     // Sets request params
     bool beforeRequest(const char *url);
     // Handles response
     bool afterRequest(int expectedStatusCode, httpResponseCallback cb, bool modifyLastConnStatus = true);
+    // Decompresses error message in gzip compressed response
+    void inflateError();
+    // Performs a single step of the asynchronous request. Returns true if there was a progress.
+    bool stepRequest();
+    // Reads available chars of a response line. Returns true when the whole line was read.
+    bool readLine();
+    // Handles a response header line of the asynchronous request
+    void processHeader();
+    // Ends the asynchronous request with the status code and closes connection if it cannot be reused
+    void endRequest(int statusCode);
+    // Frees block of the request body
+    void freeRequestBuffer();
 public: 
+    // Size of the block in which HTTPClient sends a stream
+#ifdef HTTP_TCP_BUFFER_SIZE
+    static const uint16_t DefaultSendBlockSize = HTTP_TCP_BUFFER_SIZE;
+#else
+    static const uint16_t DefaultSendBlockSize = 1460;
+#endif
     // Creates HTTPService instance
     // serverUrl - url of the InfluxDB 2 server (e.g. http://localhost:8086)
     // authToken - InfluxDB 2 authorization token 
@@ -112,9 +170,24 @@ public:
     // Returns current HTTPOption
     HTTPOptions &getHTTPOptions() { return _pConnInfo->httpOptions; }
     // Performs HTTP POST by sending data. On success calls response call back  
-    bool doPOST(const char *url, const char *data, const char *contentType, int expectedCode, httpResponseCallback cb);
+    // acceptEncoding - if set, it is sent as Accept-Encoding header, e.g. gzip. Should be stored in PROGMEM.
+    bool doPOST(const char *url, const char *data, const char *contentType, int expectedCode, httpResponseCallback cb, const char *acceptEncoding = nullptr);
     // Performs HTTP POST by sending stream. On success calls response call back  
-    bool doPOST(const char *url, Stream *stream, const char *contentType, int expectedCode, httpResponseCallback cb);
+    // contentEncoding - if set, it is sent as Content-Encoding header, e.g. gzip. Should be stored in PROGMEM.
+    bool doPOST(const char *url, Stream *stream, const char *contentType, int expectedCode, httpResponseCallback cb, const char *contentEncoding = nullptr);
+    // Starts asynchronous HTTP POST sending stream, which is done by subsequent calls of pollRequest. Stream must be valid until request finishes.
+    // connectTimeout - max time [ms] of connecting to server, which cannot be split, including DNS lookup and TLS handshake.
+    // contentEncoding - if set, it is sent as Content-Encoding header, e.g. gzip. Should be stored in PROGMEM.
+    // Returns false if request cannot be started, check getLastErrorMessage() for an error.
+    bool startPOST(const char *url, Stream *stream, const char *contentType, int expectedCode, uint16_t connectTimeout, const char *contentEncoding = nullptr);
+    // Moves asynchronous request forward, working at most budget ms (0 - until request finishes). 
+    // It doesn't wait for data from server, it returns when there is nothing to read or no space for sending.
+    // Returns true when request has finished, then getLastStatusCode() and getLastErrorMessage() return its result.
+    bool pollRequest(uint16_t budget);
+    // Returns true if asynchronous request is in progress or its result was not collected by pollRequest yet
+    bool isRequestPending() const { return _reqState != RequestState::Idle; }
+    // Stops asynchronous request and closes connection. 
+    void abortRequest();
     // Performs HTTP GET. On success calls response call back    
     bool doGET(const char *url, int expectedCode, httpResponseCallback cb);
     // Performs HTTP DELETE. On success calls response call back    
@@ -129,6 +202,9 @@ public:
     uint32_t getLastRequestTime() const { return _lastRequestTime; }
     // Returns response of last failed call.
     String getLastErrorMessage() const { return _pConnInfo->lastError; }
+    // Returns size of blocks in which data is sent to server:
+    // the negotiated TLS max fragment length, or the HTTP client send buffer size
+    uint16_t getSendBlockSize() const;
     // Returns true if HTTP connection is kept open
     bool isConnected() const { return _httpClient && _httpClient->connected(); }
 };
@@ -30,7 +30,9 @@
 void InfluxData::setTimestamp(long int seconds) 
 { 
     _data->timestamp = timeStampToString(seconds,9);
+    _data->timestampSize = MaxNumberLength + 9 + 1;
     strcat(_data->timestamp, "000000000"); 
+    _data->account();
 }
 
  String InfluxData::toString() const { 
@@ -27,12 +27,30 @@
 #include "InfluxDbClient.h"
 #include "Platform.h"
 #include "Version.h"
+#include "util/GzipStream.h"
+#include "util/LineQueue.h"
+#include "util/WriterTask.h"
+#include "util/Aggregator.h"
+#include "util/ChangeFilter.h"
+#include "util/Mutex.h"
 
 #include "util/debug.h"
 
 static const char TooEarlyMessage[] PROGMEM = "Cannot send request yet because of applied retry strategy. Remaining ";
 
 static String escapeJSONString(const String &value);
+
+struct InfluxDBClient::WriterStatus {
+    // Guards the error and the retry wait
+    Mutex mutex;
+    String lastError;
+    // Retry wait in ms remaining at the start time
+    uint32_t retryStart = 0;
+    uint32_t retryRemaining = 0;
+    // Cleared by the task before it takes a line from the queue, set again when it publishes an empty buffer
+    std::atomic<bool> bufferEmpty;
+    WriterStatus():bufferEmpty(true) {}
+};
 static String precisionToString(WritePrecision precision, uint8_t version = 2) {
     switch(precision) {
         case WritePrecision::US:
@@ -120,27 +138,43 @@ bool InfluxDBClient::init() {
 
 
 InfluxDBClient::~InfluxDBClient() {
-     if(_writeBuffer) {
-        for(int i=0;i<_writeBufferSize;i++) {
-            delete _writeBuffer[i];
-        }
-        delete [] _writeBuffer;
-        _writeBuffer = nullptr;
-        _bufferPointer = 0;
-        _batchPointer = 0;
-        _bufferCeiling = 0;
-    }
+    stopWriterTask();
+    freeBuffer();
     clean();
+    for(int i=0;i<_aggregatorsCount;i++) {
+        delete _aggregators[i];
+    }
+    free(_aggregators);
+    delete _changeFilter;
+    removeWriteTargets();
+    for(int i=0;i<_bucketRoutesCount;i++) {
+        delete _bucketRoutes[i];
+    }
+    free(_bucketRoutes);
+    for(int i=0;i<_measurementRoutesCount;i++) {
+        delete _measurementRoutes[i];
+    }
+    free(_measurementRoutes);
 }
 
 void InfluxDBClient::clean() {
+    freeWriteSlots();
+    cleanTargets();
     if(_service) {
         delete _service;
         _service = nullptr;
     }
+    if(_queryService) {
+        delete _queryService;
+        _queryService = nullptr;
+        delete _queryConnInfo;
+        _queryConnInfo = nullptr;
+    }
     _buckets = nullptr;
     _lastFlushed = millis();
-    _retryTime = 0;
+    _retryDelay = 0;
+    _failedWrites = 0;
+    _queryRetryDelay = 0;
 }
 
 bool InfluxDBClient::setUrls() {
@@ -148,43 +182,61 @@ bool InfluxDBClient::setUrls() {
         return false;
     }
     INFLUXDB_CLIENT_DEBUG("[D] setUrls\n");
+    _writeUrl = createWriteUrl(_connInfo, _connInfo.bucket, _service);
+    INFLUXDB_CLIENT_DEBUG("[D]  writeUrl: %s\n", _writeUrl.c_str());
     if( _connInfo.dbVersion == 2) {
-        _writeUrl = _service->getServerAPIURL();
-        _writeUrl += "write?org=";
-        _writeUrl +=  urlEncode(_connInfo.org.c_str());
-        _writeUrl += "&bucket=";
-        _writeUrl += urlEncode(_connInfo.bucket.c_str());
-        INFLUXDB_CLIENT_DEBUG("[D]  writeUrl: %s\n", _writeUrl.c_str());
         _queryUrl = _service->getServerAPIURL();;
         _queryUrl += "query?org=";
         _queryUrl +=  urlEncode(_connInfo.org.c_str());
-        INFLUXDB_CLIENT_DEBUG("[D]  queryUrl: %s\n", _queryUrl.c_str());
     } else {
-        _writeUrl = _connInfo.serverUrl;
-        _writeUrl += "/write?db=";
-        _writeUrl += urlEncode(_connInfo.bucket.c_str());
         _queryUrl = _connInfo.serverUrl;
         _queryUrl += "/api/v2/query";
         if(_connInfo.user.length() > 0 && _connInfo.password.length() > 0) {
-            String auth = "&u=";
-            auth += urlEncode(_connInfo.user.c_str());
-            auth += "&p=";
-            auth += urlEncode(_connInfo.password.c_str());
-            _writeUrl += auth;  
-            _queryUrl += "?";
-            _queryUrl += auth;
+            _queryUrl += "?&u=";
+            _queryUrl += urlEncode(_connInfo.user.c_str());
+            _queryUrl += "&p=";
+            _queryUrl += urlEncode(_connInfo.password.c_str());
         }
-        INFLUXDB_CLIENT_DEBUG("[D]  writeUrl: %s\n", _writeUrl.c_str());
-        INFLUXDB_CLIENT_DEBUG("[D]  queryUrl: %s\n", _queryUrl.c_str());
     }
-    if(_writeOptions._writePrecision != WritePrecision::NoTime) {
-        _writeUrl += "&precision=";
-        _writeUrl += precisionToString(_writeOptions._writePrecision, _connInfo.dbVersion);
-        INFLUXDB_CLIENT_DEBUG("[D]  writeUrl: %s\n", _writeUrl.c_str());
+    INFLUXDB_CLIENT_DEBUG("[D]  queryUrl: %s\n", _queryUrl.c_str());
+    for(int i=0;i<_targetsCount;i++) {
+        if(_targets[i]->slot.service) {
+            // precision could change
+            _targets[i]->writeUrl = createWriteUrl(_targets[i]->connInfo, _targets[i]->connInfo.bucket, _targets[i]->slot.service);
+        }
+    }
+    for(int i=0;i<_bucketRoutesCount;i++) {
+        _bucketRoutes[i]->writeUrl = createWriteUrl(_connInfo, _bucketRoutes[i]->bucket, _service);
     }
     return true;
 }
 
+String InfluxDBClient::createWriteUrl(const ConnectionInfo &connInfo, const String &bucket, const HTTPService *service) const {
+    String url;
+    if(connInfo.dbVersion == 2) {
+        url = service->getServerAPIURL();
+        url += "write?org=";
+        url += urlEncode(connInfo.org.c_str());
+        url += "&bucket=";
+        url += urlEncode(bucket.c_str());
+    } else {
+        url = connInfo.serverUrl;
+        url += "/write?db=";
+        url += urlEncode(bucket.c_str());
+        if(connInfo.user.length() > 0 && connInfo.password.length() > 0) {
+            url += "&u=";
+            url += urlEncode(connInfo.user.c_str());
+            url += "&p=";
+            url += urlEncode(connInfo.password.c_str());
+        }
+    }
+    if(_writeOptions._writePrecision != WritePrecision::NoTime) {
+        url += "&precision=";
+        url += precisionToString(_writeOptions._writePrecision, connInfo.dbVersion);
+    }
+    return url;
+}
+
 bool InfluxDBClient::setWriteOptions(WritePrecision precision, uint16_t batchSize, uint16_t bufferSize, uint16_t flushInterval, bool preserveConnection) {
     if(!setWriteOptions(WriteOptions().writePrecision(precision).batchSize(batchSize).bufferSize(bufferSize).flushInterval(flushInterval))) {
         return false;
@@ -216,24 +268,85 @@ bool InfluxDBClient::setWriteOptions(const WriteOptions & writeOptions) {
         }
         writeBufferSizeChanges = true;
     }
+    if(_writeOptions._bufferBytes != writeOptions._bufferBytes) {
+        _writeOptions._bufferBytes = writeOptions._bufferBytes;
+        writeBufferSizeChanges = true;
+    }
+    _writeOptions._highWatermark = writeOptions._highWatermark;
+    _writeOptions._lowWatermark = writeOptions._lowWatermark;
     if(writeBufferSizeChanges) {
         resetBuffer();
     }
     _writeOptions._flushInterval = writeOptions._flushInterval;
+    _writeOptions._flushBytes = writeOptions._flushBytes;
+    _writeOptions._alignFlushBytes = writeOptions._alignFlushBytes;
     _writeOptions._retryInterval = writeOptions._retryInterval;
     _writeOptions._maxRetryInterval = writeOptions._maxRetryInterval;
     _writeOptions._maxRetryAttempts = writeOptions._maxRetryAttempts;
+    _writeOptions._retryMultiplier = writeOptions._retryMultiplier;
+    _writeOptions._retryJitter = writeOptions._retryJitter;
     _writeOptions._defaultTags = writeOptions._defaultTags;
     _writeOptions._useServerTimestamp = writeOptions._useServerTimestamp;
+    _writeOptions._compression = writeOptions._compression;
+    if(!writeOptions._asyncBudget || _writeOptions._maxInFlight != writeOptions._maxInFlight) {
+        completeAsyncWrite();
+        freeWriteSlots();
+    }
+    _writeOptions._maxInFlight = writeOptions._maxInFlight;
+    _writeOptions._asyncBudget = writeOptions._asyncBudget;
+    _writeOptions._asyncConnectTimeout = writeOptions._asyncConnectTimeout;
+    _writeOptions._minBatchSize = writeOptions._minBatchSize < _writeOptions._batchSize ? writeOptions._minBatchSize : _writeOptions._batchSize;
+    _writeOptions._targetRtt = writeOptions._targetRtt;
+    _writeOptions._overflowPolicy = writeOptions._overflowPolicy;
+    if(_writeOptions._changeFilterSize != writeOptions._changeFilterSize || _writeOptions._deadbandAbsolute != writeOptions._deadbandAbsolute
+        || _writeOptions._deadbandRelative != writeOptions._deadbandRelative || _writeOptions._heartbeatInterval != writeOptions._heartbeatInterval) {
+        // filter starts again with new settings
+        delete _changeFilter;
+        _changeFilter = nullptr;
+        _writeOptions._changeFilterSize = writeOptions._changeFilterSize;
+        _writeOptions._deadbandAbsolute = writeOptions._deadbandAbsolute;
+        _writeOptions._deadbandRelative = writeOptions._deadbandRelative;
+        _writeOptions._heartbeatInterval = writeOptions._heartbeatInterval;
+        if(_writeOptions._changeFilterSize) {
+            _changeFilter = new ChangeFilter(_writeOptions._changeFilterSize, _writeOptions._deadbandAbsolute, _writeOptions._deadbandRelative, _writeOptions._heartbeatInterval*1000UL);
+            if(!_changeFilter->isValid()) {
+                INFLUXDB_CLIENT_DEBUG("[E] Not enough memory for send-on-change filter\n");
+                delete _changeFilter;
+                _changeFilter = nullptr;
+            }
+        }
+    }
+    if(writeBufferSizeChanges || _currentBatchSize > _writeOptions._batchSize || _currentBatchSize < _writeOptions._minBatchSize) {
+        _currentBatchSize = _writeOptions._batchSize;
+    }
     return true;
 }
 
 bool InfluxDBClient::setHTTPOptions(const HTTPOptions & httpOptions) {
     _connInfo.httpOptions = httpOptions;
+    bool success = true;
+#if defined(INFLUXDB_CLIENT_GUNZIP_DISABLED)
+    if(httpOptions._queryCompression == Compression::Gzip) {
+        // server refers back up to 32KB, which doesn't fit into memory unless the window is defined explicitly
+        _connInfo.lastError = F("Query compression requires INFLUXDB_CLIENT_GUNZIP_WINDOW defined");
+        _connInfo.httpOptions._queryCompression = Compression::None;
+        success = false;
+    }
+#endif
+    if(_queryService) {
+        _queryConnInfo->httpOptions = _connInfo.httpOptions;
+        _queryService->setHTTPOptions();
+    }
     if(_service) {
         _service->setHTTPOptions();
     }
-    return true;
+    for(int i=0;i<_targetsCount;i++) {
+        _targets[i]->connInfo.httpOptions = httpOptions;
+        if(_targets[i]->slot.service) {
+            _targets[i]->slot.service->setHTTPOptions();
+        }
+    }
+    return success;
 }
 
 BucketsClient InfluxDBClient::getBucketsClient() {
@@ -246,13 +359,52 @@ BucketsClient InfluxDBClient::getBucketsClient() {
     return _buckets;
 }
 
-void InfluxDBClient::resetBuffer() {
+void InfluxDBClient::freeBuffer() {
+    freeWriteSlots();
+    for(int i=0;i<_targetsCount;i++) {
+        abortWrite(_targets[i]->slot);
+    }
     if(_writeBuffer) {
         for(int i=0;i<_writeBufferSize;i++) {
             delete _writeBuffer[i];
         }
         delete [] _writeBuffer;
+        _writeBuffer = nullptr;
+        delete [] _bufferScratch;
+        _bufferScratch = nullptr;
+        MemoryAccounting::released(MemorySubsystem::WriteBuffer, _writeBufferSize*(sizeof(Batch *) + sizeof(uint16_t)));
+    }
+    free(_lineBuffer);
+    MemoryAccounting::released(MemorySubsystem::WriteBuffer, _lineBufferSize);
+    _lineBuffer = nullptr;
+    _lineBufferSize = 0;
+    _lineBufferHead = 0;
+    _lineBufferTail = 0;
+    _lineBufferEnd = 0;
+    _bufferPointer = 0;
+    _batchPointer = 0;
+    _bufferCeiling = 0;
+    _bufferedPoints = 0;
+    _bufferedBytes = 0;
+    for(int i=0;i<3;i++) {
+        _oldestBatches[i] = nullptr;
+        _newestBatches[i] = nullptr;
+    }
+    _batchesCount = 0;
+    _linkedBatches = 0;
+    resetLanes();
+    resetDecimation();
+}
+
+void InfluxDBClient::resetDecimation() {
+    for(int i=0;i<3;i++) {
+        _decimation[i] = 0;
+        _decimationCounter[i] = 0;
     }
+}
+
+void InfluxDBClient::resetBuffer() {
+    freeBuffer();
     INFLUXDB_CLIENT_DEBUG("[D] Reset buffer: buffer Size: %d, batch size: %d\n", _writeOptions._bufferSize, _writeOptions._batchSize);
     uint16_t a = _writeOptions._bufferSize/_writeOptions._batchSize;
     //limit to max(byte)
@@ -262,23 +414,29 @@ void InfluxDBClient::resetBuffer() {
     }
     INFLUXDB_CLIENT_DEBUG("[D] Reset buffer: writeBuffSize: %d\n", _writeBufferSize);
     _writeBuffer = new Batch*[_writeBufferSize];
+    _bufferScratch = new uint16_t[_writeBufferSize];
+    MemoryAccounting::allocated(MemorySubsystem::WriteBuffer, _writeBufferSize*(sizeof(Batch *) + sizeof(uint16_t)));
     for(int i=0;i<_writeBufferSize;i++) {
         _writeBuffer[i] = nullptr;
     }
     _bufferPointer = 0;
     _batchPointer = 0;
     _bufferCeiling = 0;
+    checkWatermarks();
 }
 
 void InfluxDBClient::reserveBuffer(int size) {
     if(size > _writeBufferSize) {
         Batch **newBuffer = new Batch*[size];
         INFLUXDB_CLIENT_DEBUG("[D] Resizing buffer from %d to %d\n",_writeBufferSize, size);
-        for(int i=0;i<_bufferCeiling; i++) {
-            newBuffer[i] = _writeBuffer[i];
+        for(int i=0;i<size; i++) {
+            newBuffer[i] = i<_writeBufferSize?_writeBuffer[i]:nullptr;
         }
-        
+
         delete [] _writeBuffer;
+        delete [] _bufferScratch;
+        _bufferScratch = new uint16_t[size];
+        MemoryAccounting::resized(MemorySubsystem::WriteBuffer, _writeBufferSize*(sizeof(Batch *) + sizeof(uint16_t)), size*(sizeof(Batch *) + sizeof(uint16_t)));
         _writeBuffer = newBuffer;
         _writeBufferSize = size;
     }
@@ -286,14 +444,23 @@ void InfluxDBClient::reserveBuffer(int size) {
 
 void InfluxDBClient::addZerosToTimestamp(Point &point, int zeroes) {
     char *ts = point._data->timestamp, *s;
-    point._data->timestamp = new char[strlen(point._data->timestamp) + 1 + zeroes];
+    size_t len = strlen(ts);
+    if(len + zeroes < point._data->timestampSize) {
+        // fits into the memory of the timestamp
+        memset(ts + len, '0', zeroes);
+        ts[len + zeroes] = 0;
+        return;
+    }
+    point._data->timestamp = new char[len + 1 + zeroes];
     strcpy(point._data->timestamp, ts);
-    s = point._data->timestamp+strlen(ts);
+    s = point._data->timestamp+len;
     for(int i=0;i<zeroes;i++) {
         *s++ = '0';
     }
     *s = 0;
     delete [] ts;
+    point._data->timestampSize = len + 1 + zeroes;
+    point._data->account();
 }
 
 void InfluxDBClient::checkPrecisions(Point & point) {
@@ -316,275 +483,1896 @@ void InfluxDBClient::checkPrecisions(Point & point) {
     } 
 }
 
-bool InfluxDBClient::writePoint(Point & point) {
+bool InfluxDBClient::writePoint(Point & point, WritePriority priority) {
+    return writePointTo(point, -1, priority);
+}
+
+bool InfluxDBClient::writePoint(Point & point, const String &bucket, WritePriority priority) {
+    int16_t route = getBucketRoute(bucket);
+    if(route < 0) {
+        return false;
+    }
+    return writePointTo(point, route, priority);
+}
+
+bool InfluxDBClient::writePointTo(Point & point, int16_t route, WritePriority priority) {
     if (point.hasFields()) {
+        int16_t index = _aggregatorsCount ? findAggregator(point) : -1;
+        if(index >= 0) {
+            // point is written when the window ends
+            Aggregator *aggregator = _aggregators[index];
+            // window is also closed by poll or by other writing tasks
+            aggregator->lock();
+            uint32_t now = millis();
+            bool success = !aggregator->isDue(now) || writeAggregation(*aggregator, now);
+            aggregator->add(point, now, priority, route);
+            aggregator->unlock();
+            return success;
+        }
+        if(_writeOptions._changeFilterSize && !isPointChanged(point)) {
+            // unchanged point is not written
+            return true;
+        }
         checkPrecisions(point);
-        String line = pointToLineProtocol(point);
-        return writeRecord(line);
+        // line is encoded into the point, reusing its series prefix
+        return writeRecordTo(point.encodeLine(_writeOptions._defaultTags, _writeOptions._useServerTimestamp), route, priority);
     }
     return false;
 }
 
 
+bool InfluxDBClient::isPointChanged(const Point &point) {
+    // filter is created by setWriteOptions, so writing tasks share it
+    return !_changeFilter || _changeFilter->check(point, millis());
+}
 
-InfluxDBClient::Batch::Batch(uint16_t size):_size(size) {  
-    buffer = new char*[size]; 
-    for(int i=0;i< _size; i++) {
-        buffer[i] = nullptr; 
+uint32_t InfluxDBClient::getSuppressedPoints() const {
+    return _changeFilter ? _changeFilter->getSuppressed() : 0;
+}
+
+int16_t InfluxDBClient::findAggregator(const Point &point) const {
+    for(int i=0;i<_aggregatorsCount;i++) {
+        if(_aggregators[i]->matches(point)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool InfluxDBClient::aggregateSeries(const Point &series, uint32_t windowMs, AggregateFunction functions, int decimalPlaces) {
+    if(_writerTask) {
+        // writers look up series without locking
+        INFLUXDB_CLIENT_DEBUG("[E] Aggregation cannot be changed while the writer task runs\n");
+        return false;
+    }
+    int16_t index = findAggregator(series);
+    bool success = true;
+    if(index >= 0) {
+        Aggregator *aggregator = _aggregators[index];
+        if(aggregator->getPoints()) {
+            success = writeAggregation(*aggregator, millis());
+        }
+        delete aggregator;
+        _aggregators[index] = _aggregators[--_aggregatorsCount];
+    }
+    if(!windowMs) {
+        return success;
+    }
+    Aggregator **aggregators = (Aggregator **)realloc(_aggregators, (_aggregatorsCount + 1)*sizeof(Aggregator *));
+    if(!aggregators || _aggregatorsCount == 255) {
+        _connInfo.lastError = F("Not enough memory for aggregation");
+        return false;
+    }
+    _aggregators = aggregators;
+    _aggregators[_aggregatorsCount++] = new Aggregator(series, windowMs, functions, decimalPlaces);
+    INFLUXDB_CLIENT_DEBUG("[D] Aggregating series of %s in windows of %ums\n", series._data->measurement, windowMs);
+    return success;
+}
+
+bool InfluxDBClient::writeAggregation(Aggregator &aggregator, uint32_t now) {
+    WritePriority priority = aggregator.getPriority();
+    Point &point = aggregator.close(now, _writeOptions._writePrecision);
+    checkPrecisions(point);
+    return writeRecordTo(point.encodeLine(_writeOptions._defaultTags, _writeOptions._useServerTimestamp), aggregator.getRoute(), priority);
+}
+
+bool InfluxDBClient::writeAggregations() {
+    bool success = true;
+    uint32_t now = millis();
+    for(int i=0;i<_aggregatorsCount;i++) {
+        Aggregator *aggregator = _aggregators[i];
+        aggregator->lock();
+        if(aggregator->isDue(now)) {
+            success = writeAggregation(*aggregator, now) && success;
+        }
+        aggregator->unlock();
     }
+    return success;
+}
+
+InfluxDBClient::Batch::Batch(uint16_t size):_size(size) {  
+    lines = new Line[size]; 
+    MemoryAccounting::allocated(MemorySubsystem::WriteBuffer, sizeof(Batch) + size*sizeof(Line));
 }
 
 
 InfluxDBClient::Batch::~Batch() { 
-    clear();
-    delete [] buffer; 
-    buffer = nullptr;
+    delete [] lines; 
+    lines = nullptr;
+    MemoryAccounting::released(MemorySubsystem::WriteBuffer, sizeof(Batch) + _size*sizeof(Line));
 }
 
 void InfluxDBClient::Batch::clear() {
-    for(int i=0;i< _size; i++) {
-        free(buffer[i]);
-        buffer[i] = nullptr; 
-    }
+    pointer = 0;
+    length = 0;
+    retryCount = 0;
+    retryDelay = 0;
+    _closed = false;
 }
 
-bool InfluxDBClient::Batch::append(const char *line) {
-    if(pointer == _size) {
-        //overwriting, clean buffer
-        clear();
-        pointer = 0;
-    } 
-    buffer[pointer] = strdup(line);
+uint32_t InfluxDBClient::Batch::getRetryRemaining() const {
+    uint32_t elapsed = millis() - retryStart;
+    return elapsed < retryDelay ? retryDelay - elapsed : 0;
+}
+
+bool InfluxDBClient::Batch::append(uint32_t offset, uint32_t length) {
+    lines[pointer].offset = offset;
+    lines[pointer].length = length;
+    this->length += length;
     ++pointer;
     return isFull();
 }
 
-char * InfluxDBClient::Batch::createData() {
-     int length = 0; 
-     char *buff = nullptr;
-     for(int c=0; c < pointer; c++) {
-        length += strlen(buffer[c]);
-        yield();
-    }
+char * InfluxDBClient::Batch::createData(const char *data) {
+    char *buff = nullptr;
     //create buffer for all lines including new line char and terminating char
     if(length) {
-        buff = new char[length + pointer + 1];
+        buff = new char[dataLength() + 1];
         if(buff) {
-            buff[0] = 0;
+            MemoryAccounting::allocated(MemorySubsystem::WriteBuffer, dataLength() + 1);
+            char *d = buff;
             for(int c=0; c < pointer; c++) {
-                strcat(buff+strlen(buff), buffer[c]);
-                strcat(buff+strlen(buff), "\n");
-                yield();
+                memcpy(d, data + lines[c].offset, lines[c].length);
+                d += lines[c].length;
+                *d++ = '\n';
+                if(c % 64 == 63) {
+                    yield();
+                }
             }
+            *d = 0;
         }
     }
     return buff;
 }
 
-bool InfluxDBClient::writeRecord(const String &record) {
-    return writeRecord(record.c_str());
+bool InfluxDBClient::allocLine(uint32_t length, uint32_t &offset, uint8_t current) {
+    bool compacted = false;
+    while(true) {
+        if(_lineBufferHead >= _lineBufferTail) { 
+            // data are in a single block, try space after it
+            if(length <= _lineBufferSize - _lineBufferHead) {
+                offset = _lineBufferHead;
+                _lineBufferHead += length;
+                return true;
+            }
+            // or continue from the beginning 
+            if(length < _lineBufferTail) {
+                _lineBufferEnd = _lineBufferHead;
+                offset = 0;
+                _lineBufferHead = length;
+                return true;
+            }
+        } else if(_lineBufferHead + length < _lineBufferTail) { 
+            // data continue from the beginning, there is only space between head and tail
+            offset = _lineBufferHead;
+            _lineBufferHead += length;
+            return true;
+        }
+        if(!compacted) {
+            compacted = true;
+            if(_bufferedBytes < getLineBufferUsed()) {
+                // batches written out of order left unused space
+                compactLineBuffer();
+                continue;
+            }
+        }
+        if(_writeOptions._bufferBytes && _lineBufferSize == _writeOptions._bufferBytes) {
+            if(length > _lineBufferSize) {
+                return false;
+            }
+            if(!dropOldestBatch(current)) {
+                return false;
+            }
+        } else if(!growLineBuffer(length)) {
+            return false;
+        }
+    }
 }
 
-bool InfluxDBClient::writeRecord(const char *record) {    
-    if(!_writeBuffer[_bufferPointer]) {
-        _writeBuffer[_bufferPointer] = new Batch(_writeOptions._batchSize);
+bool InfluxDBClient::growLineBuffer(uint32_t length) {
+    bool wrapped = _lineBufferHead < _lineBufferTail;
+    // required size to keep current data in a single block and append a new line
+    uint32_t required = (wrapped?_lineBufferEnd:0) + _lineBufferHead + length;
+    uint32_t size = _lineBufferSize + _lineBufferSize/2;
+    if(size < required) {
+        size = required;
     }
-    if(isBufferFull() && _batchPointer <= _bufferPointer) {
-        // When we are overwriting buffer and nothing is written, batchPointer must point to the oldest point
-        _batchPointer = _bufferPointer+1;
-        if(_batchPointer == _writeBufferSize) {
-            _batchPointer = 0;
+    if(size < 256) {
+        size = 256;
+    }
+    if(_writeOptions._bufferBytes) {
+        // allocate whole memory at once
+        if(required > _writeOptions._bufferBytes) {
+            return false;
         }
+        size = _writeOptions._bufferBytes;
     }
-    if(_writeBuffer[_bufferPointer]->append(record)) { //we reached batch size
-        _bufferPointer++;
-        if(_bufferPointer == _writeBufferSize) { // writeBuffer is full
-            _bufferPointer = 0;
-            INFLUXDB_CLIENT_DEBUG("[W] Reached write buffer size, old points will be overwritten\n");
-        } 
-
-        if(_bufferCeiling < _writeBufferSize) {
-            _bufferCeiling++;
+    INFLUXDB_CLIENT_DEBUG("[D] Resizing write buffer memory from %u to %u\n", _lineBufferSize, size);
+    char *buff = (char *)realloc(_lineBuffer, size);
+    if(!buff && size > required) {
+        // try at least the minimal size
+        size = required;
+        buff = (char *)realloc(_lineBuffer, size);
+    }
+    if(!buff) {
+        INFLUXDB_CLIENT_DEBUG("[E] Cannot allocate write buffer memory of %u bytes\n", size);
+        return false;
+    }
+    MemoryAccounting::resized(MemorySubsystem::WriteBuffer, _lineBufferSize, size);
+    _lineBuffer = buff;
+    _lineBufferSize = size;
+    for(int i=0;i<_writeSlotsCount;i++) {
+        if(_writeSlots[i].streamer) {
+            _writeSlots[i].streamer->setData(_lineBuffer);
         }
-    } 
-    INFLUXDB_CLIENT_DEBUG("[D] writeRecord: bufferPointer: %d, batchPointer: %d, _bufferCeiling: %d\n", _bufferPointer, _batchPointer, _bufferCeiling);    
-    return checkBuffer();
+    }
+    for(int i=0;i<_targetsCount;i++) {
+        if(_targets[i]->slot.streamer) {
+            _targets[i]->slot.streamer->setData(_lineBuffer);
+        }
+    }
+    if(wrapped) {
+        // move lines from the beginning after the lines at the top
+        memcpy(_lineBuffer + _lineBufferEnd, _lineBuffer, _lineBufferHead);
+        for(int i=0;i<_writeBufferSize;i++) {
+            Batch *batch = _writeBuffer[i];
+            if(batch) {
+                for(int j=0;j<batch->pointer;j++) {
+                    if(batch->lines[j].offset < _lineBufferTail) {
+                        batch->lines[j].offset += _lineBufferEnd;
+                    }
+                }
+            }
+        }
+        _lineBufferHead += _lineBufferEnd;
+    }
+    return true;
 }
 
-bool InfluxDBClient::checkBuffer() {
-    // in case we (over)reach batchSize with non full buffer
-    bool bufferReachedBatchsize = _writeBuffer[_batchPointer] && _writeBuffer[_batchPointer]->isFull();
-    // or flush interval timed out
-    bool flushTimeout = _writeOptions._flushInterval > 0 && ((millis() - _lastFlushed)/1000) >= _writeOptions._flushInterval; 
+void InfluxDBClient::releaseBatch(Batch *batch) {
+    for(int i=0;i<_writeSlotsCount;i++) {
+        if(_writeSlots[i].index >= 0 && _writeBuffer[_writeSlots[i].index] == batch) {
+            // points being written are overwritten
+            abortWrite(_writeSlots[i]);
+        }
+    }
+    for(int i=0;i<_targetsCount;i++) {
+        WriteSlot &slot = _targets[i]->slot;
+        if(slot.index >= 0 && _writeBuffer[slot.index] == batch) {
+            abortWrite(slot);
+        }
+    }
+    if(batch->isEmpty()) {
+        batch->clear();
+        return;
+    }
+    _bufferedPoints -= batch->pointer;
+    _bufferedBytes -= batch->dataLength();
+    unlinkBatch(batch);
+    // tail moves only when its line is released
+    bool tail = batch->lines[0].offset == _lineBufferTail;
+    batch->clear();
+    if(tail) {
+        updateLineBufferTail();
+    }
+}
 
-    INFLUXDB_CLIENT_DEBUG("[D] Flushing buffer: is oversized %s, is timeout %s, is buffer full %s\n", 
-        bool2string(bufferReachedBatchsize),bool2string(flushTimeout), bool2string(isBufferFull()));
-    
-    if(bufferReachedBatchsize || flushTimeout || isBufferFull() ) {
-        
-       return flushBufferInternal(!flushTimeout);
-    } 
-    return true;
+void InfluxDBClient::linkBatch(Batch *batch) {
+    uint8_t p = (uint8_t)batch->priority;
+    batch->older = _newestBatches[p];
+    batch->newer = nullptr;
+    if(_newestBatches[p]) {
+        _newestBatches[p]->newer = batch;
+    } else {
+        _oldestBatches[p] = batch;
+    }
+    _newestBatches[p] = batch;
+    _linkedBatches++;
 }
 
-bool InfluxDBClient::flushBuffer() {
-    return flushBufferInternal(false);
+void InfluxDBClient::unlinkBatch(Batch *batch) {
+    uint8_t p = (uint8_t)batch->priority;
+    if(batch->older) {
+        batch->older->newer = batch->newer;
+    } else {
+        _oldestBatches[p] = batch->newer;
+    }
+    if(batch->newer) {
+        batch->newer->older = batch->older;
+    } else {
+        _newestBatches[p] = batch->older;
+    }
+    batch->older = nullptr;
+    batch->newer = nullptr;
+    _linkedBatches--;
 }
 
-uint32_t InfluxDBClient::getRemainingRetryTime() {
-    uint32_t rem = 0;
-    if(_retryTime > 0) {
-        int32_t diff = _retryTime - (millis()-_service->getLastRequestTime())/1000;
-        rem  =  diff<0?0:(uint32_t)diff;
+int16_t InfluxDBClient::findEvictedBatch(int16_t keep) const {
+    for(int p=0;p<3;p++) {
+        Batch *batch = _oldestBatches[p];
+        if(batch && batch->index == keep) {
+            batch = batch->newer;
+        }
+        if(batch) {
+            return batch->index;
+        }
     }
-    return rem;
+    return -1;
 }
 
-bool InfluxDBClient::flushBufferInternal(bool flashOnlyFull) {
-    uint32_t rwt = getRemainingRetryTime();
-    if(rwt > 0) {
-        INFLUXDB_CLIENT_DEBUG("[W] Cannot write yet, pause %ds, %ds yet\n", _retryTime, rwt);
-        // retry after period didn't run out yet
-        _connInfo.lastError = FPSTR(TooEarlyMessage);
-        _connInfo.lastError += String(rwt);
-        _connInfo.lastError += "s";
+bool InfluxDBClient::dropOldestBatch(uint8_t current) {
+    WritePriority priority = _writeBuffer[current]->priority;
+    if(_writeOptions._overflowPolicy == OverflowPolicy::Decimate && decimateBuffer(priority, current)) {
+        compactLineBuffer();
+        return true;
+    }
+    int16_t oldest = findEvictedBatch(current);
+    if(oldest >= 0 && (_writeBuffer[oldest]->priority > priority 
+        || (_writeBuffer[oldest]->priority == priority && _writeOptions._overflowPolicy == OverflowPolicy::DropNewest))) {
+        // points of higher priority are kept, or new points are rejected
+        oldest = -1;
+    }
+    if(oldest < 0 && _writeOptions._overflowPolicy == OverflowPolicy::DropNewest) {
         return false;
     }
-    char *data;
-    bool success = true;
-    // send all batches, It could happen there was long network outage and buffer is full
-    while(_writeBuffer[_batchPointer] && (!flashOnlyFull ||  _writeBuffer[_batchPointer]->isFull())) {
-        if(!_writeBuffer[_batchPointer]->isFull() && _writeBuffer[_batchPointer]->retryCount == 0 ) { //do not increase pointer in case of retrying
-            // points will be written so increase _bufferPointer as it happen when buffer is flushed when is full
-            if(++_bufferPointer == _writeBufferSize) {
-                _bufferPointer = 0;
-            }
-        }
+    Batch *dropped = _writeBuffer[oldest >= 0 ? oldest : current];
+    if(dropped->isEmpty()) {
+        return false;
+    }
+    _droppedPoints += dropped->pointer;
+    // memory is released only from the tail, lines after it must be moved
+    bool compact = dropped->lines[0].offset != _lineBufferTail;
+    if(oldest == _batchPointer) {
+        INFLUXDB_CLIENT_DEBUG("[W] Reached write buffer memory size, old points will be overwritten\n");
+        dropCurrentBatch();
+    } else if(oldest >= 0) {
+        releaseBatch(_writeBuffer[oldest]);
+    } else {
+        // the only batch is the one being filled
+        INFLUXDB_CLIENT_DEBUG("[W] Reached write buffer memory size, points of current batch will be overwritten\n");
+        releaseBatch(_writeBuffer[current]);
+    }
+    if(compact) {
+        compactLineBuffer();
+    }
+    return true;
+}
 
-        INFLUXDB_CLIENT_DEBUG("[D] Writing batch, batchpointer: %d, size %d\n", _batchPointer, _writeBuffer[_batchPointer]->pointer);
-        if(!_writeBuffer[_batchPointer]->isEmpty()) {
-            int statusCode = 0;
-            if(_streamWrite) {
-                statusCode = postData(_writeBuffer[_batchPointer]);
-            } else {
-                data = _writeBuffer[_batchPointer]->createData();
-                statusCode = postData(data);
-                delete [] data;
-            }
-            // retry on unsuccessfull connection or retryable status codes
-            bool retry = (statusCode < 0 || statusCode >= 429) && _writeOptions._maxRetryAttempts > 0;
-            success = statusCode >= 200 && statusCode < 300;
-            // advance even on message failure x e <300;429)
-            if(success || !retry) {
-                _lastFlushed = millis();
-                dropCurrentBatch();
-            } else if(retry) {
-                _writeBuffer[_batchPointer]->retryCount++;
-                if(statusCode > 0) { //apply retry strategy only in case of HTTP errors
-                    if(_writeBuffer[_batchPointer]->retryCount > _writeOptions._maxRetryAttempts) {
-                        INFLUXDB_CLIENT_DEBUG("[D] Reached max retry count, dropping batch\n");
-                        dropCurrentBatch();
-                    }
-                    if(!_retryTime) {
-                        _retryTime = _writeOptions._retryInterval;
-                        if(_writeBuffer[_batchPointer]) {
-                            for(int i=1;i<_writeBuffer[_batchPointer]->retryCount;i++) {
-                                _retryTime *= _writeOptions._retryInterval;
-                            }
-                            if(_retryTime > _writeOptions._maxRetryInterval) {
-                                _retryTime = _writeOptions._maxRetryInterval;
-                            }
-                        }
-                    }
-                } 
-                INFLUXDB_CLIENT_DEBUG("[D] Leaving data in buffer for retry, retryInterval: %d\n",_retryTime);
-                // in case of retryable failure break loop
-                break;
+void InfluxDBClient::compactLineBuffer() {
+    // lines of each batch are in the order of allocation, merging batches by distance from the tail moves each line only towards the tail
+    uint16_t *next = _bufferScratch;
+    for(int i=0;i<_writeBufferSize;i++) {
+        next[i] = 0;
+    }
+    uint32_t tail = _lineBufferTail;
+    uint32_t end = _lineBufferHead < _lineBufferTail ? _lineBufferEnd : _lineBufferSize;
+    uint32_t head = tail;
+    bool wrapped = false;
+    while(true) {
+        int16_t first = -1;
+        uint32_t firstDistance = 0;
+        for(int i=0;i<_writeBufferSize;i++) {
+            Batch *batch = _writeBuffer[i];
+            if(batch && next[i] < batch->pointer) {
+                uint32_t offset = batch->lines[next[i]].offset;
+                uint32_t distance = offset >= tail ? offset - tail : end - tail + offset;
+                if(first == -1 || distance < firstDistance) {
+                    first = i;
+                    firstDistance = distance;
+                }
             }
         }
-       yield();
+        if(first == -1) {
+            break;
+        }
+        Line &line = _writeBuffer[first]->lines[next[first]++];
+        uint32_t length = line.length + 1;
+        if(!wrapped && head + length > _lineBufferSize) {
+            // continue from the beginning
+            _lineBufferEnd = head;
+            head = 0;
+            wrapped = true;
+        }
+        if(line.offset != head) {
+            memmove(_lineBuffer + head, _lineBuffer + line.offset, length);
+            line.offset = head;
+        }
+        head += length;
     }
-    //Have we emptied the buffer?
-    INFLUXDB_CLIENT_DEBUG("[D] Success: %d, _bufferPointer: %d, _batchPointer: %d, _writeBuffer[_bufferPointer]_%p\n",success,_bufferPointer,_batchPointer, _writeBuffer[_bufferPointer]);
-    if(_batchPointer == _bufferPointer && !_writeBuffer[_bufferPointer]) {
-        _bufferPointer = 0;
-        _batchPointer = 0;
-        _bufferCeiling = 0;
-        INFLUXDB_CLIENT_DEBUG("[D] Buffer empty\n");
+    _lineBufferHead = head;
+}
+
+uint32_t InfluxDBClient::getLineBufferUsed() const {
+    if(_lineBufferHead < _lineBufferTail) {
+        return _lineBufferEnd - _lineBufferTail + _lineBufferHead;
     }
-    return success;
+    return _lineBufferHead - _lineBufferTail;
 }
 
-void  InfluxDBClient::dropCurrentBatch() {
-    delete _writeBuffer[_batchPointer];
-    _writeBuffer[_batchPointer] = nullptr;
-    _batchPointer++;
-    //did we got over top?
-    if(_batchPointer == _writeBufferSize) {
-        // restart _batchPointer in ring buffer from start
-        _batchPointer = 0;
-        // we reached buffer size, that means buffer was full and now lower ceiling 
-        _bufferCeiling = _bufferPointer;
+uint8_t InfluxDBClient::getBufferUsage() const {
+    uint32_t used, size;
+    if(_writeOptions._bufferBytes) {
+        used = getLineBufferUsed();
+        size = _writeOptions._bufferBytes;
+    } else {
+        used = _bufferedPoints;
+        size = _writeBufferSize*_writeOptions._batchSize;
     }
-    INFLUXDB_CLIENT_DEBUG("[D] Dropped batch, batchpointer: %d\n", _batchPointer);
+    return size?(uint8_t)((uint64_t)used*100/size):0;
 }
 
-String InfluxDBClient::pointToLineProtocol(const Point& point) {
-    return point.createLineProtocol(_writeOptions._defaultTags, _writeOptions._useServerTimestamp);
+void InfluxDBClient::checkWatermarks() {
+    uint8_t usage = getBufferUsage();
+    if(!_aboveHighWatermark && usage >= _writeOptions._highWatermark) {
+        INFLUXDB_CLIENT_DEBUG("[W] Write buffer usage %d%% reached high watermark\n", usage);
+        _aboveHighWatermark = true;
+        if(_watermarkCallback) {
+            _watermarkCallback(true);
+        }
+    } else if(_aboveHighWatermark && usage <= _writeOptions._lowWatermark) {
+        INFLUXDB_CLIENT_DEBUG("[D] Write buffer usage %d%% dropped to low watermark\n", usage);
+        _aboveHighWatermark = false;
+        if(_watermarkCallback) {
+            _watermarkCallback(false);
+        }
+    }
 }
 
-bool InfluxDBClient::validateConnection() {
-    if(!_service && !init()) {
-        return false;
+void InfluxDBClient::updateLineBufferTail() {
+    // lines of a batch are in the order of allocation, the new tail is the first line nearest to the old one
+    uint32_t end = _lineBufferHead < _lineBufferTail ? _lineBufferEnd : _lineBufferSize;
+    bool found = false;
+    uint32_t tail = 0, tailDistance = 0;
+    for(int i=0;i<_writeBufferSize;i++) {
+        Batch *batch = _writeBuffer[i];
+        if(batch && !batch->isEmpty()) {
+            uint32_t offset = batch->lines[0].offset;
+            uint32_t distance = offset >= _lineBufferTail ? offset - _lineBufferTail : end - _lineBufferTail + offset;
+            if(!found || distance < tailDistance) {
+                found = true;
+                tail = offset;
+                tailDistance = distance;
+            }
+        }
     }
-    // on version 1.x /ping will by default return status code 204, without verbose
-    String url = _connInfo.serverUrl + (_connInfo.dbVersion==2?"/health":"/ping?verbose=true");
-    if(_connInfo.dbVersion==1 && _connInfo.user.length() > 0 && _connInfo.password.length() > 0) {
-        url += "&u=";
-        url += urlEncode(_connInfo.user.c_str());
-        url += "&p=";
-        url += urlEncode(_connInfo.password.c_str());
+    if(found) {
+        _lineBufferTail = tail;
+    } else {
+        _lineBufferHead = 0;
+        _lineBufferTail = 0;
     }
-    INFLUXDB_CLIENT_DEBUG("[D] Validating connection to %s\n", url.c_str());
+}
 
-    bool ret = _service->doGET(url.c_str(), 200, nullptr);
-    if(!ret) {
-        INFLUXDB_CLIENT_DEBUG("[D] error %d: %s\n", _service->getLastStatusCode(), _service->getLastErrorMessage().c_str());
-    }
-    return ret;
+bool InfluxDBClient::writeRecord(const String &record, WritePriority priority) {
+    return writeRecord(record.c_str(), priority);
 }
 
-int InfluxDBClient::postData(const char *data) {
-    if(!_service && !init()) {
-        return 0;
-    }
-    if(data) {
-        INFLUXDB_CLIENT_DEBUG("[D] Writing to %s\n", _writeUrl.c_str());
-        INFLUXDB_CLIENT_DEBUG("[D] Sending:\n%s\n", data);       
-        if(!_service->doPOST(_writeUrl.c_str(), data, PSTR("text/plain"), 204, nullptr)) {
-            INFLUXDB_CLIENT_DEBUG("[D] error %d: %s\n", _service->getLastStatusCode(), _service->getLastErrorMessage().c_str());
-        }
-        _retryTime = _service->getLastRetryAfter();
-        return _service->getLastStatusCode();
-    } 
-    return 0;
+bool InfluxDBClient::writeRecord(const char *record, WritePriority priority) {    
+    return writeRecordTo(record, -1, priority);
 }
 
-int InfluxDBClient::postData(Batch *batch) {
-    if(!_service && !init()) {
-        return 0;
-    }
+bool InfluxDBClient::writeRecord(const String &record, const String &bucket, WritePriority priority) {
+    return writeRecord(record.c_str(), bucket, priority);
+}
 
-    BatchStreamer *bs = new BatchStreamer(batch);
-    INFLUXDB_CLIENT_DEBUG("[D] Writing to %s\n", _writeUrl.c_str());
-    INFLUXDB_CLIENT_DEBUG("[D] Sending %d:\n", bs->available());       
-    
-    if(!_service->doPOST(_writeUrl.c_str(), bs, PSTR("text/plain"), 204, nullptr)) {
-        INFLUXDB_CLIENT_DEBUG("[D] error %d: %s\n", _service->getLastStatusCode(), _service->getLastErrorMessage().c_str());
+bool InfluxDBClient::writeRecord(const char *record, const String &bucket, WritePriority priority) {
+    int16_t route = getBucketRoute(bucket);
+    if(route < 0) {
+        return false;
     }
-    delete bs;
-    _retryTime = _service->getLastRetryAfter();
-    return _service->getLastStatusCode();
+    return writeRecordTo(record, route, priority);
+}
+
+bool InfluxDBClient::writeRecordTo(const char *record, int16_t route, WritePriority priority) {
+    uint32_t length = strlen(record);
+    if(route < 0) {
+        route = _measurementRoutesCount ? findMeasurementRoute(record) : 0;
+    }
+    if(_lineQueue) {
+        // writer task buffers the line, route is passed along with the priority
+        return _lineQueue->push(record, length, (uint8_t)priority | route << 2);
+    }
+    if(!bufferRecord(record, length, priority, route)) {
+        return false;
+    }
+    return checkBufferInternal();
+}
+
+int16_t InfluxDBClient::getBucketRoute(const String &bucket) {
+    if(bucket == _connInfo.bucket) {
+        return 0;
+    }
+    for(int i=0;i<_bucketRoutesCount;i++) {
+        if(_bucketRoutes[i]->bucket == bucket) {
+            return i + 1;
+        }
+    }
+    if(_writerTask) {
+        // writers look up routes without locking, error is not set as the task can set it meanwhile
+        INFLUXDB_CLIENT_DEBUG("[E] Bucket %s was not added before starting the writer task\n", bucket.c_str());
+        return -1;
+    }
+    if(bucket.length() == 0 || _bucketRoutesCount == 7) {
+        _connInfo.lastError = bucket.length() ? F("Too many buckets") : F("Invalid bucket");
+        return -1;
+    }
+    BucketRoute **routes = (BucketRoute **)realloc(_bucketRoutes, (_bucketRoutesCount + 1)*sizeof(BucketRoute *));
+    if(!routes) {
+        _connInfo.lastError = F("Not enough memory for bucket");
+        return -1;
+    }
+    _bucketRoutes = routes;
+    BucketRoute *route = new BucketRoute();
+    route->bucket = bucket;
+    if(_service) {
+        route->writeUrl = createWriteUrl(_connInfo, bucket, _service);
+    }
+    _bucketRoutes[_bucketRoutesCount++] = route;
+    INFLUXDB_CLIENT_DEBUG("[D] Added bucket route %d: %s\n", _bucketRoutesCount, bucket.c_str());
+    return _bucketRoutesCount;
+}
+
+bool InfluxDBClient::addBucket(const String &bucket) {
+    return getBucketRoute(bucket) >= 0;
+}
+
+bool InfluxDBClient::routeMeasurement(const String &measurement, const String &bucket) {
+    if(_writerTask) {
+        // writers check rules without locking
+        INFLUXDB_CLIENT_DEBUG("[E] Measurement routes cannot be changed while the writer task runs\n");
+        return false;
+    }
+    int16_t route = getBucketRoute(bucket);
+    if(route < 0) {
+        return false;
+    }
+    bool prefix = measurement.endsWith("*");
+    // lines start with escaped measurement
+    char *escaped = escapeKey(prefix ? measurement.substring(0, measurement.length() - 1) : measurement, false);
+    for(int i=0;i<_measurementRoutesCount;i++) {
+        MeasurementRoute *rule = _measurementRoutes[i];
+        if(rule->prefix == prefix && rule->measurement == escaped) {
+            // measurement is routed to another bucket
+            rule->route = route;
+            delete [] escaped;
+            return true;
+        }
+    }
+    MeasurementRoute **rules = (MeasurementRoute **)realloc(_measurementRoutes, (_measurementRoutesCount + 1)*sizeof(MeasurementRoute *));
+    if(!rules || _measurementRoutesCount == 255) {
+        delete [] escaped;
+        _connInfo.lastError = F("Not enough memory for measurement route");
+        return false;
+    }
+    _measurementRoutes = rules;
+    MeasurementRoute *rule = new MeasurementRoute();
+    rule->measurement = escaped;
+    rule->prefix = prefix;
+    rule->route = route;
+    _measurementRoutes[_measurementRoutesCount++] = rule;
+    delete [] escaped;
+    return true;
+}
+
+uint8_t InfluxDBClient::findMeasurementRoute(const char *line) const {
+    // measurement ends with the first unescaped comma or space
+    size_t length = 0;
+    while(line[length] && line[length] != ',' && line[length] != ' ') {
+        if(line[length] == '\\' && line[length + 1]) {
+            length++;
+        }
+        length++;
+    }
+    for(int i=0;i<_measurementRoutesCount;i++) {
+        const MeasurementRoute *rule = _measurementRoutes[i];
+        size_t ruleLength = rule->measurement.length();
+        if((rule->prefix ? ruleLength <= length : ruleLength == length) && !strncmp(line, rule->measurement.c_str(), ruleLength)) {
+            return rule->route;
+        }
+    }
+    return 0;
+}
+
+void InfluxDBClient::resetLanes() {
+    for(int r=0;r<=_bucketRoutesCount;r++) {
+        for(int i=0;i<3;i++) {
+            laneBatch((WritePriority)i, r) = -1;
+        }
+    }
+}
+
+int16_t InfluxDBClient::getLaneBatch(WritePriority priority, uint8_t route) {
+    int16_t index = laneBatch(priority, route);
+    if(index >= 0 && !isBatchEmpty(index) && !_writeBuffer[index]->isFull() && _writeBuffer[index]->priority == priority && _writeBuffer[index]->route == route) {
+        return index;
+    }
+    return -1;
+}
+
+void InfluxDBClient::swapBatches(uint8_t a, uint8_t b) {
+    Batch *batch = _writeBuffer[a];
+    _writeBuffer[a] = _writeBuffer[b];
+    _writeBuffer[b] = batch;
+    if(_writeBuffer[a]) {
+        _writeBuffer[a]->index = a;
+    }
+    if(batch) {
+        batch->index = b;
+    }
+    // writes and lanes follow their batches
+    for(int i=0;i<_writeSlotsCount;i++) {
+        if(_writeSlots[i].index == a) {
+            _writeSlots[i].index = b;
+        } else if(_writeSlots[i].index == b) {
+            _writeSlots[i].index = a;
+        }
+    }
+    for(int i=0;i<_targetsCount;i++) {
+        int16_t &index = _targets[i]->slot.index;
+        if(index == a) {
+            index = b;
+        } else if(index == b) {
+            index = a;
+        }
+    }
+    for(int r=0;r<=_bucketRoutesCount;r++) {
+        for(int i=0;i<3;i++) {
+            int16_t &lane = laneBatch((WritePriority)i, r);
+            if(lane == a) {
+                lane = b;
+            } else if(lane == b) {
+                lane = a;
+            }
+        }
+    }
+}
+
+bool InfluxDBClient::decimateBuffer(WritePriority priority, int16_t keep) {
+    int16_t lowest = findEvictedBatch(keep);
+    if(lowest < 0 || _writeBuffer[lowest]->priority > priority) {
+        return false;
+    }
+    WritePriority lane = _writeBuffer[lowest]->priority;
+    // batches of the lowest priority, which are not being written and go to the same bucket and targets, from the oldest one.
+    // Each pass halves the points and the rate of new ones, so the buffer fills again only after as many points as were kept
+    uint8_t pending = _writeBuffer[lowest]->pending;
+    uint8_t route = _writeBuffer[lowest]->route;
+    uint16_t *order = _bufferScratch;
+    uint8_t count = 0;
+    uint32_t points = 0;
+    for(Batch *batch = _writeBuffer[lowest]; batch; batch = batch->newer) {
+        if(batch->index == keep || batch->pending != pending || batch->route != route || findWriteSlot(batch->index) || isTargetWriting(batch->index)) {
+            continue;
+        }
+        order[count++] = batch->index;
+        points += batch->pointer;
+    }
+    if(points < 2) {
+        return false;
+    }
+    // keep every other point, packed into the oldest batches. Lines are only moved back, so they are not overwritten before read
+    uint8_t target = 0;
+    uint16_t pointer = 0;
+    uint32_t length = 0;
+    uint32_t n = 0;
+    for(int i=0;i<count;i++) {
+        Batch *batch = _writeBuffer[order[i]];
+        uint16_t lines = batch->pointer;
+        for(int j=0;j<lines;j++) {
+            Line line = batch->lines[j];
+            if(n++ & 1) {
+                _bufferedBytes -= line.length + 1;
+                continue;
+            }
+            Batch *packed = _writeBuffer[order[target]];
+            if(pointer == packed->getSize()) {
+                packed->pointer = pointer;
+                packed->length = length;
+                packed = _writeBuffer[order[++target]];
+                pointer = 0;
+                length = 0;
+            }
+            packed->lines[pointer++] = line;
+            length += line.length;
+        }
+    }
+    Batch *last = _writeBuffer[order[target]];
+    last->pointer = pointer;
+    last->length = length;
+    if(!last->isFull()) {
+        // last batch doesn't continue with new points
+        last->close();
+        if(order[target] == _bufferPointer) {
+            advanceBufferPointer();
+        }
+    }
+    for(int i=target+1;i<count;i++) {
+        unlinkBatch(_writeBuffer[order[i]]);
+        _writeBuffer[order[i]]->clear();
+    }
+    _bufferedPoints -= n/2;
+    _droppedPoints += n/2;
+    updateLineBufferTail();
+    uint8_t &level = _decimation[(uint8_t)lane];
+    if(level < 15) {
+        level++;
+    }
+    // point being buffered is the kept one of its lane
+    _decimationCounter[(uint8_t)lane] = lane == priority ? 1 : 0;
+    INFLUXDB_CLIENT_DEBUG("[W] Write buffer is full, decimated points of priority %d, keeping every %d. point\n", (uint8_t)lane, 1 << level);
+    return true;
+}
+
+int16_t InfluxDBClient::claimBatch(WritePriority priority, uint8_t route) {
+    if(!isBatchEmpty(_bufferPointer) && !_writeBuffer[_bufferPointer]->isFull() 
+        && (_writeBuffer[_bufferPointer]->priority != priority || _writeBuffer[_bufferPointer]->route != route)) {
+        // batch of another priority or bucket is being filled, it stays open behind the buffer pointer
+        advanceBufferPointer();
+    }
+    if(!_writeBuffer[_bufferPointer]) {
+        _writeBuffer[_bufferPointer] = new Batch(_writeOptions._batchSize);
+        _writeBuffer[_bufferPointer]->index = _bufferPointer;
+        _batchesCount++;
+    }
+    Batch *batch = _writeBuffer[_bufferPointer];
+    bool overwrite = !batch->isEmpty() && (batch->isFull() || batch->priority != priority || batch->route != route);
+    bool moved = false;
+    if(overwrite && _writeOptions._overflowPolicy == OverflowPolicy::Decimate && decimateBuffer(priority, -1)) {
+        // decimation can close the batch at the buffer pointer and move it
+        batch = _writeBuffer[_bufferPointer];
+        overwrite = !batch->isEmpty() && (batch->isFull() || batch->priority != priority || batch->route != route);
+    }
+    if(overwrite) {
+        // buffer is full
+        int16_t empty = -1;
+        // searched only if there is an empty batch
+        for(int i=0;i<_writeBufferSize && empty == -1 && _batchesCount > _linkedBatches;i++) {
+            if(i != _bufferPointer && _writeBuffer[i] && _writeBuffer[i]->isEmpty()) {
+                empty = i;
+            }
+        }
+        if(empty >= 0) {
+            // batch written ahead of older ones or decimation left free place, batch at the buffer pointer is moved there
+            swapBatches(empty, _bufferPointer);
+            moved = true;
+        } else {
+            // points of the lowest priority are overwritten first
+            int16_t evicted = findEvictedBatch(-1);
+            WritePriority evictedPriority = _writeBuffer[evicted]->priority;
+            if(evictedPriority > priority || (evictedPriority == priority && _writeOptions._overflowPolicy == OverflowPolicy::DropNewest)) {
+                _droppedPoints++;
+                _connInfo.lastError = evictedPriority > priority ? F("Write buffer is full of points of higher priority") : F("Write buffer is full");
+                return -1;
+            }
+            _droppedPoints += _writeBuffer[evicted]->pointer;
+            if(evicted != _bufferPointer) {
+                // batch at the buffer pointer is kept, it is moved to the place of the overwritten one
+                releaseBatch(_writeBuffer[evicted]);
+                swapBatches(evicted, _bufferPointer);
+                moved = true;
+            }
+        }
+        if(moved) {
+            batch = _writeBuffer[_bufferPointer];
+            overwrite = false;
+        }
+    }
+    if(isBufferFull() && _batchPointer <= _bufferPointer) {
+        if(!moved) {
+            // batch being written is not the oldest anymore
+            abortAsyncWrite();
+        }
+        // When we are overwriting buffer and nothing is written, batchPointer must point to the oldest point
+        _batchPointer = _bufferPointer+1;
+        if(_batchPointer == _writeBufferSize) {
+            _batchPointer = 0;
+        }
+    }
+    if(overwrite) {
+        //overwriting, release the oldest lines
+        releaseBatch(batch);
+    }
+    batch->priority = priority;
+    batch->route = route;
+    laneBatch(priority, route) = _bufferPointer;
+    return _bufferPointer;
+}
+
+bool InfluxDBClient::bufferRecord(const char *record, uint32_t length, WritePriority priority, uint8_t route) {
+    uint8_t level = _decimation[(uint8_t)priority];
+    if(level && (_decimationCounter[(uint8_t)priority]++ & ((1u << level) - 1))) {
+        // decimated buffer keeps every 2^level-th point
+        _droppedPoints++;
+        return true;
+    }
+    uint32_t flushBytes = getFlushBytes();
+    int16_t index = getLaneBatch(priority, route);
+    if(index >= 0 && flushBytes && _writeBuffer[index]->dataLength() + length + 1 > flushBytes) {
+        // the line would not fit into the encoded batch size, close the batch
+        _writeBuffer[index]->close();
+        if(index == _bufferPointer) {
+            advanceBufferPointer();
+        }
+        index = -1;
+    }
+    if(index < 0) {
+        index = claimBatch(priority, route);
+        if(index < 0) {
+            return false;
+        }
+    }
+    Batch *batch = _writeBuffer[index];
+    uint32_t offset;
+    if(!allocLine(length + 1, offset, index)) {
+        _droppedPoints++;
+        _connInfo.lastError = F("Not enough memory for write buffer");
+        return false;
+    }
+    memcpy(_lineBuffer + offset, record, length + 1);
+    if(batch->isEmpty()) {
+        batch->sequence = _batchSequence++;
+        // added targets mirror only the default bucket
+        batch->pending = route ? 1 : getTargetsMask();
+        linkBatch(batch);
+    }
+    _bufferedPoints++;
+    _bufferedBytes += length + 1;
+    batch->append(offset, length);
+    if(flushBytes && batch->dataLength() >= flushBytes) { 
+        // we reached the encoded batch size
+        batch->close();
+    }
+    if(_writeOptions._minBatchSize && batch->pointer >= _currentBatchSize) {
+        // we reached the adapted batch size
+        batch->close();
+    }
+    if(batch->isFull() && index == _bufferPointer) { //we reached batch size
+        advanceBufferPointer();
+    } 
+    INFLUXDB_CLIENT_DEBUG("[D] writeRecord: bufferPointer: %d, batchPointer: %d, _bufferCeiling: %d\n", _bufferPointer, _batchPointer, _bufferCeiling);    
+    checkWatermarks();
+    return true;
+}
+
+void InfluxDBClient::drainLineQueue() {
+    int32_t length;
+    while((length = _lineQueue->frontLength()) >= 0) {
+        if(_writerStatus) {
+            // cleared before the line leaves the queue, so isBufferEmpty doesn't miss it
+            _writerStatus->bufferEmpty = false;
+        }
+        if((uint32_t)length + 1 > _queueLineSize) {
+            char *line = (char *)realloc(_queueLine, length + 1);
+            if(!line) {
+                // line is dropped, otherwise following lines would wait behind it forever
+                INFLUXDB_CLIENT_DEBUG("[E] Not enough memory for queued line of %d bytes\n", length);
+                _lineQueue->pop(nullptr);
+                _droppedPoints++;
+                continue;
+            }
+            _queueLine = line;
+            _queueLineSize = length + 1;
+        }
+        // tag holds the priority and the bucket route
+        uint8_t tag = _lineQueue->frontTag();
+        _lineQueue->pop(_queueLine);
+        _queueLine[length] = 0;
+        bufferRecord(_queueLine, length, (WritePriority)(tag & 3), tag >> 2);
+    }
+}
+
+bool InfluxDBClient::startWriterTask(uint32_t queueBytes, uint16_t intervalMs) {
+    if(_writerTask) {
+        return true;
+    }
+    if(!WriterTask::isSupported()) {
+        _connInfo.lastError = F("Writer task is not supported");
+        return false;
+    }
+    _lineQueue = new LineQueue(queueBytes);
+    _writerStatus = new WriterStatus();
+    publishWriterStatus();
+    _writerTask = new WriterTask();
+    if(!_lineQueue->isValid() || !_writerTask->start([this]() {
+            drainLineQueue();
+            checkBufferInternal();
+            publishWriterStatus();
+        }, intervalMs)) {
+        _connInfo.lastError = F("Cannot start writer task");
+        delete _writerTask;
+        _writerTask = nullptr;
+        delete _lineQueue;
+        _lineQueue = nullptr;
+        delete _writerStatus;
+        _writerStatus = nullptr;
+        return false;
+    }
+    INFLUXDB_CLIENT_DEBUG("[D] Started writer task, queue: %u bytes, interval: %ums\n", queueBytes, intervalMs);
+    return true;
+}
+
+void InfluxDBClient::stopWriterTask() {
+    if(!_writerTask) {
+        return;
+    }
+    _writerTask->stop();
+    delete _writerTask;
+    _writerTask = nullptr;
+    delete _writerStatus;
+    _writerStatus = nullptr;
+    drainLineQueue();
+    delete _lineQueue;
+    _lineQueue = nullptr;
+    free(_queueLine);
+    _queueLine = nullptr;
+    _queueLineSize = 0;
+}
+
+void InfluxDBClient::callWriter(const std::function<void()> &work) {
+    if(_writerTask) {
+        _writerTask->call(work);
+    } else {
+        work();
+    }
+}
+
+void InfluxDBClient::publishWriterStatus() {
+    if(!_writerStatus) {
+        return;
+    }
+    uint32_t retryRemaining = getRetryRemainingInternal();
+    _writerStatus->mutex.lock();
+    _writerStatus->lastError = _connInfo.lastError;
+    _writerStatus->retryStart = millis();
+    _writerStatus->retryRemaining = retryRemaining;
+    _writerStatus->mutex.unlock();
+    _writerStatus->bufferEmpty = _bufferCeiling == 0 && isBatchEmpty(0);
+}
+
+uint32_t InfluxDBClient::getWriterQueueDropped() const {
+    return _lineQueue ? _lineQueue->getDropped() : 0;
+}
+
+bool InfluxDBClient::isBufferEmpty() const { 
+    if(!_writerStatus) {
+        return _bufferCeiling == 0 && isBatchEmpty(0);
+    }
+    // flag is cleared before a line leaves the queue
+    return _lineQueue->isEmpty() && _writerStatus->bufferEmpty.load();
+}
+
+String InfluxDBClient::getLastErrorMessage() const {
+    if(!_writerStatus) {
+        return _connInfo.lastError;
+    }
+    // writer task can set error meanwhile, the copy it published is read
+    _writerStatus->mutex.lock();
+    String error = _writerStatus->lastError;
+    _writerStatus->mutex.unlock();
+    return error;
+}
+
+bool InfluxDBClient::addWriteTarget(const String &serverUrl, const String &org, const String &bucket, const String &authToken, const char *certInfo) {
+    bool success = false;
+    // writer task, if running, uses targets and sets errors
+    callWriter([&]() {
+        success = addWriteTargetInternal(serverUrl, org, bucket, authToken, certInfo);
+        publishWriterStatus();
+    });
+    return success;
+}
+
+bool InfluxDBClient::addWriteTargetInternal(const String &serverUrl, const String &org, const String &bucket, const String &authToken, const char *certInfo) {
+    if(serverUrl.length() == 0 || org.length() == 0 || bucket.length() == 0 || authToken.length() == 0 || !serverUrl.startsWith("http")) {
+        _connInfo.lastError = F("Invalid parameters");
+        return false;
+    }
+    if(_targetsCount == 7) {
+        // pending targets of a batch are bits of a byte
+        _connInfo.lastError = F("Too many write targets");
+        return false;
+    }
+    WriteTarget **targets = (WriteTarget **)realloc(_targets, (_targetsCount + 1)*sizeof(WriteTarget *));
+    if(!targets) {
+        _connInfo.lastError = F("Not enough memory for write target");
+        return false;
+    }
+    _targets = targets;
+    WriteTarget *target = new WriteTarget();
+    target->connInfo.serverUrl = serverUrl.endsWith("/") ? serverUrl.substring(0, serverUrl.length() - 1) : serverUrl;
+    target->connInfo.org = org;
+    target->connInfo.bucket = bucket;
+    target->connInfo.authToken = authToken;
+    target->connInfo.certInfo = certInfo;
+    target->connInfo.dbVersion = 2;
+    target->connInfo.insecure = false;
+    _targets[_targetsCount++] = target;
+    INFLUXDB_CLIENT_DEBUG("[D] Added write target %d: %s, bucket %s\n", _targetsCount, serverUrl.c_str(), bucket.c_str());
+    return true;
+}
+
+void InfluxDBClient::removeWriteTargets() {
+    if(!_targetsCount) {
+        return;
+    }
+    callWriter([this]() {
+        cleanTargets();
+        for(int i=0;i<_targetsCount;i++) {
+            delete _targets[i];
+        }
+        free(_targets);
+        _targets = nullptr;
+        _targetsCount = 0;
+        if(_writeBuffer) {
+            for(int i=0;i<_writeBufferSize;i++) {
+                if(!isBatchEmpty(i) && !(_writeBuffer[i]->pending &= 1)) {
+                    // already written to the server
+                    dropBatch(i);
+                }
+            }
+            checkBufferEmpty();
+            checkWatermarks();
+        }
+        publishWriterStatus();
+    });
+}
+
+uint8_t InfluxDBClient::getPendingBatches(uint8_t target) const {
+    uint8_t count = 0;
+    if(_writeBuffer) {
+        for(int i=0;i<_writeBufferSize;i++) {
+            if(!isBatchEmpty(i) && (_writeBuffer[i]->pending & (1 << target))) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+int InfluxDBClient::getLastStatusCode(uint8_t target) const {
+    if(target == 0) {
+        return getLastStatusCode();
+    }
+    if(target > _targetsCount || !_targets[target - 1]->slot.service) {
+        return 0;
+    }
+    return _targets[target - 1]->slot.service->getLastStatusCode();
+}
+
+String InfluxDBClient::getLastErrorMessage(uint8_t target) const {
+    if(target == 0) {
+        return getLastErrorMessage();
+    }
+    if(target > _targetsCount) {
+        return "";
+    }
+    return _targets[target - 1]->connInfo.lastError;
+}
+
+void InfluxDBClient::advanceBufferPointer() {
+    _bufferPointer++;
+    if(_bufferPointer == _writeBufferSize) { // writeBuffer is full
+        _bufferPointer = 0;
+        INFLUXDB_CLIENT_DEBUG("[W] Reached write buffer size, old points will be overwritten\n");
+    } 
+
+    if(_bufferCeiling < _writeBufferSize) {
+        _bufferCeiling++;
+    }
+}
+
+uint32_t InfluxDBClient::getFlushBytes() const {
+    uint32_t flushBytes = _writeOptions._flushBytes;
+    // compressed body is shorter than lines, so it cannot be aligned by their size
+    if(flushBytes && _writeOptions._alignFlushBytes && _writeOptions._compression == Compression::None) {
+        // before connecting, MFLN is not known yet, align to the send buffer size 
+        uint32_t block = _service ? _service->getSendBlockSize() : HTTPService::DefaultSendBlockSize;
+        if(flushBytes > block) {
+            flushBytes -= flushBytes % block;
+        }
+    }
+    return flushBytes;
+}
+
+bool InfluxDBClient::isFlushDue(bool &flushTimeout) {
+    // in case we (over)reach batchSize with non full buffer
+    bool bufferReachedBatchsize = hasFullBatch();
+    // or flush interval timed out
+    flushTimeout = _writeOptions._flushInterval > 0 && ((millis() - _lastFlushed)/1000) >= _writeOptions._flushInterval; 
+
+    INFLUXDB_CLIENT_DEBUG("[D] Flushing buffer: is oversized %s, is timeout %s, is buffer full %s\n", 
+        bool2string(bufferReachedBatchsize),bool2string(flushTimeout), bool2string(isBufferFull()));
+    
+    return bufferReachedBatchsize || flushTimeout || isBufferFull();
+}
+
+bool InfluxDBClient::checkBuffer() {
+    bool success = !_aggregatorsCount || writeAggregations();
+    if(_writerTask) {
+        // writer task checks buffer
+        return success;
+    }
+    return checkBufferInternal() && success;
+}
+
+bool InfluxDBClient::checkBufferInternal() {
+    if(_writeOptions._asyncBudget) {
+        return pollInternal();
+    }
+    bool flushTimeout;
+    if(isFlushDue(flushTimeout)) {
+       return flushBufferInternal(!flushTimeout);
+    } 
+    return true;
+}
+
+bool InfluxDBClient::poll() {
+    bool success = !_aggregatorsCount || writeAggregations();
+    if(_writerTask) {
+        return success;
+    }
+    return checkBufferInternal() && success;
+}
+
+bool InfluxDBClient::pollInternal() {
+    uint32_t start = millis();
+    bool success = true;
+    String error;
+    while(true) {
+        bool flushTimeout;
+        // use all free slots
+        while(isFlushDue(flushTimeout) && startAsyncWrite(!flushTimeout)) {
+        }
+        if(_targetsCount && isFlushDue(flushTimeout)) {
+            startTargetWrites(!flushTimeout);
+        }
+        uint32_t elapsed = millis() - start;
+        if(elapsed >= _writeOptions._asyncBudget || (!getPendingWrites() && !hasTargetWrites())) {
+            break;
+        }
+        bool progress = false;
+        success = pollAsyncWrites(_writeOptions._asyncBudget - elapsed, progress, error) && success;
+        if(!progress) {
+            break;
+        }
+    }
+    if(!success) {
+        _connInfo.lastError = error;
+    }
+    return success;
+}
+
+int16_t InfluxDBClient::nextBatchToWrite(bool onlyFull, uint8_t target) const {
+    for(int p=2;p>=0;p--) {
+        // oldest batch of the priority, ready to be written
+        for(Batch *batch = _oldestBatches[p]; batch; batch = batch->newer) {
+            if(!(batch->pending & (1 << target))) {
+                continue;
+            }
+            // failed batches wait for their retry time, added targets wait as a whole
+            if(target > 0 || (!findWriteSlot(batch->index) && !batch->getRetryRemaining())) {
+                // priority with the oldest batch not full yet waits
+                if(!onlyFull || batch->isFull()) {
+                    return batch->index;
+                }
+                break;
+            }
+        }
+    }
+    return -1;
+}
+
+bool InfluxDBClient::hasFullBatch() const {
+    for(int p=0;p<3;p++) {
+        if(_oldestBatches[p] && _oldestBatches[p]->isFull()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+InfluxDBClient::WriteSlot *InfluxDBClient::findWriteSlot(int16_t index) const {
+    for(int i=0;i<_writeSlotsCount;i++) {
+        if(_writeSlots[i].index == index) {
+            return &_writeSlots[i];
+        }
+    }
+    return nullptr;
+}
+
+uint8_t InfluxDBClient::getPendingWrites() const {
+    uint8_t count = 0;
+    for(int i=0;i<_writeSlotsCount;i++) {
+        if(_writeSlots[i].index >= 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool InfluxDBClient::startAsyncWrite(bool flashOnlyFull) {
+    if(getWritePauseRemaining() > 0) {
+        return false;
+    }
+    // not full batch is written only alone, points added meanwhile would make tiny batches
+    int16_t index = nextBatchToWrite(flashOnlyFull || getPendingWrites() > 0);
+    if(index < 0) {
+        return false;
+    }
+    Batch *batch = _writeBuffer[index];
+    if(!_service && !init()) {
+        return false;
+    }
+    if(!_writeSlots) {
+        // at least one batch must be left for new points
+        _writeSlotsCount = _writeOptions._maxInFlight < _writeBufferSize ? _writeOptions._maxInFlight : _writeBufferSize - 1;
+        _writeSlots = new WriteSlot[_writeSlotsCount];
+        _writeSlots[0].service = _service;
+    }
+    WriteSlot *slot = findWriteSlot(-1);
+    if(!slot) {
+        return false;
+    }
+    if(!slot->service) {
+        slot->service = new HTTPService(&_connInfo);
+    }
+    if(index == _bufferPointer) {
+        // points will be written so increase _bufferPointer as it happen when buffer is flushed when is full
+        if(++_bufferPointer == _writeBufferSize) {
+            _bufferPointer = 0;
+        }
+    }
+    // no more points can be added to the batch being written
+    batch->close();
+    INFLUXDB_CLIENT_DEBUG("[D] Writing batch asynchronously, index: %d, size %d, pending: %d\n", index, batch->pointer, getPendingWrites());
+    // data are always streamed, to not keep allocated buffer between calls
+    slot->streamer = new BatchStreamer(batch, _lineBuffer);
+    slot->gzip = createGzipStream(slot->streamer);
+    Stream *body = slot->gzip ? (Stream *)slot->gzip : (Stream *)slot->streamer;
+    if(!slot->service->startPOST(getWriteUrl(batch).c_str(), body, PSTR("text/plain"), 204, _writeOptions._asyncConnectTimeout, slot->gzip ? PSTR("gzip") : nullptr)) {
+        INFLUXDB_CLIENT_DEBUG("[E] Cannot start write: %s\n", _connInfo.lastError.c_str());
+        delete slot->gzip;
+        slot->gzip = nullptr;
+        delete slot->streamer;
+        slot->streamer = nullptr;
+        return false;
+    }
+    slot->index = index;
+    slot->start = millis();
+    return true;
+}
+
+bool InfluxDBClient::pollAsyncWrites(uint16_t budget, bool &progress, String &error) {
+    uint32_t start = millis();
+    bool success = true;
+    for(int i=0;i<_writeSlotsCount;i++) {
+        WriteSlot &slot = _writeSlots[i];
+        if(slot.index < 0) {
+            continue;
+        }
+        uint32_t elapsed = millis() - start;
+        if(elapsed >= budget) {
+            break;
+        }
+        if(slot.service->pollRequest(budget - elapsed)) {
+            if(!finishAsyncWrite(slot)) {
+                if(error.length() == 0) {
+                    // error message of the first failure would be cleared by next write
+                    error = _connInfo.lastError;
+                }
+                success = false;
+            }
+            progress = true;
+        }
+    }
+    for(int i=0;i<_targetsCount;i++) {
+        // failures of added targets are reported by getLastErrorMessage(target)
+        WriteSlot &slot = _targets[i]->slot;
+        uint32_t elapsed = millis() - start;
+        if(slot.index >= 0 && elapsed < budget && slot.service->pollRequest(budget - elapsed)) {
+            finishTargetWrite(i);
+            progress = true;
+        }
+    }
+    return success;
+}
+
+bool InfluxDBClient::finishAsyncWrite(WriteSlot &slot) {
+    int statusCode = slot.service->getLastStatusCode();
+    uint8_t index = slot.index;
+    _lastWriteRtt = millis() - slot.start;
+    adaptBatchSize(statusCode, _lastWriteRtt);
+    delete slot.gzip;
+    slot.gzip = nullptr;
+    delete slot.streamer;
+    slot.streamer = nullptr;
+    slot.index = -1;
+    bool success = statusCode >= 200 && statusCode < 300;
+    if(!success) {
+        INFLUXDB_CLIENT_DEBUG("[D] error %d: %s\n", statusCode, _connInfo.lastError.c_str());
+    }
+    handleWriteResult(index, statusCode, slot.service->getLastRetryAfter());
+    checkBufferEmpty();
+    checkWatermarks();
+    return success;
+}
+
+bool InfluxDBClient::completeAsyncWrite() {
+    bool success = true;
+    for(int i=0;i<_writeSlotsCount;i++) {
+        if(_writeSlots[i].index >= 0) {
+            _writeSlots[i].service->pollRequest(0);
+            success = finishAsyncWrite(_writeSlots[i]) && success;
+        }
+    }
+    for(int i=0;i<_targetsCount;i++) {
+        if(_targets[i]->slot.index >= 0) {
+            _targets[i]->slot.service->pollRequest(0);
+            finishTargetWrite(i);
+        }
+    }
+    return success;
+}
+
+void InfluxDBClient::abortWrite(WriteSlot &slot) {
+    if(slot.index < 0) {
+        return;
+    }
+    INFLUXDB_CLIENT_DEBUG("[W] Aborting asynchronous write\n");
+    slot.service->abortRequest();
+    delete slot.gzip;
+    slot.gzip = nullptr;
+    delete slot.streamer;
+    slot.streamer = nullptr;
+    slot.index = -1;
+}
+
+void InfluxDBClient::abortAsyncWrite() {
+    for(int i=0;i<_writeSlotsCount;i++) {
+        abortWrite(_writeSlots[i]);
+    }
+}
+
+void InfluxDBClient::freeWriteSlots() {
+    abortAsyncWrite();
+    // the first slot uses the client's connection
+    for(int i=1;i<_writeSlotsCount;i++) {
+        delete _writeSlots[i].service;
+    }
+    delete [] _writeSlots;
+    _writeSlots = nullptr;
+    _writeSlotsCount = 0;
+}
+
+bool InfluxDBClient::flushPipelined(bool flashOnlyFull) {
+    bool success = true;
+    String error;
+    while(true) {
+        // after a failure, like synchronous flushing, finish pending writes only
+        while(success && startAsyncWrite(flashOnlyFull)) {
+        }
+        if(!getPendingWrites()) {
+            break;
+        }
+        bool progress = false;
+        success = pollAsyncWrites(100, progress, error) && success;
+        if(!progress) {
+            // wait for data
+            delay(1);
+        }
+    }
+    if(!success) {
+        _connInfo.lastError = error;
+    }
+    checkBufferEmpty();
+    checkWatermarks();
+    return success;
+}
+
+bool InfluxDBClient::flushBuffer() {
+    bool ret = false;
+    callWriter([&]() {
+        if(_lineQueue) {
+            drainLineQueue();
+        }
+        ret = completeAsyncWrite() && flushBufferInternal(false);
+        publishWriterStatus();
+    });
+    return ret;
+}
+
+void InfluxDBClient::pauseWrites(uint32_t start, uint32_t delay, bool requested) {
+    uint32_t remaining = getWritePauseRemaining();
+    // shorter wait of another batch doesn't cancel waiting
+    if(delay > remaining + (millis() - start)) {
+        _retryRequested = requested || (_retryRequested && remaining > 0);
+        _retryStart = start;
+        _retryDelay = delay;
+    }
+}
+
+uint32_t InfluxDBClient::getWritePauseRemaining() const {
+    uint32_t elapsed = millis() - _retryStart;
+    return elapsed < _retryDelay ? _retryDelay - elapsed : 0;
+}
+
+uint32_t InfluxDBClient::getRemainingRetryTime() {
+    uint32_t rem;
+    if(_writerStatus) {
+        // wait published by the writer task
+        _writerStatus->mutex.lock();
+        uint32_t elapsed = millis() - _writerStatus->retryStart;
+        rem = elapsed < _writerStatus->retryRemaining ? _writerStatus->retryRemaining - elapsed : 0;
+        _writerStatus->mutex.unlock();
+    } else {
+        rem = getRetryRemainingInternal();
+    }
+    return (rem + 999)/1000;
+}
+
+uint32_t InfluxDBClient::getRetryRemainingInternal() const {
+    uint32_t rem = getWritePauseRemaining();
+    // newer batches are written after the oldest one
+    if(_writeBuffer && _writeBuffer[_batchPointer] && (_writeBuffer[_batchPointer]->pending & 1) && _writeBuffer[_batchPointer]->getRetryRemaining() > rem) {
+        rem = _writeBuffer[_batchPointer]->getRetryRemaining();
+    }
+    return rem;
+}
+
+uint32_t InfluxDBClient::getRetryDelay(uint8_t retryCount) const {
+    uint32_t cap = _writeOptions._maxRetryInterval*1000UL;
+    uint32_t delay = _writeOptions._retryInterval*1000UL;
+    // interval is multiplied by itself by default
+    uint32_t multiplier = _writeOptions._retryMultiplier ? _writeOptions._retryMultiplier : _writeOptions._retryInterval;
+    if(multiplier < 1) {
+        multiplier = 1;
+    }
+    for(int i=1;i<retryCount && delay < cap;i++) {
+        delay = delay > cap/multiplier ? cap : delay*multiplier;
+    }
+    if(delay > cap) {
+        delay = cap;
+    }
+    if(_writeOptions._retryJitter) {
+        // full jitter, hardware RNG on ESP boards makes devices of a fleet diverge
+        delay = random(delay + 1);
+    }
+    return delay;
+}
+
+void InfluxDBClient::detachBatch(uint8_t index) {
+    Batch *batch = _writeBuffer[index];
+    int16_t &lane = laneBatch(batch->priority, batch->route);
+    if(lane == index) {
+        lane = -1;
+    }
+    if(index == _bufferPointer && !batch->isFull() && batch->retryCount == 0 ) { //do not increase pointer in case of retrying
+        // points will be written so increase _bufferPointer as it happen when buffer is flushed when is full
+        if(++_bufferPointer == _writeBufferSize) {
+            _bufferPointer = 0;
+        }
+    }
+}
+
+bool InfluxDBClient::handleWriteResult(uint8_t index, int statusCode, int retryAfter) {
+    // retry on unsuccessfull connection or retryable status codes
+    bool retry = (statusCode < 0 || statusCode >= 429) && _writeOptions._maxRetryAttempts > 0;
+    bool success = statusCode >= 200 && statusCode < 300;
+    uint32_t now = millis();
+    if(retryAfter > 0) {
+        // server said how long all writes should wait
+        pauseWrites(now, retryAfter*1000UL, true);
+    }
+    // advance even on message failure x e <300;429)
+    if(success || !retry) {
+        if(success) {
+            _failedWrites = 0;
+            if(!_retryRequested) {
+                // server works, other failed batches wait only for their own retry time
+                _retryDelay = 0;
+            }
+        }
+        _lastFlushed = millis();
+        completeBatch(index, 0);
+        if(success && getBufferUsage() <= _writeOptions._lowWatermark) {
+            // backlog is written, new points are kept all again
+            resetDecimation();
+        }
+        return false;
+    }
+    Batch *batch = _writeBuffer[index];
+    batch->retryCount++;
+    if(statusCode > 0 && batch->retryCount > _writeOptions._maxRetryAttempts) {
+        INFLUXDB_CLIENT_DEBUG("[D] Reached max retry count, dropping batch\n");
+        completeBatch(index, 0);
+        return true;
+    }
+    // apply retry strategy only in case of HTTP errors, or in asynchronous mode, where network outage would cost connecting on each poll
+    if(statusCode > 0 || _writeOptions._asyncBudget) {
+        if(_failedWrites < 255) {
+            _failedWrites++;
+        }
+        batch->retryStart = now;
+        if(retryAfter > 0) {
+            batch->retryDelay = retryAfter*1000UL;
+        } else {
+            batch->retryDelay = getRetryDelay(batch->retryCount > _failedWrites ? batch->retryCount : _failedWrites);
+            // server likely fails for other batches too, so they wait as well, until a write succeeds.
+            // It also keeps batches overwriting a full buffer from being written immediately
+            pauseWrites(now, batch->retryDelay, false);
+        }
+    }
+    INFLUXDB_CLIENT_DEBUG("[D] Leaving data in buffer for retry, retry delay: %dms\n", batch->retryDelay);
+    return true;
+}
+
+void InfluxDBClient::adaptBatchSize(int statusCode, uint32_t rtt) {
+    if(!_writeOptions._minBatchSize) {
+        return;
+    }
+    uint16_t size = _currentBatchSize;
+    bool success = statusCode >= 200 && statusCode < 300;
+    // when writing falls behind, another full batch is waiting and smaller batches would only lower throughput
+    bool backlog = _bufferedPoints >= 2*(uint32_t)_currentBatchSize;
+    if(statusCode < 0 || statusCode == 429 || statusCode == 503 || (success && rtt > _writeOptions._targetRtt && !backlog)) {
+        // network failure, overloaded or slow server
+        size /= 2;
+    } else if(success && rtt <= _writeOptions._targetRtt) {
+        // grow by 1/16 of the range, so the maximum is reached in a few writes
+        uint16_t step = (_writeOptions._batchSize - _writeOptions._minBatchSize + 15)/16;
+        size += step ? step : 1;
+    }
+    if(size < _writeOptions._minBatchSize) {
+        size = _writeOptions._minBatchSize;
+    }
+    if(size > _writeOptions._batchSize) {
+        size = _writeOptions._batchSize;
+    }
+    if(size != _currentBatchSize) {
+        INFLUXDB_CLIENT_DEBUG("[D] Batch size %d -> %d, status: %d, rtt: %dms\n", _currentBatchSize, size, statusCode, rtt);
+        _currentBatchSize = size;
+    }
+}
+
+void InfluxDBClient::checkBufferEmpty() {
+    //Have we emptied the buffer?
+    if(_bufferedPoints == 0) {
+        _bufferPointer = 0;
+        _batchPointer = 0;
+        _bufferCeiling = 0;
+        INFLUXDB_CLIENT_DEBUG("[D] Buffer empty\n");
+    }
+}
+
+bool InfluxDBClient::flushBufferInternal(bool flashOnlyFull) {
+    // added targets have their own retry state
+    flushTargets(flashOnlyFull);
+    uint32_t rwt = getRemainingRetryTime();
+    if(rwt > 0) {
+        INFLUXDB_CLIENT_DEBUG("[W] Cannot write yet, %ds yet\n", rwt);
+        // retry after period didn't run out yet
+        _connInfo.lastError = FPSTR(TooEarlyMessage);
+        _connInfo.lastError += String(rwt);
+        _connInfo.lastError += "s";
+        return false;
+    }
+    if(_writeOptions._maxInFlight > 1) {
+        return flushPipelined(flashOnlyFull);
+    }
+    char *data;
+    bool success = true;
+    int16_t index;
+    // send all batches, high priority first. It could happen there was long network outage and buffer is full
+    while((index = nextBatchToWrite(flashOnlyFull)) >= 0) {
+        detachBatch(index);
+
+        INFLUXDB_CLIENT_DEBUG("[D] Writing batch, batchpointer: %d, size %d\n", index, _writeBuffer[index]->pointer);
+        int statusCode = 0;
+        uint32_t start = millis();
+        if(_streamWrite || _writeOptions._compression != Compression::None) {
+            statusCode = postData(_writeBuffer[index]);
+        } else {
+            data = _writeBuffer[index]->createData(_lineBuffer);
+            statusCode = postData(data, getWriteUrl(_writeBuffer[index]));
+            if(data) {
+                MemoryAccounting::released(MemorySubsystem::WriteBuffer, _writeBuffer[index]->dataLength() + 1);
+            }
+            delete [] data;
+        }
+        _lastWriteRtt = millis() - start;
+        adaptBatchSize(statusCode, _lastWriteRtt);
+        success = statusCode >= 200 && statusCode < 300;
+        if(handleWriteResult(index, statusCode, _service ? _service->getLastRetryAfter() : 0)) {
+            // in case of retryable failure break loop
+            break;
+        }
+       yield();
+    }
+    INFLUXDB_CLIENT_DEBUG("[D] Success: %d, _bufferPointer: %d, _batchPointer: %d, _writeBuffer[_bufferPointer]_%p\n",success,_bufferPointer,_batchPointer, _writeBuffer[_bufferPointer]);
+    checkBufferEmpty();
+    checkWatermarks();
+    return success;
+}
+
+void InfluxDBClient::dropBatch(uint8_t index) {
+    if(index != _batchPointer) {
+        // written ahead of the oldest batch, skipped when the oldest one is dropped
+        releaseBatch(_writeBuffer[index]);
+    } else {
+        dropCurrentBatch();
+    }
+    // batches emptied by decimation or overwritten ahead are skipped as well
+    while(_batchPointer != _bufferPointer && isBatchEmpty(_batchPointer)) {
+        dropCurrentBatch();
+    }
+}
+
+void  InfluxDBClient::dropCurrentBatch() {
+    // batch is kept for reuse, only its lines are released
+    releaseBatch(_writeBuffer[_batchPointer]);
+    _batchPointer++;
+    //did we got over top?
+    if(_batchPointer == _writeBufferSize) {
+        // restart _batchPointer in ring buffer from start
+        _batchPointer = 0;
+        // we reached buffer size, that means buffer was full and now lower ceiling 
+        _bufferCeiling = _bufferPointer;
+    }
+    INFLUXDB_CLIENT_DEBUG("[D] Dropped batch, batchpointer: %d\n", _batchPointer);
+}
+
+void InfluxDBClient::completeBatch(uint8_t index, uint8_t target) {
+    Batch *batch = _writeBuffer[index];
+    batch->pending &= ~(1 << target);
+    if(batch->pending) {
+        // other targets still need the batch, no more points can be added to it
+        batch->close();
+        return;
+    }
+    dropBatch(index);
+}
+
+void InfluxDBClient::initTarget(WriteTarget &target) {
+    if(target.slot.service) {
+        return;
+    }
+    // security and HTTP options are shared with the client
+    target.connInfo.insecure = _connInfo.insecure;
+    target.connInfo.httpOptions = _connInfo.httpOptions;
+    target.slot.service = new HTTPService(&target.connInfo);
+    target.writeUrl = createWriteUrl(target.connInfo, target.connInfo.bucket, target.slot.service);
+    INFLUXDB_CLIENT_DEBUG("[D] Target writeUrl: %s\n", target.writeUrl.c_str());
+}
+
+uint32_t InfluxDBClient::getTargetPauseRemaining(const WriteTarget &target) const {
+    uint32_t elapsed = millis() - target.retryStart;
+    return elapsed < target.retryDelay ? target.retryDelay - elapsed : 0;
+}
+
+void InfluxDBClient::flushTargets(bool flashOnlyFull) {
+    for(int i=0;i<_targetsCount;i++) {
+        WriteTarget &target = *_targets[i];
+        int16_t index;
+        while(target.slot.index < 0 && !getTargetPauseRemaining(target) && (index = nextBatchToWrite(flashOnlyFull, i + 1)) >= 0) {
+            initTarget(target);
+            detachBatch(index);
+            _writeBuffer[index]->close();
+            INFLUXDB_CLIENT_DEBUG("[D] Writing batch to target %d, index: %d, size %d\n", i + 1, index, _writeBuffer[index]->pointer);
+            int statusCode = postData(_writeBuffer[index], target.slot.service, target.writeUrl);
+            if(handleTargetResult(i, index, statusCode, target.slot.service->getLastRetryAfter())) {
+                break;
+            }
+            yield();
+        }
+    }
+}
+
+void InfluxDBClient::startTargetWrites(bool flashOnlyFull) {
+    for(int i=0;i<_targetsCount;i++) {
+        WriteTarget &target = *_targets[i];
+        if(target.slot.index >= 0 || getTargetPauseRemaining(target)) {
+            continue;
+        }
+        int16_t index = nextBatchToWrite(flashOnlyFull, i + 1);
+        if(index < 0) {
+            continue;
+        }
+        initTarget(target);
+        detachBatch(index);
+        Batch *batch = _writeBuffer[index];
+        batch->close();
+        WriteSlot &slot = target.slot;
+        slot.streamer = new BatchStreamer(batch, _lineBuffer);
+        slot.gzip = createGzipStream(slot.streamer);
+        Stream *body = slot.gzip ? (Stream *)slot.gzip : (Stream *)slot.streamer;
+        if(!slot.service->startPOST(target.writeUrl.c_str(), body, PSTR("text/plain"), 204, _writeOptions._asyncConnectTimeout, slot.gzip ? PSTR("gzip") : nullptr)) {
+            INFLUXDB_CLIENT_DEBUG("[E] Cannot start write to target %d: %s\n", i + 1, target.connInfo.lastError.c_str());
+            delete slot.gzip;
+            slot.gzip = nullptr;
+            delete slot.streamer;
+            slot.streamer = nullptr;
+            // like a failed connection, target waits before the next attempt
+            handleTargetResult(i, index, -1);
+            continue;
+        }
+        slot.index = index;
+        slot.start = millis();
+    }
+}
+
+void InfluxDBClient::finishTargetWrite(uint8_t t) {
+    WriteSlot &slot = _targets[t]->slot;
+    int statusCode = slot.service->getLastStatusCode();
+    uint8_t index = slot.index;
+    delete slot.gzip;
+    slot.gzip = nullptr;
+    delete slot.streamer;
+    slot.streamer = nullptr;
+    slot.index = -1;
+    handleTargetResult(t, index, statusCode, slot.service->getLastRetryAfter());
+    checkBufferEmpty();
+    checkWatermarks();
+}
+
+bool InfluxDBClient::handleTargetResult(uint8_t t, uint8_t index, int statusCode, int retryAfter) {
+    WriteTarget &target = *_targets[t];
+    bool success = statusCode >= 200 && statusCode < 300;
+    bool retry = (statusCode < 0 || statusCode >= 429) && _writeOptions._maxRetryAttempts > 0;
+    if(!success) {
+        INFLUXDB_CLIENT_DEBUG("[D] Target %d error %d: %s\n", t + 1, statusCode, target.connInfo.lastError.c_str());
+    }
+    if(retry && (statusCode < 0 || target.failedWrites < _writeOptions._maxRetryAttempts)) {
+        // the oldest batch is written first, so the whole target waits, even on a network failure
+        if(target.failedWrites < 255) {
+            target.failedWrites++;
+        }
+        target.retryStart = millis();
+        target.retryDelay = retryAfter > 0 ? retryAfter*1000UL : getRetryDelay(target.failedWrites);
+        INFLUXDB_CLIENT_DEBUG("[D] Pausing writes to target %d for %dms\n", t + 1, target.retryDelay);
+        return true;
+    }
+    target.failedWrites = 0;
+    target.retryDelay = 0;
+    completeBatch(index, t + 1);
+    return false;
+}
+
+bool InfluxDBClient::isTargetWriting(int16_t index) const {
+    for(int i=0;i<_targetsCount;i++) {
+        if(_targets[i]->slot.index == index) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool InfluxDBClient::hasTargetWrites() const {
+    for(int i=0;i<_targetsCount;i++) {
+        if(_targets[i]->slot.index >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void InfluxDBClient::cleanTargets() {
+    for(int i=0;i<_targetsCount;i++) {
+        WriteTarget &target = *_targets[i];
+        abortWrite(target.slot);
+        delete target.slot.service;
+        target.slot.service = nullptr;
+        target.retryDelay = 0;
+        target.failedWrites = 0;
+    }
+}
+
+String InfluxDBClient::pointToLineProtocol(const Point& point) {
+    return point.createLineProtocol(_writeOptions._defaultTags, _writeOptions._useServerTimestamp);
+}
+
+bool InfluxDBClient::validateConnection() {
+    bool ret = false;
+    // writer task, if running, owns the connection
+    callWriter([&]() {
+        ret = validateConnectionInternal();
+        publishWriterStatus();
+    });
+    return ret;
+}
+
+bool InfluxDBClient::validateConnectionInternal() {
+    if(!_service && !init()) {
+        return false;
+    }
+    completeAsyncWrite();
+    // on version 1.x /ping will by default return status code 204, without verbose
+    String url = _connInfo.serverUrl + (_connInfo.dbVersion==2?"/health":"/ping?verbose=true");
+    if(_connInfo.dbVersion==1 && _connInfo.user.length() > 0 && _connInfo.password.length() > 0) {
+        url += "&u=";
+        url += urlEncode(_connInfo.user.c_str());
+        url += "&p=";
+        url += urlEncode(_connInfo.password.c_str());
+    }
+    INFLUXDB_CLIENT_DEBUG("[D] Validating connection to %s\n", url.c_str());
+
+    bool ret = _service->doGET(url.c_str(), 200, nullptr);
+    if(!ret) {
+        INFLUXDB_CLIENT_DEBUG("[D] error %d: %s\n", _service->getLastStatusCode(), _service->getLastErrorMessage().c_str());
+    }
+    return ret;
+}
+
+int InfluxDBClient::postData(const char *data, const String &url) {
+    if(!_service && !init()) {
+        return 0;
+    }
+    if(data) {
+        INFLUXDB_CLIENT_DEBUG("[D] Writing to %s\n", url.c_str());
+        INFLUXDB_CLIENT_DEBUG("[D] Sending:\n%s\n", data);       
+        if(!_service->doPOST(url.c_str(), data, PSTR("text/plain"), 204, nullptr)) {
+            INFLUXDB_CLIENT_DEBUG("[D] error %d: %s\n", _service->getLastStatusCode(), _service->getLastErrorMessage().c_str());
+        }
+        return _service->getLastStatusCode();
+    } 
+    return 0;
+}
+
+int InfluxDBClient::postData(Batch *batch) {
+    if(!_service && !init()) {
+        return 0;
+    }
+    return postData(batch, _service, getWriteUrl(batch));
+}
+
+int InfluxDBClient::postData(Batch *batch, HTTPService *service, const String &url) {
+    BatchStreamer *bs = new BatchStreamer(batch, _lineBuffer);
+    INFLUXDB_CLIENT_DEBUG("[D] Writing to %s\n", url.c_str());
+    INFLUXDB_CLIENT_DEBUG("[D] Sending %d:\n", bs->available());       
+    GzipStream *gz = createGzipStream(bs);
+    Stream *body = gz ? (Stream *)gz : (Stream *)bs;
+
+    if(!service->doPOST(url.c_str(), body, PSTR("text/plain"), 204, nullptr, gz ? PSTR("gzip") : nullptr)) {
+        INFLUXDB_CLIENT_DEBUG("[D] error %d: %s\n", service->getLastStatusCode(), service->getLastErrorMessage().c_str());
+    }
+    delete gz;
+    delete bs;
+    return service->getLastStatusCode();
+}
+
+GzipStream *InfluxDBClient::createGzipStream(BatchStreamer *bs) {
+    if(_writeOptions._compression != Compression::Gzip) {
+        return nullptr;
+    }
+    GzipStream *gz = new GzipStream(bs);
+    // Content-Length must be known in advance, so data are compressed once into memory and then sent.
+    // Compressed data longer than the lines are not worth it
+    if(!gz->compress(bs->available())) {
+        INFLUXDB_CLIENT_DEBUG("[W] Not enough memory for compression, or data are not compressible, sending uncompressed\n");
+        delete gz;
+        gz = nullptr;
+    }
+    bs->reset();
+    return gz;
 }
 
 void InfluxDBClient::setStreamWrite(bool enable) {
@@ -611,17 +2399,40 @@ FluxQueryResult InfluxDBClient::query(const String &fluxQuery) {
 }
 
 FluxQueryResult InfluxDBClient::query(const String &fluxQuery, QueryParams params) {
-    uint32_t rwt = getRemainingRetryTime();
+    // retrying of writes doesn't block queries, only a wait requested in a query response
+    uint32_t elapsed = millis() - _queryRetryStart;
+    uint32_t rwt = elapsed < _queryRetryDelay ? (_queryRetryDelay - elapsed + 999)/1000 : 0;
     if(rwt > 0) {
-        INFLUXDB_CLIENT_DEBUG("[W] Cannot query yet, pause %ds, %ds yet\n", _retryTime, rwt);
+        INFLUXDB_CLIENT_DEBUG("[W] Cannot query yet, %ds yet\n", rwt);
         // retry after period didn't run out yet
         String mess = FPSTR(TooEarlyMessage);
         mess += String(rwt);
         mess += "s";
         return FluxQueryResult(mess);
     }
-    if(!_service && !init()) {
-        return FluxQueryResult(_connInfo.lastError);
+    HTTPService *service = _service;
+    if(_writerTask) {
+        // writer task keeps writing over the main connection, while the result is read from another one
+        if(!_queryService) {
+            _writerTask->call([this]() {
+                if(_service || init()) {
+                    _queryConnInfo = new ConnectionInfo(_connInfo);
+                    _queryService = new HTTPService(_queryConnInfo);
+                }
+                publishWriterStatus();
+            });
+            if(!_queryService) {
+                return FluxQueryResult(getLastErrorMessage());
+            }
+        }
+        service = _queryService;
+    } else {
+        if(!_service && !init()) {
+            return FluxQueryResult(_connInfo.lastError);
+        }
+        // query cannot share connection with pending write
+        completeAsyncWrite();
+        service = _service;
     }
     INFLUXDB_CLIENT_DEBUG("[D] Query to %s\n", _queryUrl.c_str());
     INFLUXDB_CLIENT_DEBUG("[D] JSON query:\n%s\n", fluxQuery.c_str());
@@ -646,23 +2457,26 @@ FluxQueryResult InfluxDBClient::query(const String &fluxQuery, QueryParams param
     }
     body += '}';
     CsvReader *reader = nullptr;
-    _retryTime = 0;
     INFLUXDB_CLIENT_DEBUG("[D] Query: %s\n", body.c_str());
-    if(_service->doPOST(_queryUrl.c_str(), body.c_str(), PSTR("application/json"), 200, [&](HTTPClient *httpClient){
+    bool acceptGzip = _connInfo.httpOptions._queryCompression == Compression::Gzip;
+    if(service->doPOST(_queryUrl.c_str(), body.c_str(), PSTR("application/json"), 200, [&](HTTPClient *httpClient){
         bool chunked = false;
         if(httpClient->hasHeader(TransferEncoding)) {
             String header = httpClient->header(TransferEncoding);
             chunked = header.equalsIgnoreCase("chunked");
         }
-        INFLUXDB_CLIENT_DEBUG("[D] chunked: %s\n", bool2string(chunked));
-        HttpStreamScanner *scanner = new HttpStreamScanner(httpClient, chunked);
+        // server may ignore Accept-Encoding
+        bool gzip = httpClient->header(ContentEncoding).equalsIgnoreCase("gzip");
+        INFLUXDB_CLIENT_DEBUG("[D] chunked: %s, gzip: %s\n", bool2string(chunked), bool2string(gzip));
+        HttpStreamScanner *scanner = new HttpStreamScanner(httpClient, chunked, gzip);
         reader = new CsvReader(scanner);
         return false;
-    })) {
+    }, acceptGzip ? PSTR("gzip") : nullptr)) {
         return FluxQueryResult(reader);
     } else {
-        _retryTime = _service->getLastRetryAfter();
-        return FluxQueryResult(_service->getLastErrorMessage());
+        _queryRetryStart = service->getLastRequestTime();
+        _queryRetryDelay = service->getLastRetryAfter()*1000UL;
+        return FluxQueryResult(service->getLastErrorMessage());
     }
 }
 
@@ -704,15 +2518,14 @@ static String escapeJSONString(const String &value) {
     return ret;
 }
 
-InfluxDBClient::BatchStreamer::BatchStreamer(InfluxDBClient::Batch *batch) {
+InfluxDBClient::BatchStreamer::BatchStreamer(InfluxDBClient::Batch *batch, const char *data) {
     _batch = batch;
+    _data = data;
     _read = 0;
     _length = 0;
     _pointer = 0;
     _linePointer = 0;
-    for(uint16_t i=0;i<_batch->pointer;i++) {
-        _length += strlen(_batch->buffer[i])+1;
-    }
+    _length = _batch->dataLength();
 }
 
 int InfluxDBClient::BatchStreamer::available() {
@@ -740,15 +2553,25 @@ size_t InfluxDBClient::BatchStreamer::readBytes(char* buffer, size_t len) {
 #elif defined(ESP32)
     INFLUXDB_CLIENT_DEBUG("BatchStream::readBytes %d, free_heap %d, max_alloc_heap %d\n", len, ESP.getFreeHeap(), ESP.getMaxAllocHeap());
 #endif
-    unsigned int r=0;
-    for(unsigned int i=0;i<len;i++) {
-        if(available()) {
-            buffer[i] = read();
-            r++;
+    size_t r = 0;
+    while(r < len && _pointer < _batch->pointer) {
+        const Line &line = _batch->lines[_pointer];
+        if(_linePointer < line.length) {
+            // copy as much of the rest of the line as fits
+            size_t n = line.length - _linePointer;
+            if(n > len - r) {
+                n = len - r;
+            }
+            memcpy(buffer + r, _data + line.offset + _linePointer, n);
+            _linePointer += n;
+            r += n;
         } else {
-            break;
+            buffer[r++] = '\n';
+            ++_pointer;
+            _linePointer = 0;
         }
     }
+    _read += r;
     return r;
 }
 
@@ -756,8 +2579,7 @@ int InfluxDBClient::BatchStreamer::read()  {
     int r = peek();
     if(r > 0) {
         ++_read;
-        ++_linePointer;
-        if(!_batch->buffer[_pointer][_linePointer-1]) {
+        if(++_linePointer > _batch->lines[_pointer].length) {
             ++_pointer;
             _linePointer = 0;
         }
@@ -770,14 +2592,11 @@ int InfluxDBClient::BatchStreamer::peek() {
         //This should not happen
         return -1;
     }
-    
-    int r;
-    if(!_batch->buffer[_pointer][_linePointer]) {
-        r = '\n';
-    } else {
-        r = _batch->buffer[_pointer][_linePointer];
+    const Line &line = _batch->lines[_pointer];
+    if(_linePointer == line.length) {
+        return '\n';
     }
-    return r;
+    return _data[line.offset + _linePointer];
 }
 
 size_t InfluxDBClient::BatchStreamer::write(uint8_t)  {
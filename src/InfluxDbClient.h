@@ -30,10 +30,12 @@
 #include <Arduino.h>
 #include "HTTPService.h"
 #include "Point.h"  
+#include "PointSchema.h"
 #include "WritePrecision.h"
 #include "query/FluxParser.h"
 #include "query/Params.h"
 #include "util/helpers.h"
+#include "util/MemoryStats.h"
 #include "Options.h"
 #include "BucketsClient.h"
 #include "Version.h"
@@ -43,6 +45,14 @@
 #endif
 
 class Test;
+class GzipStream;
+class LineQueue;
+class WriterTask;
+class Aggregator;
+class ChangeFilter;
+
+// Called when write buffer usage reaches high watermark (aboveHighWatermark is true) or drops to low watermark (aboveHighWatermark is false)
+typedef std::function<void(bool aboveHighWatermark)> WatermarkCallback;
 
 /**
  * InfluxDBClient handles connection and basic operations for an InfluxDB server.
@@ -122,12 +132,36 @@ class InfluxDBClient {
     // Returns true if successful, false in case of any error
     bool validateConnection();
     // Writes record in InfluxDB line protocol format to write buffer.
+    // priority - Optional. Points of higher priority are written first and overwritten last, when the write buffer is full. 
     // Returns true if successful, false in case of any error 
-    bool writeRecord(const String &record);
-    bool writeRecord(const char *record);
+    bool writeRecord(const String &record, WritePriority priority = WritePriority::Normal);
+    bool writeRecord(const char *record, WritePriority priority = WritePriority::Normal);
     // Writes record represented by Point to buffer
+    // priority - Optional. Points of higher priority are written first and overwritten last, when the write buffer is full. 
+    // Returns true if successful, false in case of any error 
+    bool writePoint(Point& point, WritePriority priority = WritePriority::Normal);
+    // Writes record to the bucket instead of the one set by setConnectionParams, on the same server and over the same connection.
+    // Points of each bucket are batched separately and each batch is sent by its own request. At most 7 other buckets can be used.
+    // Bucket is added by the first write, while the writer task runs only buckets added before starting it can be used, see addBucket
     // Returns true if successful, false in case of any error 
-    bool writePoint(Point& point);
+    bool writeRecord(const String &record, const String &bucket, WritePriority priority = WritePriority::Normal);
+    bool writeRecord(const char *record, const String &bucket, WritePriority priority = WritePriority::Normal);
+    // Writes record represented by Point to the bucket, see writeRecord
+    bool writePoint(Point& point, const String &bucket, WritePriority priority = WritePriority::Normal);
+    // Routes points of the measurement, which are written without a bucket, to the bucket. Measurement ending with '*' routes 
+    // all measurements starting with the rest of it. Points of aggregated series and records are routed as well.
+    // Returns false if too many buckets are used. Routes cannot be changed while the writer task runs
+    bool routeMeasurement(const String &measurement, const String &bucket);
+    // Adds bucket for writing by writeRecord or writePoint with the bucket. Buckets used while the writer task runs must be added before starting it.
+    // Returns false if too many buckets are used
+    bool addBucket(const String &bucket);
+    // Registers series, the measurement and tags of the point, for aggregation in tumbling windows of windowMs.
+    // Numeric and boolean fields of points of the series, written by writePoint, are then accumulated instead of buffering each point,
+    // and once per window a point with the aggregated fields, e.g. temp_mean, is written. String fields are ignored.
+    // Registering the series again changes the aggregation, zero windowMs stops it. The accumulated window is written in both cases.
+    // Points of aggregated series can be written from more tasks. Series cannot be registered or stopped while the writer task runs.
+    // Returns false if memory cannot be allocated or the writer task runs
+    bool aggregateSeries(const Point &series, uint32_t windowMs, AggregateFunction functions = AggregateFunction::Mean, int decimalPlaces = 2);
     // Sends Flux query and returns FluxQueryResult object for subsequently reading flux query response.
     // Use FluxQueryResult::next() method to iterate over lines of the query result.
     // Always call of FluxQueryResult::close() when reading is finished. Check FluxQueryResult doc for more info.
@@ -137,33 +171,96 @@ class InfluxDBClient {
     // Always call of FluxQueryResult::close() when reading is finished. Check FluxQueryResult doc for more info.
     FluxQueryResult query(const String &fluxQuery, QueryParams params);
     // Forces writing of all points in buffer, even the batch is not full.
+    // It is always synchronous, it waits also for finishing an asynchronous write.
     // Returns true if successful, false in case of any error 
     bool flushBuffer();
     // Returns true if points buffer is full. Usefull when server is overloaded and we may want increase period of write points or decrease number of points
     bool isBufferFull() const  { return _bufferCeiling == _writeBufferSize; };
     // Returns true if buffer is empty. Usefull when going to sleep and check if there is sth in write buffer (it can happens when batch size if bigger than 1). Call flushBuffer() then.
-    bool isBufferEmpty() const { return _bufferCeiling == 0 && !_writeBuffer[0]; };
+    bool isBufferEmpty() const;
+    // Returns true if write buffer usage reached the high watermark and didn't drop to the low watermark yet. 
+    // Producers should slow down or skip low priority points, to avoid overwriting buffered points. 
+    bool isAboveHighWatermark() const { return _aboveHighWatermark; }
+    // Returns write buffer usage in percents. Counts bytes if bufferBytes is set in WriteOptions, otherwise points.
+    uint8_t getBufferUsage() const;
+    // Sets function called when write buffer usage crosses watermarks. See WriteOptions::bufferWatermarks.
+    void setWatermarkCallback(WatermarkCallback callback) { _watermarkCallback = callback; }
+    // Returns size of the encoded batch in bytes, when it is written, after alignment to the send block size. 
+    // 0 if flushing by size is not set. See WriteOptions::flushBytes.
+    uint32_t getFlushBytes() const;
+    // Returns number of points in a batch, when it is written. It is batch size, unless adapting is set by WriteOptions::adaptiveBatchSize.
+    uint16_t getBatchSize() const { return _writeOptions._minBatchSize ? _currentBatchSize : _writeOptions._batchSize; }
+    // Returns round trip time in ms of the last write request
+    uint32_t getLastWriteRtt() const { return _lastWriteRtt; }
+    // Returns number of points lost, because the write buffer was full: overwritten, rejected or dropped by decimation,
+    // depending on WriteOptions::overflowPolicy
+    uint32_t getDroppedPoints() const { return _droppedPoints; }
+    // Returns number of points not written, because they haven't changed, see WriteOptions::sendOnChange
+    uint32_t getSuppressedPoints() const;
+    // Returns current and peak heap usage of the library per subsystem, with allocation counts. Counters are shared by all clients.
+    static MemoryStats getMemoryStats() { return MemoryAccounting::getStats(); }
+    // Sets peaks of memory usage to the current usage, e.g. to measure a single workload
+    static void resetMemoryPeaks() { MemoryAccounting::resetPeaks(); }
+    // Adds server or bucket, where all points are written as well, e.g. a cloud server mirroring a local one.
+    // Points are encoded and buffered only once, a batch is released when all targets have written or dropped it.
+    // Each target has its own connection, retry state and progress, so a failing target doesn't hold back others.
+    // Its backlog takes space in the write buffer, though, and it is overwritten first when the buffer is full.
+    // Targets are numbered from 1 in the order of adding, 0 is the server set by setConnectionParams. At most 7 targets can be added.
+    // Points buffered before adding a target are not written to it.
+    // Returns false if parameters are invalid or there are too many targets, check getLastErrorMessage() for an error.
+    bool addWriteTarget(const String &serverUrl, const String &org, const String &bucket, const String &authToken, const char *certInfo = nullptr);
+    // Removes all added write targets. Batches waiting only for them are released.
+    void removeWriteTargets();
+    // Returns number of added write targets
+    uint8_t getWriteTargetsCount() const { return _targetsCount; }
+    // Returns number of batches waiting to be written to the target
+    uint8_t getPendingBatches(uint8_t target = 0) const;
     // Checks points buffer status and flushes if number of points reached batch size or flush interval runs out.
+    // Writes points of ended aggregation windows, see aggregateSeries.
+    // In asynchronous write mode (see WriteOptions::asyncWrite) it just calls poll().
     // Returns true if successful, false in case of any error
     bool checkBuffer();
+    // Moves asynchronous writing forward: starts writing of a batch when it is due, sends next block of data or reads response. 
+    // Works at most the time budget set by WriteOptions::asyncWrite. Call it frequently, e.g. from loop(). 
+    // Returns false if a write failed during this call, check getLastErrorMessage() for an error.
+    bool poll();
+    // Starts background task, which takes over batching, flushing and retrying. 
+    // writeRecord and writePoint then only copy the line to a queue of queueBytes size (rounded down to a power of two), which is passed to the task without locking. 
+    // They can be called from more tasks at once, writers don't block each other. Returns false if the queue is full.
+    // The task checks the queue and the buffer each intervalMs. checkBuffer and poll have no effect when the task runs.
+    // The task owns the buffer and the connection: flushBuffer, validateConnection and write target changes are run by the task, the caller waits for them.
+    // isBufferEmpty, getLastErrorMessage and getRemainingRetryTime read status published by the task, they don't wait for a write. Query uses another connection.
+    // Write options must be set before starting the task.
+    // Not supported on ESP8266. On ESP32 task runs on core INFLUXDB_CLIENT_WRITER_CORE.
+    // Returns false if the task cannot be started, check getLastErrorMessage() for an error.
+    bool startWriterTask(uint32_t queueBytes = 4096, uint16_t intervalMs = 10);
+    // Stops the background task. Lines remaining in the queue are moved to the write buffer.
+    void stopWriterTask();
+    bool isWriterTaskRunning() const { return _writerTask != nullptr; }
+    // Returns number of lines not written because the writer task queue was full
+    uint32_t getWriterQueueDropped() const;
     // Wipes out buffered points
     void resetBuffer();
     // Returns HTTP status of last request to server. Usefull for advanced handling of failures.
     int getLastStatusCode() const { return  _service?_service->getLastStatusCode():0;  }
+    // Returns HTTP status of last write request to the target, see addWriteTarget
+    int getLastStatusCode(uint8_t target) const;
     // Returns last response when operation failed
-    String getLastErrorMessage() const { return _connInfo.lastError; }
+    String getLastErrorMessage() const;
+    // Returns last response of the target, when write failed
+    String getLastErrorMessage(uint8_t target) const;
     // Returns server url
     String getServerUrl() const { return _connInfo.serverUrl; }
-    // Check if it is possible to send write/query request to server. 
-    // Returns true if write or query can be send, or false, if server is overloaded and retry strategy is applied.
+    // Check if it is possible to send write request to server. Queries are not blocked by retrying of writes.
+    // Returns true if write can be send, or false, if server is overloaded or the oldest batch failed and retry strategy is applied.
     // Use getRemainingRetryTime() to get wait time in such case.
     bool canSendRequest() { return getRemainingRetryTime() == 0; }
-    // Returns remaining wait time in seconds when retry strategy is applied.
+    // Returns remaining wait time in seconds, before the oldest batch can be written, when retry strategy is applied.
     uint32_t getRemainingRetryTime();
     // Returns sub-client for managing buckets
     BucketsClient getBucketsClient();
     // Enables/disables streaming write. This allows sending large batches without allocating buffer.
-    // It is about 50% slower than writing by allocated buffer (default);
+    // Lines are streamed directly from the write buffer in blocks, so it is about as fast as writing by allocated buffer (default).
     void setStreamWrite(bool enable = true);
     // Returns true if HTTP connection is kept open (connection reuse must be set to true)
     bool isConnected() const { return _service && _service->isConnected(); }
@@ -174,38 +271,81 @@ class InfluxDBClient {
     // Cleans instances
     void clean();
   protected:
+    // Position of a line in the write buffer memory
+    struct Line {
+        uint32_t offset;
+        // Length without terminating char
+        uint32_t length;
+    };
     class Batch {
     friend class Test;
       private:
         uint16_t _size = 0;
+        // Batch was closed before reaching its size
+        bool _closed = false;
       public:
         uint16_t pointer = 0;
-        char **buffer = nullptr;
+        // Lines in the write buffer memory
+        Line *lines = nullptr;
+        // Total length of lines, without new line chars
+        uint32_t length = 0;
         uint8_t retryCount = 0;
+        // Time in ms of the last failed write and wait in ms before the next attempt
+        uint32_t retryStart = 0;
+        uint32_t retryDelay = 0;
+        // Order of the batch in the write buffer, used for finding the oldest data
+        uint32_t sequence = 0;
+        // Priority of all points in the batch
+        WritePriority priority = WritePriority::Normal;
+        // Bit mask of write targets, which haven't written the batch yet. Bit 0 is the server set by setConnectionParams
+        uint8_t pending = 0;
+        // Bucket route of all points in the batch, 0 is the bucket set by setConnectionParams
+        uint8_t route = 0;
+        // Index in the write buffer
+        uint8_t index = 0;
+        // Neighbours in the list of not empty batches of the same priority, which is ordered by sequence
+        Batch *older = nullptr;
+        Batch *newer = nullptr;
         Batch(uint16_t size);
         ~Batch();
-        bool append(const char *line);
-        char *createData();
+        // Stores position of a line already copied to the write buffer memory
+        // Returns true if the batch is full
+        bool append(uint32_t offset, uint32_t length);
+        // Returns line at the index
+        const char *line(const char *data, uint16_t index) const { return data + lines[index].offset; }
+        // Returns length of data with lines separated by new line char
+        uint32_t dataLength() const { return length + pointer; }
+        // Creates data for sending, new line separated lines terminated by zero
+        char *createData(const char *data);
         void clear();
+        // Marks batch as full, no more lines will be added
+        void close() { _closed = true; }
         bool isFull() const {
-          return pointer == _size;
+          return pointer == _size || _closed;
         }
         bool isEmpty() const {
-          return pointer == 0 && !buffer[0];
+          return pointer == 0;
         }
+        // Returns max number of lines
+        uint16_t getSize() const { return _size; }
+        // Returns remaining time in ms before the next write attempt
+        uint32_t getRetryRemaining() const;
     };
     class BatchStreamer : public Stream {
       private:
         Batch *_batch;
+        const char *_data;
         int _length;
         int _read;
         uint16_t _pointer; //points to the item in batch
-        uint16_t _linePointer; //pointes to char in line of batch
+        uint32_t _linePointer; //pointes to char in line of batch
       public:
-        BatchStreamer(Batch *batch) ;
+        BatchStreamer(Batch *batch, const char *data) ;
         virtual ~BatchStreamer() {};
         // Clears pointers to start reading from beginning
         void reset();
+        // Sets new address of the write buffer memory, after it was reallocated
+        void setData(const char *data) { _data = data; }
 
           // Stream overrides
         virtual int available() override;
@@ -222,6 +362,43 @@ class InfluxDBClient {
         virtual size_t write(uint8_t data) override;
 
     };
+    // Batch being written asynchronously over a connection
+    struct WriteSlot {
+        // The first slot uses the client's connection, others have their own
+        HTTPService *service = nullptr;
+        // Index of the batch in the points buffer, -1 if the slot is free
+        int16_t index = -1;
+        BatchStreamer *streamer = nullptr;
+        GzipStream *gzip = nullptr;
+        // Time in ms when the write started
+        uint32_t start = 0;
+    };
+    // Bucket on the client's server, where routed points are written instead of the default one
+    struct BucketRoute {
+        String bucket;
+        String writeUrl;
+        // Index of the batch being filled for each priority, or -1
+        int16_t laneBatches[3] = { -1, -1, -1 };
+    };
+    // Measurement, whose points are written to a bucket route
+    struct MeasurementRoute {
+        // Escaped measurement, or its prefix
+        String measurement;
+        bool prefix;
+        uint8_t route;
+    };
+    // Additional server or bucket, where batches are written in their own order
+    struct WriteTarget {
+        ConnectionInfo connInfo;
+        String writeUrl;
+        // Write in progress, the slot owns the target's connection
+        WriteSlot slot;
+        // Pause of writes in ms after a failed write, and time from which it is counted
+        uint32_t retryDelay = 0;
+        uint32_t retryStart = 0;
+        // Count of failed attempts since the last successful write
+        uint8_t failedWrites = 0;
+    };
     ConnectionInfo _connInfo;  
     // Cached full write url
     String _writeUrl;
@@ -229,40 +406,278 @@ class InfluxDBClient {
     String _queryUrl;
     // Points buffer
     Batch **_writeBuffer = nullptr;
+    // Scratch indexes for compacting and decimating the points buffer, allocated with it so a full buffer is handled without allocation
+    uint16_t *_bufferScratch = nullptr;
+    // Write buffer memory. Lines of all batches are stored back-to-back as zero terminated strings.
+    char *_lineBuffer = nullptr;
+    // Allocated size of the write buffer memory
+    uint32_t _lineBufferSize = 0;
+    // Offset in the write buffer memory where next line will be stored
+    uint32_t _lineBufferHead = 0;
+    // Offset of the oldest line in the write buffer memory
+    uint32_t _lineBufferTail = 0;
+    // End of data at the top of the write buffer memory, when lines continue from the beginning
+    uint32_t _lineBufferEnd = 0;
+    // Sequence number of the next batch
+    uint32_t _batchSequence = 0;
+    // Number of points in buffer
+    uint32_t _bufferedPoints = 0;
+    // Length of lines in buffer, including their terminating chars
+    uint32_t _bufferedBytes = 0;
+    // Oldest and newest not empty batch of each priority. Victims of a full buffer and next batches to write are found without scanning the buffer
+    Batch *_oldestBatches[3] = { nullptr, nullptr, nullptr };
+    Batch *_newestBatches[3] = { nullptr, nullptr, nullptr };
+    // Number of allocated batches and of not empty ones
+    uint8_t _batchesCount = 0;
+    uint8_t _linkedBatches = 0;
+    // Whether buffer usage reached high watermark
+    bool _aboveHighWatermark = false;
+    // Watermarks crossing listener
+    WatermarkCallback _watermarkCallback;
     // Batch buffer size
     uint8_t _writeBufferSize;
     // Write options
     WriteOptions _writeOptions;
-    // Store retry timeout suggested by server or computed
-    int _retryTime = 0; 
+    // Pause of all writes in ms, requested by server or computed after a failed write
+    uint32_t _retryDelay = 0;
+    // Time in ms of the request, from which the pause is counted
+    uint32_t _retryStart = 0;
+    // Whether the pause was requested by server. Otherwise it is canceled by a successful write
+    bool _retryRequested = false;
+    // Count of failed writes since the last successful one. Backoff keeps growing, when failed batches are overwritten by new ones
+    uint8_t _failedWrites = 0;
+    // Pause of queries in ms, requested by server in a query response
+    uint32_t _queryRetryDelay = 0;
+    uint32_t _queryRetryStart = 0;
     // HTTP operations object
     HTTPService *_service = nullptr;
+    // Connection of queries made while the writer task runs, which uses the main one. Created by the first such query
+    HTTPService *_queryService = nullptr;
+    ConnectionInfo *_queryConnInfo = nullptr;
     // Index to buffer where to store new batch
     uint8_t _bufferPointer = 0;
     // Actual count of batches in buffer 
     uint8_t _bufferCeiling = 0;
     // Index of bath start for next write
     uint8_t _batchPointer = 0;
+    // Index of the batch being filled for each priority, or -1. Batches of lower priority stay open behind the buffer pointer
+    int16_t _laneBatches[3] = { -1, -1, -1 };
+    // Number of points lost because the write buffer was full
+    uint32_t _droppedPoints = 0;
+    // Decimation level of each priority, when OverflowPolicy::Decimate is set. Every 2^level-th new point is buffered
+    uint8_t _decimation[3] = { 0, 0, 0 };
+    uint16_t _decimationCounter[3] = { 0, 0, 0 };
     // Last time in sec buffer has been successfully flushed
     uint32_t _lastFlushed;
+    // Batch size adapted to write latency, when WriteOptions::adaptiveBatchSize is set
+    uint16_t _currentBatchSize = 1;
+    // Round trip time in ms of the last write request
+    uint32_t _lastWriteRtt = 0;
     // Bucket sub-client
     BucketsClient _buckets;
     // Write using buffer or stream
     bool _streamWrite = false;
+    // Asynchronous writes, allocated when the first one starts. Count is limited by WriteOptions::maxInFlight
+    WriteSlot *_writeSlots = nullptr;
+    uint8_t _writeSlotsCount = 0;
+    // Lines waiting for the writer task
+    LineQueue *_lineQueue = nullptr;
+    WriterTask *_writerTask = nullptr;
+    // Status published by the writer task for other tasks
+    struct WriterStatus;
+    WriterStatus *_writerStatus = nullptr;
+    // Buffer for a line taken from the queue
+    char *_queueLine = nullptr;
+    uint32_t _queueLineSize = 0;
+    // Series aggregated before buffering
+    Aggregator **_aggregators = nullptr;
+    uint8_t _aggregatorsCount = 0;
+    // Last written values for send-on-change filtering, allocated with the first point
+    ChangeFilter *_changeFilter = nullptr;
+    // Additional write targets. Batch pending bit of the target at index i is 1 << (i + 1)
+    WriteTarget **_targets = nullptr;
+    uint8_t _targetsCount = 0;
+    // Buckets of routed points. Batch route i + 1 is the bucket at index i
+    BucketRoute **_bucketRoutes = nullptr;
+    uint8_t _bucketRoutesCount = 0;
+    MeasurementRoute **_measurementRoutes = nullptr;
+    uint8_t _measurementRoutesCount = 0;
   protected:    
     // Sends POST request with data in body
-    int postData(const char *data);
+    int postData(const char *data, const String &url);
     int postData(Batch *batch);
+    // Streams batch to the url over the connection
+    int postData(Batch *batch, HTTPService *service, const String &url);
+    // Returns write url of the bucket for the connection
+    String createWriteUrl(const ConnectionInfo &connInfo, const String &bucket, const HTTPService *service) const;
+    // Returns write url of the bucket route of the batch
+    const String &getWriteUrl(const Batch *batch) const { return batch->route ? _bucketRoutes[batch->route - 1]->writeUrl : _writeUrl; }
       // Sets cached InfluxDB server API URLs
     bool setUrls();
     // Ensures buffer has required size
     void reserveBuffer(int size);
     // Drops current batch and advances batch pointer
     void dropCurrentBatch();
+    // Moves buffer pointer to the next batch, when the current one is full
+    void advanceBufferPointer();
+    // Returns true if there is no batch or no data at the index of the points buffer
+    bool isBatchEmpty(uint8_t index) const { return !_writeBuffer[index] || _writeBuffer[index]->isEmpty(); }
+    // Clears batch and releases its lines from the write buffer memory
+    void releaseBatch(Batch *batch);
+    // Adds batch getting its first line as the newest one of its priority
+    void linkBatch(Batch *batch);
+    // Removes batch being emptied from the list of its priority
+    void unlinkBatch(Batch *batch);
+    // Drops the oldest points of the lowest priority to make space in the write buffer memory. 
+    // Batch at the current index, which is being filled, is dropped only if there is no other one of the same or lower priority. 
+    // Returns false if there is nothing to drop
+    bool dropOldestBatch(uint8_t current);
+    // Returns index of the oldest batch of the lowest priority, except the batch at the keep index, or -1
+    int16_t findEvictedBatch(int16_t keep) const;
+    // Moves lines to the space released by batches written or dropped before older ones
+    void compactLineBuffer();
+    // Returns number of bytes used in the write buffer memory
+    uint32_t getLineBufferUsed() const;
+    // Updates watermark state and calls watermark callback when it changes
+    void checkWatermarks();
+    // Finds space for a line of length bytes in the write buffer memory, enlarging it if needed, or dropping old batches, except the current one.
+    // Returns true if successful, false if there is not enough memory
+    bool allocLine(uint32_t length, uint32_t &offset, uint8_t current);
+    // Enlarges the write buffer memory to have space for at least length bytes
+    bool growLineBuffer(uint32_t length);
+    // Moves tail of the write buffer memory to the oldest line remaining in the buffer
+    void updateLineBufferTail();
+    // Releases points buffer and the write buffer memory
+    void freeBuffer();
+    // Creates stream compressing batch data, if compression is set. Returns nullptr if data are not compressed.
+    GzipStream *createGzipStream(BatchStreamer *bs);
+    // Returns true if buffered points should be written, flushTimeout is set when the flush interval ran out 
+    bool isFlushDue(bool &flushTimeout);
+    // Stops adding points to the batch at the index, which is going to be written. Moves buffer pointer from it, if it is the current one
+    void detachBatch(uint8_t index);
+    // Returns true if the oldest batch of any priority is full
+    bool hasFullBatch() const;
+    // Drops the batch at the index if it was written or cannot be written, or keeps it for retry and sets the retry time.
+    // retryAfter is wait in sec requested by server, if any. Returns true if the batch is kept for retry
+    bool handleWriteResult(uint8_t index, int statusCode, int retryAfter = 0);
+    // Adapts batch size to result and round trip time of a write: grows it while server responds fast, halves it when it is overloaded,
+    // or slow and writing keeps up with new points
+    void adaptBatchSize(int statusCode, uint32_t rtt);
+    // Drops batch at the index. Batches written ahead of the oldest one are released and skipped later
+    void dropBatch(uint8_t index);
+    // Marks batch at the index as written to the target, or dropped for it. Drops the batch when no other target needs it
+    void completeBatch(uint8_t index, uint8_t target);
+    // Returns bit mask of all write targets
+    uint8_t getTargetsMask() const { return (2 << _targetsCount) - 1; }
+    // Creates connection of the target, if not created yet
+    void initTarget(WriteTarget &target);
+    // Writes batches to additional targets, each until it fails
+    void flushTargets(bool flashOnlyFull);
+    // Starts asynchronous writes to additional targets, which are not writing or waiting for retry
+    void startTargetWrites(bool flashOnlyFull);
+    // Handles result of finished asynchronous write to the target at the index
+    void finishTargetWrite(uint8_t t);
+    // Drops batch at the index for the target at index t if it was written or cannot be written, 
+    // or pauses writes to the target. Returns true if the batch is kept for retry
+    bool handleTargetResult(uint8_t t, uint8_t index, int statusCode, int retryAfter = 0);
+    // Returns remaining time in ms of the pause of writes to the target
+    uint32_t getTargetPauseRemaining(const WriteTarget &target) const;
+    // Returns true if an added write target is writing the batch at the index
+    bool isTargetWriting(int16_t index) const;
+    // Returns true if asynchronous writes to additional targets are in progress
+    bool hasTargetWrites() const;
+    // Stops writes to additional targets and closes their connections
+    void cleanTargets();
+    // Pauses writes for delay ms from start, unless they are already paused for longer
+    void pauseWrites(uint32_t start, uint32_t delay, bool requested);
+    // Returns remaining time in ms of the pause of writes
+    uint32_t getWritePauseRemaining() const;
+    // Returns remaining time in ms before the oldest batch can be written, see getRemainingRetryTime
+    uint32_t getRetryRemainingInternal() const;
+    // Computes wait in ms before next attempt of a batch, which failed retryCount times. Exponential backoff with optional full jitter, capped by maxRetryInterval
+    uint32_t getRetryDelay(uint8_t retryCount) const;
+    // Resets buffer pointers if all batches were written
+    void checkBufferEmpty();
+    // Starts writing of the oldest batch not being written yet on a free slot. Returns false if there is nothing to write yet or no free slot.
+    bool startAsyncWrite(bool flashOnlyFull);
+    // Handles result of finished asynchronous write. Returns true if the batch was written
+    bool finishAsyncWrite(WriteSlot &slot);
+    // Moves pending asynchronous writes forward, at most budget ms. Sets progress if a write finished.
+    // Returns false if a finished write failed, error is then set to message of the first failure
+    bool pollAsyncWrites(uint16_t budget, bool &progress, String &error);
+    // Waits for pending asynchronous writes to finish. Returns false if any failed
+    bool completeAsyncWrite();
+    // Stops asynchronous writes, batches stay in the buffer
+    void abortAsyncWrite();
+    // Stops asynchronous write of the slot
+    void abortWrite(WriteSlot &slot);
+    // Releases write slots and their connections
+    void freeWriteSlots();
+    // Returns number of batches being written
+    uint8_t getPendingWrites() const;
+    // Returns index of the oldest batch of the highest priority, which is not empty and not being written, or -1.
+    //  onlyFull - batches of a priority are skipped when its oldest one is not full yet
+    //  target - only batches not written to the target are searched, 0 is the server set by setConnectionParams
+    int16_t nextBatchToWrite(bool onlyFull = false, uint8_t target = 0) const;
+    // Returns slot writing the batch at the index, or nullptr
+    WriteSlot *findWriteSlot(int16_t index) const;
+    // Writes batches over multiple connections at once, waits until all are finished
+    bool flushPipelined(bool flashOnlyFull);
+    // Copies line to the write buffer memory and adds it to the batch being filled for the priority
+    // Returns true if successful, false if there is not enough memory 
+    bool bufferRecord(const char *record, uint32_t length, WritePriority priority = WritePriority::Normal, uint8_t route = 0);
+    // Writes record to the bucket route, or to the route of its measurement if route is -1
+    bool writeRecordTo(const char *record, int16_t route, WritePriority priority);
+    // Writes point to the bucket route, or to the route of its measurement if route is -1
+    bool writePointTo(Point &point, int16_t route, WritePriority priority);
+    // Returns index of the bucket route, adding a new one if needed, or -1 if there are too many buckets. 0 is the default bucket
+    int16_t getBucketRoute(const String &bucket);
+    // Returns bucket route of the line, by its measurement
+    uint8_t findMeasurementRoute(const char *line) const;
+    // Returns reference to the index of the batch being filled with points of the priority and route
+    int16_t &laneBatch(WritePriority priority, uint8_t route) { return route ? _bucketRoutes[route - 1]->laneBatches[(uint8_t)priority] : _laneBatches[(uint8_t)priority]; }
+    // Returns index of the batch being filled with points of the priority and route, or -1
+    int16_t getLaneBatch(WritePriority priority, uint8_t route = 0);
+    // Prepares batch at the buffer pointer for points of the priority and route. When the buffer is full, a free place is used, 
+    // or batch of the lowest priority is overwritten, according to the overflow policy.
+    // Returns index of the batch, or -1 if the point is rejected
+    int16_t claimBatch(WritePriority priority, uint8_t route = 0);
+    // Sets all lanes to -1
+    void resetLanes();
+    // Exchanges batches at the indexes, write slots and lanes keep their batches
+    void swapBatches(uint8_t a, uint8_t b);
+    // Drops every other point of the lowest priority in the buffer, if it is not higher than the priority, except the batch at the keep index. 
+    // Remaining points are packed into the oldest batches, newer batches are emptied. New points of that priority are then sampled at the same rate.
+    // Returns false if there are not enough points to drop
+    bool decimateBuffer(WritePriority priority, int16_t keep);
+    // Stops decimation of new points
+    void resetDecimation();
+    // Moves lines from the writer task queue to the write buffer
+    void drainLineQueue();
+    // Runs work in the writer task, if running, which owns the write buffer and the connection. Otherwise runs it directly.
+    void callWriter(const std::function<void()> &work);
+    // Copies status read by other tasks, while the writer task runs
+    void publishWriterStatus();
+    // Checks connection to the server, see validateConnection
+    bool validateConnectionInternal();
+    // Adds write target, see addWriteTarget
+    bool addWriteTargetInternal(const String &serverUrl, const String &org, const String &bucket, const String &authToken, const char *certInfo);
+    // Checks buffer and flushes or continues asynchronous write, if due 
+    bool checkBufferInternal();
+    // Works on asynchronous write for the time budget
+    bool pollInternal();
     // Writes all points in buffer, with respect to the batch size, and in case of success clears the buffer.
     //  flashOnlyFull - whether to flush only full batches
     // Returns true if successful, false in case of any error 
     bool flushBufferInternal(bool flashOnlyFull);
+    // Returns false if the point hasn't changed since the last written point of its series, see WriteOptions::sendOnChange
+    bool isPointChanged(const Point &point);
+    // Returns index of the aggregation of the series of the point, or -1
+    int16_t findAggregator(const Point &point) const;
+    // Writes point of the aggregation window and starts the next one
+    bool writeAggregation(Aggregator &aggregator, uint32_t now);
+    // Writes points of all ended aggregation windows
+    bool writeAggregations();
     // Checks precision of point and mofifies if needed
     void checkPrecisions(Point & point);
     // helper which adds zeroes to timestamo of point to increase precision
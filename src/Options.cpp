@@ -47,10 +47,28 @@ void WriteOptions::printTo(Print &dest) const {
     dest.print("\t_precision: "); dest.println((uint8_t)_writePrecision);
     dest.print("\t_batchSize: "); dest.println(_batchSize);
     dest.print("\t_bufferSize: "); dest.println(_bufferSize);
+    dest.print("\t_bufferBytes: "); dest.println(_bufferBytes);
+    dest.print("\t_highWatermark: "); dest.println(_highWatermark);
+    dest.print("\t_lowWatermark: "); dest.println(_lowWatermark);
     dest.print("\t_flushInterval: "); dest.println(_flushInterval);
+    dest.print("\t_flushBytes: "); dest.println(_flushBytes);
+    dest.print("\t_alignFlushBytes: "); dest.println(_alignFlushBytes);
     dest.print("\t_retryInterval: "); dest.println(_retryInterval);
     dest.print("\t_maxRetryInterval: "); dest.println(_maxRetryInterval);
     dest.print("\t_maxRetryAttempts: "); dest.println(_maxRetryAttempts);
+    dest.print("\t_retryMultiplier: "); dest.println(_retryMultiplier);
+    dest.print("\t_retryJitter: "); dest.println(_retryJitter);
     dest.print("\t_defaultTags: "); dest.println(_defaultTags);
     dest.print("\t_useServerTimestamp: "); dest.println(_useServerTimestamp);
+    dest.print("\t_compression: "); dest.println((uint8_t)_compression);
+    dest.print("\t_asyncBudget: "); dest.println(_asyncBudget);
+    dest.print("\t_asyncConnectTimeout: "); dest.println(_asyncConnectTimeout);
+    dest.print("\t_maxInFlight: "); dest.println(_maxInFlight);
+    dest.print("\t_minBatchSize: "); dest.println(_minBatchSize);
+    dest.print("\t_targetRtt: "); dest.println(_targetRtt);
+    dest.print("\t_overflowPolicy: "); dest.println((uint8_t)_overflowPolicy);
+    dest.print("\t_deadbandAbsolute: "); dest.println(_deadbandAbsolute);
+    dest.print("\t_deadbandRelative: "); dest.println(_deadbandRelative);
+    dest.print("\t_heartbeatInterval: "); dest.println(_heartbeatInterval);
+    dest.print("\t_changeFilterSize: "); dest.println(_changeFilterSize);
 }
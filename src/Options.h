@@ -29,6 +29,52 @@
 
 #include "WritePrecision.h"
 
+// Enum Compression defines how data are compressed when sent to server
+enum class Compression:uint8_t {
+  // Data are not compressed (default)
+  None = 0,
+  // Data are compressed using gzip and sent with Content-Encoding: gzip
+  Gzip
+};
+
+// Enum WritePriority defines lanes of the write buffer. Points of higher priority are written first and overwritten last
+enum class WritePriority:uint8_t {
+  // Points, which can be lost first, when the write buffer is full
+  Low = 0,
+  // Default priority
+  Normal,
+  // Points, like alarms, which must be written as soon as possible
+  High
+};
+
+// Enum OverflowPolicy defines what happens to points, when the write buffer is full
+enum class OverflowPolicy:uint8_t {
+  // The oldest points are overwritten (default)
+  DropOldest = 0,
+  // New points are rejected, buffered points are kept
+  DropNewest,
+  // Every other point in the buffer is dropped and new points are sampled at the same rate, so the buffer covers the whole outage
+  Decimate
+};
+
+// Enum AggregateFunction defines fields written for an aggregated series. Functions can be combined, e.g. AggregateFunction::Min | AggregateFunction::Max
+enum class AggregateFunction:uint8_t {
+  // Average value, field name gets suffix _mean
+  Mean = 1,
+  // Minimal value, suffix _min
+  Min = 2,
+  // Maximal value, suffix _max
+  Max = 4,
+  // Number of values, suffix _count
+  Count = 8,
+  // The last value, suffix _last
+  Last = 16
+};
+
+inline AggregateFunction operator|(AggregateFunction a, AggregateFunction b) {
+  return (AggregateFunction)((uint8_t)a | (uint8_t)b);
+}
+
 class InfluxDBClient;
 class HTTPService;
 class Influxdb;
@@ -51,9 +97,22 @@ private:
     // When max size is reached, oldest records are overwritten.
     // Default 5
     uint16_t _bufferSize;
+    // Maximum size of memory in bytes for keeping records in the write buffer. 
+    // When max size is reached, oldest records are overwritten.
+    // Default 0 - memory size is not limited, only number of records.
+    uint32_t _bufferBytes;
+    // Percentage of write buffer usage, when producers should slow down. Default 80%
+    uint8_t _highWatermark;
+    // Percentage of write buffer usage, when producers can continue normally. Default 50%
+    uint8_t _lowWatermark;
     // Maximum number of seconds points can be held in buffer before are written to the db. 
     // Buffer is flushed when it reaches batch size or when flush interval runs out. 
     uint16_t _flushInterval;
+    // Size of the encoded batch in bytes, when it is closed and written to the db, regardless of the batch size.
+    // Default 0 - batch is written only when it reaches batch size
+    uint32_t _flushBytes;
+    // Whether _flushBytes is rounded down to the multiple of the TLS max fragment length or the HTTP send buffer size
+    bool _alignFlushBytes;
     // Default retry interval in sec, if not sent by server. Default 5s. 
     // Setting to zero disables retrying.
     uint16_t _retryInterval;
@@ -61,21 +120,65 @@ private:
     uint16_t _maxRetryInterval;
     // Maximum count of retry attempts of failed writes, default 3
     uint16_t _maxRetryAttempts;
+    // Multiplier of the retry interval for each next attempt of a batch, default 0 - the retry interval itself, as in previous versions
+    uint8_t _retryMultiplier;
+    // Whether the retry interval is randomized between zero and the computed value, default false
+    bool _retryJitter;
     // Default tags. Default tags are added to every written point. 
     // There cannot be the same tags in the default tags and among the tags included with a point.
     String _defaultTags;
     //  Let server assign timestamp in given precision. Do not sent timestamp.
     bool _useServerTimestamp;
+    // Compression of written data. Default none.
+    Compression _compression;
+    // Max time [ms] of work in a single call of checkBuffer or poll, when writing asynchronously. 
+    // Default 0 - data are written synchronously.
+    uint16_t _asyncBudget;
+    // Max time [ms] of connecting to server, when writing asynchronously. Default 1000ms.
+    uint16_t _asyncConnectTimeout;
+    // Max number of batches being written at once, each over its own connection. Default 1.
+    uint8_t _maxInFlight;
+    // Minimum batch size, when batch size is adapted to measured write latency. Default 0 - adapting disabled.
+    uint16_t _minBatchSize;
+    // Target round trip time [ms] of a write request, when adapting batch size. Default 1000ms.
+    uint16_t _targetRtt;
+    // What happens to points when the write buffer is full. Default the oldest points are overwritten.
+    OverflowPolicy _overflowPolicy;
+    // Deadband of numeric fields for the send-on-change filter, absolute and relative to the last written value
+    double _deadbandAbsolute;
+    float _deadbandRelative;
+    // Interval in sec after which an unchanged point is written anyway. 0 - disabled
+    uint16_t _heartbeatInterval;
+    // Number of fields remembered by the send-on-change filter. Default 0 - filter disabled.
+    uint16_t _changeFilterSize;
 public:
     WriteOptions():
         _writePrecision(WritePrecision::NoTime),
         _batchSize(1),
         _bufferSize(5),
+        _bufferBytes(0),
+        _highWatermark(80),
+        _lowWatermark(50),
         _flushInterval(60),
+        _flushBytes(0),
+        _alignFlushBytes(false),
         _retryInterval(5),
         _maxRetryInterval(300),
         _maxRetryAttempts(3),
-        _useServerTimestamp(false) {
+        _retryMultiplier(0),
+        _retryJitter(false),
+        _useServerTimestamp(false),
+        _compression(Compression::None),
+        _asyncBudget(0),
+        _asyncConnectTimeout(1000),
+        _maxInFlight(1),
+        _minBatchSize(0),
+        _targetRtt(1000),
+        _overflowPolicy(OverflowPolicy::DropOldest),
+        _deadbandAbsolute(0),
+        _deadbandRelative(0),
+        _heartbeatInterval(0),
+        _changeFilterSize(0) {
         }
     // Sets timestamp precision. If timestamp precision is set, but a point does not have a timestamp, timestamp is automatically assigned from the device clock.
     // If useServerTimestamp is set to true, timestamp is not sent, only precision is specified for the server.
@@ -83,10 +186,26 @@ public:
     // Sets number of points that will be written to the databases at once. Points are added one by one and when number reaches batch size there are sent to server.
     WriteOptions& batchSize(uint16_t batchSize) { _batchSize = batchSize; return *this; }
     // Sets size of the write buffer to control maximum number of record to keep in case of write failures.
-    // When max size is reached, oldest records are overwritten.
+    // When max size is reached, oldest records are overwritten, unless other overflowPolicy is set.
     WriteOptions& bufferSize(uint16_t bufferSize) { _bufferSize = bufferSize; return *this; }
+    // Sets maximum size of memory in bytes for keeping records in the write buffer. Memory is allocated at once, when the first record is written.
+    // When max size is reached, oldest records are overwritten, unless other overflowPolicy is set. Maximum number of records set by bufferSize still applies.
+    // Zero means memory size is limited only by bufferSize.
+    WriteOptions& bufferBytes(uint32_t maxBytes) { _bufferBytes = maxBytes; return *this; }
+    // Sets write buffer usage in percents of its size (bufferBytes, or bufferSize if bufferBytes is not set) for signaling back-pressure. 
+    // When the usage reaches highPercent, InfluxDBClient::isAboveHighWatermark() returns true, until the usage drops to lowPercent.
+    // highPercent is limited to 1-100 and lowPercent is kept below it, so the state doesn't flip with each write.
+    WriteOptions& bufferWatermarks(uint8_t highPercent, uint8_t lowPercent) { 
+        _highWatermark = highPercent > 100 ? 100 : highPercent ? highPercent : 1; _lowWatermark = lowPercent < _highWatermark ? lowPercent : _highWatermark - 1; return *this; }
     // Sets interval in seconds after whitch points will be written to the db. If 
     WriteOptions& flushInterval(uint16_t flushIntervalSec) { _flushInterval = flushIntervalSec; return *this; }
+    // Sets size of the encoded batch in bytes (line protocol incl. new lines), when it is written to the db, even if it hasn't reached batch size.
+    // Batch is closed before a point would make it exceed the size, so a request body is not larger than maxBytes, unless a single point is larger.
+    // If alignToSendBlock is true, size is rounded down to a multiple of the negotiated TLS max fragment length (ESP8266), 
+    // or of the HTTP client send buffer size, so request body fills whole TLS records/TCP segments. Size smaller than the block is kept.
+    // Size is not aligned when compression is enabled, as the compressed body is smaller by a varying ratio.
+    // Zero disables flushing by size.
+    WriteOptions& flushBytes(uint32_t maxBytes, bool alignToSendBlock = false) { _flushBytes = maxBytes; _alignFlushBytes = alignToSendBlock; return *this; }
     // Sets default retry interval in sec. This is used in case of network failure or if server is bussy and doesn't specify retry interval.  
     // Setting to zero disables retrying.
     WriteOptions& retryInterval(uint16_t retryIntervalSec) { _retryInterval = retryIntervalSec; return *this; }
@@ -94,6 +213,10 @@ public:
     WriteOptions& maxRetryInterval(uint16_t maxRetryIntervalSec) { _maxRetryInterval = maxRetryIntervalSec; return *this; }
     // Sets maximum number of retry attempts of failed writes.
     WriteOptions& maxRetryAttempts(uint16_t maxRetryAttempts) { _maxRetryAttempts = maxRetryAttempts; return *this; }
+    // Sets backoff of failed writes. Each batch waits retryInterval * multiplier^(attempts-1), at most maxRetryInterval, before it is written again.
+    // With fullJitter, the wait is a random value between zero and that, so devices failing at the same time don't retry at the same time.
+    // Multiplier 1 sets constant interval. Multiplier 0, the default, multiplies by retryInterval, i.e. 5, 25, 125s for the default interval.
+    WriteOptions& retryBackoff(uint8_t multiplier, bool fullJitter = false) { _retryMultiplier = multiplier; _retryJitter = fullJitter; return *this; }
     // Adds new default tag. Default tags are added to every written point. 
     // There cannot be the same tag in the default tags and in the tags included with a point.
     WriteOptions& addDefaultTag(const String &name, const String &value);
@@ -101,6 +224,41 @@ public:
     WriteOptions& clearDefaultTags() { _defaultTags = (char *)nullptr; return *this; }
     // If timestamp precision is set and useServerTimestamp  is true, timestamp from point is not sent, or assigned.
     WriteOptions& useServerTimestamp(bool useServerTimestamp) { _useServerTimestamp = useServerTimestamp; return *this; }
+    // Sets compression of written data. Gzip reduces amount of sent data about 4 times, but it takes more CPU time and ~4KB of memory 
+    // plus the compressed batch during writing.
+    // Compressed data are always streamed, regardless of InfluxDBClient::setStreamWrite.
+    WriteOptions& compression(Compression compression) { _compression = compression; return *this; }
+    // Enables asynchronous writing. Batches are written step by step (connect, send a block, read response) in subsequent calls 
+    // of InfluxDBClient::checkBuffer() or InfluxDBClient::poll(), each working at most budgetMs. writePoint doesn't wait for server.
+    // The budget doesn't apply to connecting, which cannot be split: the call connecting blocks up to connectTimeoutMs. On ESP32, TCP connect and 
+    // TLS handshake are each limited to connectTimeoutMs (the handshake rounded up to whole seconds), and DNS lookup has its own timeout. 
+    // Use connection reuse to connect rarely.
+    // On ESP32, sending over TLS waits until the data block is passed to the socket, which can take longer than budgetMs when the socket buffer is full.
+    // Zero budget sets synchronous writing.
+    WriteOptions& asyncWrite(uint16_t budgetMs, uint16_t connectTimeoutMs = 1000) { _asyncBudget = budgetMs; _asyncConnectTimeout = connectTimeoutMs; return *this; }
+    // Sets max number of batches being written at once. Each batch is sent over its own connection, without waiting for responses to previous batches, 
+    // so a backlog is written in about a single round trip. Each batch is acknowledged, retried or dropped independently. 
+    // Connections are opened as needed and each takes memory of a WiFi client, so keep it low with TLS. 
+    // Applies to asynchronous writing and also to flushBuffer(), which then waits for all batches. Default 1.
+    WriteOptions& maxInFlight(uint8_t maxInFlight) { _maxInFlight = maxInFlight?maxInFlight:1; return *this; }
+    // Enables adapting of the batch size to the measured write latency. Batch size set by batchSize() is then the maximum.
+    // While writes take at most targetRttMs, the batch grows step by step. When a write fails on network or server is overloaded (429, 503),
+    // the batch is halved, down to minBatchSize. A slower write halves it too, unless writing falls behind and a full batch is already waiting, 
+    // as smaller batches would then lower throughput. Batches are shrunk by closing them early, so no buffered point is lost.
+    // Note, the write buffer keeps bufferSize/batchSize batches, so smaller batches hold fewer points in case of failures. 
+    // Zero minBatchSize disables adapting.
+    WriteOptions& adaptiveBatchSize(uint16_t minBatchSize, uint16_t targetRttMs = 1000) { _minBatchSize = minBatchSize; _targetRtt = targetRttMs; return *this; }
+    // Sets what happens when the write buffer (bufferSize or bufferBytes) is full: the oldest points are overwritten (default), 
+    // new points are rejected, or the buffer is decimated, keeping every k-th point of the whole outage, with k doubled each time the buffer fills up.
+    // Points of a higher priority are always kept over a lower one. Lost points are counted by InfluxDBClient::getDroppedPoints().
+    WriteOptions& overflowPolicy(OverflowPolicy policy) { _overflowPolicy = policy; return *this; }
+    // Enables send-on-change filtering of points written by writePoint. A point is written only if a field changed since the last written point of its series,
+    // a numeric field by more than absolute deadband, or relative part of its last written value, whichever is greater. 
+    // Unchanged point is written anyway after heartbeatSec, zero disables it. Last values of tableSize fields of all series are kept in a table allocated at once,
+    // 24 bytes per field. Zero tableSize disables filtering.
+    WriteOptions& sendOnChange(double absolute, float relative = 0, uint16_t heartbeatSec = 600, uint16_t tableSize = 64) { 
+        _deadbandAbsolute = absolute; _deadbandRelative = relative; _heartbeatInterval = heartbeatSec; _changeFilterSize = tableSize; return *this; 
+    }
     // prints options values to a Print device. E.g. opts.printTo(Serial);
     void printTo(Print &dest) const;
 };
@@ -120,15 +278,24 @@ private:
     // Timeout [ms] for reading server response.
     // Default 5000ms  
     int _httpReadTimeout;
+    // Compression of query response the server is asked for. Default none.
+    Compression _queryCompression;
 public:
     HTTPOptions():
         _connectionReuse(false),
-        _httpReadTimeout(5000) {
+        _httpReadTimeout(5000),
+        _queryCompression(Compression::None) {
         }
     // Set true if HTTP connection should be kept open. Usable for frequent writes.
     HTTPOptions& connectionReuse(bool connectionReuse) { _connectionReuse = connectionReuse; return *this; }
     // Sets timeout after which HTTP stops reading
     HTTPOptions& httpReadTimeout(int httpReadTimeoutMs) { _httpReadTimeout = httpReadTimeoutMs; return *this; }
+    // Sets compression of query response. With Compression::Gzip, server is asked for gzip compressed response, which is inflated while being read.
+    // On ESP32 with Arduino core 3 the request stays HTTP/1.1. With older cores and ESP8266, HTTPClient sends its own Accept-Encoding header
+    // in HTTP/1.1 requests, so the request is sent as HTTP/1.0 and the connection is not reused.
+    // Servers compress with the full 32KB gzip window, so inflating needs a 32KB window as well. A smaller INFLUXDB_CLIENT_GUNZIP_WINDOW works 
+    // only with a server limiting its window. On ESP8266 gzip is refused unless INFLUXDB_CLIENT_GUNZIP_WINDOW is defined.
+    HTTPOptions& queryCompression(Compression compression) { _queryCompression = compression; return *this; }
 };
 
 #endif //_OPTIONS_H_
@@ -15,6 +15,10 @@
 # include <esp_arduino_version.h>
 # define INFLUXDB_CLIENT_PLATFORM "ESP32"
 # define INFLUXDB_CLIENT_PLATFORM_VERSION VERSION_STR(ESP_ARDUINO_VERSION_MAJOR, ESP_ARDUINO_VERSION_MINOR, ESP_ARDUINO_VERSION_PATCH)
+// HTTPClient can replace its Accept-Encoding header of HTTP/1.1 requests
+# if ESP_ARDUINO_VERSION_MAJOR >= 3
+#  define INFLUXDB_CLIENT_HTTP_ACCEPT_ENCODING
+# endif
 #endif
 
 #endif //_PLATFORM_H_
\ No newline at end of file
@@ -27,6 +27,7 @@
 
 #include "Point.h"
 #include "util/helpers.h"
+#include "util/MemoryStats.h"
 
 Point::Point(const String & measurement)
 {
@@ -36,15 +37,46 @@ Point::Point(const String & measurement)
 Point::~Point() {
 }
 
+// Strings are accounted in blocks, like the heap allocates them, so adding a short field mostly doesn't change counters
+static const uint32_t AccountingBlock = 16;
+
+static uint32_t accountingBlocks(uint32_t len) {
+  return (len + AccountingBlock - 1) & ~(AccountingBlock - 1);
+}
+
 Point::Data::Data(char * measurement) {
   this->measurement = measurement;
+  measurementSize = strLen(measurement) + 1;
   timestamp = nullptr;
+  timestampSize = 0;
   tsWritePrecision = WritePrecision::NoTime;
+  fieldsReserved = 0;
+  prefixLength = 0;
+  includedLength = 0;
+  lineReserved = 0;
+  accounted = sizeof(Data) + measurementSize;
+  MemoryAccounting::allocated(MemorySubsystem::Points, accounted);
 }
 
 Point::Data::~Data() {
   delete [] measurement;
   delete [] timestamp;
+  MemoryAccounting::released(MemorySubsystem::Points, accounted);
+}
+
+void Point::Data::account() {
+  if(fields.length() > fieldsReserved) {
+    fieldsReserved = accountingBlocks(fields.length());
+  }
+  if(line.length() > lineReserved) {
+    lineReserved = accountingBlocks(line.length());
+  }
+  // size of the timestamp is kept by setters
+  uint32_t bytes = sizeof(Data) + measurementSize + accountingBlocks(tags.length()) + fieldsReserved + (timestamp ? timestampSize : 0) + lineReserved;
+  if(bytes != accounted) {
+    MemoryAccounting::resized(MemorySubsystem::Points, accounted, bytes);
+    accounted = bytes;
+  }
 }
 
 Point::Point(const Point &other) {
@@ -58,88 +90,108 @@ Point& Point::operator=(const Point &other) {
   return *this;
 }
 
-void Point::addTag(const String &name, String value) {
+void Point::addTag(const KeyName &name, String value) {
   if(_data->tags.length() > 0) {
       _data->tags += ',';
   }
-  char *s = escapeKey(name);
-  _data->tags += s;
-  delete [] s;
+  KeyCache::append(_data->tags, name);
   _data->tags += '=';
-  s = escapeKey(value);
+  char *s = escapeKey(value);
   _data->tags += s;
   delete [] s;
+  _data->prefixLength = 0;
+  _data->account();
 }
 
-void Point::addField(const String &name, long long value) {
-  char buff[23];
-  snprintf(buff, 50, "%lld", value);
-  putField(name, String(buff)+"i");
+void Point::addField(const KeyName &name, long long value) {
+  char buff[MaxNumberLength + 2];
+  uint8_t len = formatInteger(buff, value);
+  buff[len++] = 'i';
+  buff[len] = 0;
+  putField(name, buff);
 }
 
-void Point::addField(const String &name, unsigned long long value) {
-  char buff[23];
-  snprintf(buff, 50, "%llu", value);
-  putField(name, String(buff)+"i");
+void Point::addField(const KeyName &name, unsigned long long value) {
+  char buff[MaxNumberLength + 2];
+  uint8_t len = formatUnsigned(buff, value);
+  buff[len++] = 'i';
+  buff[len] = 0;
+  putField(name, buff);
 }
 
-void Point::addField(const String &name, const char *value) { 
+void Point::addField(const KeyName &name, const char *value) { 
     putField(name, escapeValue(value)); 
 }
 
-void Point::addField(const String &name, const __FlashStringHelper *pstr) {
+void Point::addField(const KeyName &name, const __FlashStringHelper *pstr) {
     addField(name, String(pstr));
 }
 
-void Point::addField(const String &name, float value, int decimalPlaces) { 
-    if(!isnan(value)) putField(name, String(value, decimalPlaces)); 
+void Point::addField(const KeyName &name, float value, int decimalPlaces) { 
+    if(!isnan(value)) {
+        char buff[MaxNumberLength + 1];
+        if(decimalPlaces < 0) {
+            formatShortest(buff, value);
+        } else {
+            formatDecimal(buff, value, decimalPlaces);
+        }
+        putField(name, buff);
+    }
 }
 
-void Point::addField(const String &name, double value, int decimalPlaces) {
-    if(!isnan(value)) putField(name, String(value, decimalPlaces)); 
+void Point::addField(const KeyName &name, double value, int decimalPlaces) {
+    if(!isnan(value)) {
+        char buff[MaxNumberLength + 1];
+        formatDecimal(buff, value, decimalPlaces);
+        putField(name, buff);
+    }
 }
 
-void Point::addField(const String &name, char value) { 
-    addField(name, String(value).c_str()); 
+void Point::addField(const KeyName &name, char value) { 
+    char buff[2] = { value, 0 };
+    addField(name, buff); 
 }
 
-void Point::addField(const String &name, unsigned char value) {
-    putField(name, String(value)+"i"); 
+void Point::addField(const KeyName &name, unsigned char value) {
+    addField(name, (unsigned long long)value); 
 }
 
-void Point::addField(const String &name, int value) { 
-    putField(name, String(value)+"i"); 
+void Point::addField(const KeyName &name, int value) { 
+    addField(name, (long long)value); 
 }
 
-void Point::addField(const String &name, unsigned int value) { 
-    putField(name, String(value)+"i"); 
+void Point::addField(const KeyName &name, unsigned int value) { 
+    addField(name, (unsigned long long)value); 
 }
 
-void Point::addField(const String &name, long value)  { 
-    putField(name, String(value)+"i"); 
+void Point::addField(const KeyName &name, long value)  { 
+    addField(name, (long long)value); 
 }
 
-void Point::addField(const String &name, unsigned long value) { 
-    putField(name, String(value)+"i"); 
+void Point::addField(const KeyName &name, unsigned long value) { 
+    addField(name, (unsigned long long)value); 
 }
 
-void Point::addField(const String &name, bool value)  { 
+void Point::addField(const KeyName &name, bool value)  { 
     putField(name, bool2string(value)); 
 }
 
-void Point::addField(const String &name, const String &value)  { 
+void Point::addField(const KeyName &name, const String &value)  { 
     addField(name, value.c_str()); 
 }
 
-void Point::putField(const String &name, const String &value) {
+void Point::putField(const KeyName &name, const String &value) {
+    putField(name, value.c_str());
+}
+
+void Point::putField(const KeyName &name, const char *value) {
     if(_data->fields.length() > 0) {
         _data->fields += ',';
     }
-    char *s = escapeKey(name);
-    _data->fields += s;
-    delete [] s;
+    KeyCache::append(_data->fields, name);
     _data->fields += '=';
     _data->fields += value;
+    _data->account();
 }
 
 String Point::toLineProtocol(const String &includeTags) const {
@@ -147,27 +199,71 @@ String Point::toLineProtocol(const String &includeTags) const {
 }
 
 String Point::createLineProtocol(const String &incTags, bool excludeTimestamp) const {
+    const char *timestamp = hasTime() && !excludeTimestamp ? _data->timestamp : nullptr;
     String line;
-    line.reserve(strLen(_data->measurement) + 1 + incTags.length() + 1 + _data->tags.length() + 1 + _data->fields.length() + 1 + strLen(_data->timestamp));
+    if(isPrefixValid(incTags)) {
+        // copy of the series prefix encoded by the last write
+        line.reserve(_data->prefixLength + 1 + _data->fields.length() + 1 + strLen(timestamp));
+        line.concat(_data->line.c_str(), _data->prefixLength);
+    } else {
+        line.reserve(strLen(_data->measurement) + 1 + incTags.length() + 1 + _data->tags.length() + 1 + _data->fields.length() + 1 + strLen(timestamp));
+        encodePrefix(line, incTags);
+    }
+    if(hasFields()) {
+        line += " ";
+        line += _data->fields;
+    }
+    if(timestamp) {
+        line += " ";
+        line += timestamp;
+    }
+    return line;
+}
+
+bool Point::isPrefixValid(const String &incTags) const {
+    return _data->prefixLength && _data->includedLength == incTags.length() 
+        && (!_data->includedLength || !memcmp(_data->line.c_str() + strLen(_data->measurement) + 1, incTags.c_str(), incTags.length()));
+}
+
+void Point::encodePrefix(String &line, const String &incTags) const {
     line += _data->measurement;
-    if(incTags.length()>0) {
-        line += ",";
+    if(incTags.length() > 0) {
+        line += ',';
         line += incTags;
     }
     if(hasTags()) {
-        line += ",";
+        line += ',';
         line += _data->tags;
     }
+}
+
+const char *Point::encodeLine(const String &incTags, bool excludeTimestamp) const {
+    Data &d = *_data;
+    if(isPrefixValid(incTags)) {
+        d.line.remove(d.prefixLength);
+    } else {
+        // emptying keeps the memory of the line
+        d.line = "";
+        encodePrefix(d.line, incTags);
+        d.prefixLength = d.line.length();
+        d.includedLength = incTags.length();
+    }
+    const char *timestamp = hasTime() && !excludeTimestamp ? d.timestamp : nullptr;
+    uint32_t reserved = d.lineReserved;
+    d.line.reserve(d.prefixLength + 1 + d.fields.length() + 1 + strLen(timestamp));
     if(hasFields()) {
-        line += " ";
-        line += _data->fields;
+        d.line += ' ';
+        d.line += d.fields;
     }
-    if(hasTime() && !excludeTimestamp) {
-        line += " ";
-        line += _data->timestamp;
+    if(timestamp) {
+        d.line += ' ';
+        d.line += timestamp;
     }
-    return line;
- }
+    if(d.line.length() > reserved) {
+        d.account();
+    }
+    return d.line.c_str();
+}
 
 void Point::setTime(WritePrecision precision) {
     struct timeval tv;
@@ -194,7 +290,16 @@ void Point::setTime(WritePrecision precision) {
 }
 
 void  Point::setTime(unsigned long long timestamp) {
-    setTime(timeStampToString(timestamp));
+    if(_data->timestamp && _data->timestampSize > MaxNumberLength) {
+        // memory of the previous timestamp is reused
+        formatUnsigned(_data->timestamp, timestamp);
+        _data->account();
+        return;
+    }
+    delete [] _data->timestamp;
+    _data->timestamp = timeStampToString(timestamp);
+    _data->timestampSize = MaxNumberLength + 1;
+    _data->account();
 }
 
 void Point::setTime(const String &timestamp) {
@@ -208,14 +313,33 @@ void Point::setTime(const char *timestamp) {
 void Point::setTime(char *timestamp) {
     delete [] _data->timestamp;
     _data->timestamp = timestamp;
+    _data->timestampSize = timestamp ? strlen(timestamp) + 1 : 0;
+    _data->account();
 }
 
 void  Point::clearFields() {
     _data->fields = (char *)nullptr;
+    _data->fieldsReserved = 0;
+    _data->line = (char *)nullptr;
+    _data->prefixLength = 0;
+    _data->lineReserved = 0;
     delete [] _data->timestamp;
     _data->timestamp = nullptr;
+    _data->timestampSize = 0;
+    _data->account();
+}
+
+void Point::reset() {
+    // assigning empty string keeps the memory
+    _data->fields = "";
+    if(_data->timestamp) {
+        _data->timestamp[0] = 0;
+    }
+    _data->tsWritePrecision = WritePrecision::NoTime;
 }
 
 void Point:: clearTags() {
     _data->tags = (char *)nullptr;
+    _data->prefixLength = 0;
+    _data->account();
 }
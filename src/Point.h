@@ -30,6 +30,8 @@
 #include <Arduino.h>
 #include "WritePrecision.h"
 #include "util/helpers.h"
+#include "util/NumberFormat.h"
+#include "util/KeyCache.h"
 #include <memory>
 
 /**
@@ -38,28 +40,36 @@
  */
 class Point {
 friend class InfluxDBClient;
+friend class Aggregator;
+friend class ChangeFilter;
   public:
     Point(const String &measurement);
     Point(const Point &other);
     Point& operator=(const Point &other);
     virtual ~Point();
-    // Adds string tag 
-    void addTag(const String &name, String value);
-    // Add field with various types
-    void addField(const String &name, float value, int decimalPlaces = 2);
-    void addField(const String &name, double value, int decimalPlaces = 2);
-    void addField(const String &name, char value);
-    void addField(const String &name, unsigned char value);
-    void addField(const String &name, int value);
-    void addField(const String &name, unsigned int value);
-    void addField(const String &name, long value);
-    void addField(const String &name, unsigned long value);
-    void addField(const String &name, bool value);
-    void addField(const String &name, const String &value);
-    void addField(const String &name, const __FlashStringHelper *pstr);
-    void addField(const String &name, long long value);
-    void addField(const String &name, unsigned long long value);
-    void addField(const String &name, const char *value);
+    // Adds string tag. Names can be String, char array or flash string, e.g. F("name"). Escaped names are cached, see KeyCache
+    void addTag(const KeyName &name, String value);
+    // Add field with various types. Floating point numbers are written with decimalPlaces, 
+    // or by the round-trip representation, the least digits which parse back to the same value, when decimalPlaces is DecimalPlacesShortest
+    void addField(const KeyName &name, float value, int decimalPlaces = 2);
+    void addField(const KeyName &name, double value, int decimalPlaces = 2);
+    void addField(const KeyName &name, char value);
+    void addField(const KeyName &name, unsigned char value);
+    void addField(const KeyName &name, int value);
+    void addField(const KeyName &name, unsigned int value);
+    void addField(const KeyName &name, long value);
+    void addField(const KeyName &name, unsigned long value);
+    void addField(const KeyName &name, bool value);
+    void addField(const KeyName &name, const String &value);
+    void addField(const KeyName &name, const __FlashStringHelper *pstr);
+    void addField(const KeyName &name, long long value);
+    void addField(const KeyName &name, unsigned long long value);
+    void addField(const KeyName &name, const char *value);
+    // Names given as String, also temporary or converted to String, are kept for compatibility and passed as KeyName
+    template<typename V>
+    void addTag(const String &name, V value) { addTag(KeyName(name), String(value)); }
+    template<typename V, typename... P>
+    void addField(const String &name, V value, P... params) { addField(KeyName(name), value, params...); }
     // Set timestamp to `now()` and store it in specified precision, nanoseconds by default. Date and time must be already set. See `configTime` in the device API
     void setTime(WritePrecision writePrecision = WritePrecision::NS);
     // Set timestamp in offset since epoch (1.1.1970). Correct precision must be set InfluxDBClient::setWriteOptions.
@@ -70,6 +80,9 @@ friend class InfluxDBClient;
     void setTime(const char *timestamp);
     // Clear all fields. Usefull for reusing point  
     void clearFields();
+    // Clears fields and timestamp for the next sample of the same series. Unlike clearFields, it keeps allocated memory,
+    // so a point reused for each sample doesn't allocate, once it has grown to the size of a sample. Measurement and tags are kept.
+    void reset();
     // Clear tags
     void clearTags();
     // True if a point contains at least one field. Points without a field cannot be written to db
@@ -88,18 +101,44 @@ friend class InfluxDBClient;
         Data(char *measurement);
         ~Data();
         char *measurement;
+        // Length of the measurement with the terminating zero
+        uint16_t measurementSize;
         String tags;
         String fields;
         char *timestamp;
+        // Size of memory allocated for the timestamp, it is reused by setTime(unsigned long long)
+        uint8_t timestampSize;
         WritePrecision tsWritePrecision;
+        // Max length of fields since they were freed, as String keeps its memory, rounded up to accounting blocks
+        uint16_t fieldsReserved;
+        // Encoded line, starting with the series prefix: measurement, included tags and tags
+        String line;
+        // Length of the prefix in the line, 0 when the prefix must be rebuilt
+        uint16_t prefixLength;
+        // Length of the included tags in the prefix
+        uint16_t includedLength;
+        // Max length of the line since it was freed, rounded up to accounting blocks
+        uint16_t lineReserved;
+        // Bytes reported to memory accounting
+        uint32_t accounted;
+        // Updates accounted memory after data was changed, counters are changed only when a block of memory is added or released
+        void account();
     };
     std::shared_ptr<Data> _data;
   protected:    
     // method for formating field into line protocol
-    void putField(const String &name, const String &value);
+    void putField(const KeyName &name, const String &value);
+    void putField(const KeyName &name, const char *value);
     // set timestamp
     void setTime(char *timestamp);
     // Creates line protocol string
     String createLineProtocol(const String &incTags, bool excludeTimestamp = false) const;
+    // Encodes line protocol into the line kept by the point, valid until the point is changed. The series prefix is encoded again
+    // only when tags or included tags have changed, otherwise just fields and timestamp are appended to it
+    const char *encodeLine(const String &incTags, bool excludeTimestamp) const;
+    // True if the series prefix in the line was encoded with the same included tags and tags
+    bool isPrefixValid(const String &incTags) const;
+    // Appends measurement, included tags and tags
+    void encodePrefix(String &line, const String &incTags) const;
 };
 #endif //_POINT_H_
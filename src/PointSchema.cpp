@@ -0,0 +1,187 @@
+/**
+ * 
+ * PointSchema.cpp: Schema of points with constant measurement, tag and field names
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "PointSchema.h"
+#include "util/helpers.h"
+#include "util/NumberFormat.h"
+#include "util/MemoryStats.h"
+
+PointSchemaBase::PointSchemaBase(const char *measurement, std::initializer_list<const char *> tagNames, std::initializer_list<const char *> fieldNames, uint8_t tagsCount, uint8_t fieldsCount):
+    _tagsCount(tagsCount),_fieldsCount(fieldsCount) {
+    if(tagNames.size() != tagsCount || fieldNames.size() != fieldsCount || !fieldsCount || !measurement) {
+        return;
+    }
+    uint8_t parts = 1 + tagsCount + fieldsCount;
+    size_t length = escapeKeyTo(nullptr, 0, measurement, false);
+    for(const char *name : tagNames) {
+        length += escapeKeyTo(nullptr, 0, name) + 1;
+    }
+    for(const char *name : fieldNames) {
+        length += escapeKeyTo(nullptr, 0, name) + 1;
+    }
+    if(length > 0xFFFF) {
+        return;
+    }
+    uint32_t bytes = parts*sizeof(uint16_t) + length;
+    _layout = (uint16_t *)malloc(bytes);
+    if(!_layout) {
+        return;
+    }
+    MemoryAccounting::allocated(MemorySubsystem::Points, bytes);
+    char *names = (char *)(_layout + parts);
+    uint16_t end = escapeKeyTo(names, length, measurement, false);
+    uint8_t i = 0;
+    _layout[i++] = end;
+    for(const char *name : tagNames) {
+        end += escapeKeyTo(names + end, length - end, name);
+        names[end++] = '=';
+        _layout[i++] = end;
+    }
+    for(const char *name : fieldNames) {
+        end += escapeKeyTo(names + end, length - end, name);
+        names[end++] = '=';
+        _layout[i++] = end;
+    }
+}
+
+PointSchemaBase::~PointSchemaBase() {
+    if(_layout) {
+        MemoryAccounting::released(MemorySubsystem::Points, (1 + _tagsCount + _fieldsCount)*sizeof(uint16_t) + _layout[_tagsCount + _fieldsCount]);
+    }
+    free(_layout);
+}
+
+// Appends to a buffer of a fixed size, remembers overflow
+class LineWriter {
+  public:
+    LineWriter(char *buff, size_t size):_buff(buff),_size(size) {}
+    void append(const char *s, size_t len) {
+        if(_length + len < _size) {
+            memcpy(_buff + _length, s, len);
+        }
+        _length += len;
+    }
+    void append(char c) {
+        if(_length + 1 < _size) {
+            _buff[_length] = c;
+        }
+        _length++;
+    }
+    void appendEscaped(const char *key) {
+        _length += escapeKeyTo(_buff + _length, _length < _size ? _size - _length - 1 : 0, key);
+    }
+    // Appends number of length formatted into tmp, which has space for the suffix
+    void appendNumber(char *tmp, uint8_t length, char suffix = 0) {
+        if(suffix) {
+            tmp[length++] = suffix;
+        }
+        append(tmp, length);
+    }
+    // Returns length of the line and terminates it, or 0 if it didn't fit
+    size_t finish() {
+        if(_length >= _size) {
+            return 0;
+        }
+        _buff[_length] = 0;
+        return _length;
+    }
+  private:
+    char *_buff;
+    size_t _size;
+    size_t _length = 0;
+};
+
+size_t PointSchemaBase::encode(char *buff, size_t size, std::initializer_list<const char *> tagValues, std::initializer_list<SchemaValue> fieldValues, unsigned long long timestamp) const {
+    if(!_layout || tagValues.size() != _tagsCount || fieldValues.size() != _fieldsCount || !size) {
+        return 0;
+    }
+    const char *names = (const char *)(_layout + 1 + _tagsCount + _fieldsCount);
+    LineWriter w(buff, size);
+    w.append(names, _layout[0]);
+    uint8_t i = 1;
+    for(const char *value : tagValues) {
+        if(value) {
+            w.append(',');
+            w.append(names + _layout[i-1], _layout[i] - _layout[i-1]);
+            w.appendEscaped(value);
+        }
+        i++;
+    }
+    char separator = ' ';
+    for(const SchemaValue &value : fieldValues) {
+        const char *name = names + _layout[i-1];
+        size_t nameLen = _layout[i] - _layout[i-1];
+        i++;
+        if((value._type == SchemaValue::Type::Double || value._type == SchemaValue::Type::Float) && isnan(value._double)) {
+            continue;
+        }
+        w.append(separator);
+        separator = ',';
+        w.append(name, nameLen);
+        char number[MaxNumberLength + 2];
+        switch(value._type) {
+            case SchemaValue::Type::Integer:
+                w.appendNumber(number, formatInteger(number, value._integer), 'i');
+                break;
+            case SchemaValue::Type::Unsigned:
+                w.appendNumber(number, formatUnsigned(number, value._unsigned), 'i');
+                break;
+            case SchemaValue::Type::Float:
+                if(value._decimalPlaces < 0) {
+                    w.appendNumber(number, formatShortest(number, (float)value._double));
+                    break;
+                }
+                // fall through
+            case SchemaValue::Type::Double:
+                w.appendNumber(number, formatDecimal(number, value._double, value._decimalPlaces));
+                break;
+            case SchemaValue::Type::Bool:
+                w.append(bool2string(value._bool), value._bool ? 4 : 5);
+                break;
+            case SchemaValue::Type::String:
+                w.append('"');
+                for(const char *s = value._string; s && *s; s++) {
+                    if(*s == '\\' || *s == '"') {
+                        w.append('\\');
+                    }
+                    w.append(*s);
+                }
+                w.append('"');
+                break;
+        }
+    }
+    if(separator == ' ') {
+        // all fields were omitted
+        return 0;
+    }
+    if(timestamp) {
+        char number[MaxNumberLength + 1];
+        w.append(' ');
+        w.appendNumber(number, formatUnsigned(number, timestamp));
+    }
+    return w.finish();
+}
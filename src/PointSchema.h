@@ -0,0 +1,131 @@
+/**
+ * 
+ * PointSchema.h: Schema of points with constant measurement, tag and field names
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#ifndef _POINT_SCHEMA_H_
+#define _POINT_SCHEMA_H_
+
+#include <Arduino.h>
+#include <initializer_list>
+
+/**
+ * SchemaValue holds a field value for encoding by PointSchema, without copying or allocation.
+ * Numbers are written as by Point::addField, also with DecimalPlacesShortest, strings are referenced and must be valid while encoding.
+ */
+class SchemaValue {
+  public:
+    enum class Type : uint8_t { Integer, Unsigned, Float, Double, Bool, String };
+    SchemaValue(int value):_type(Type::Integer) { _integer = value; }
+    SchemaValue(long value):_type(Type::Integer) { _integer = value; }
+    SchemaValue(long long value):_type(Type::Integer) { _integer = value; }
+    SchemaValue(unsigned int value):_type(Type::Unsigned) { _unsigned = value; }
+    SchemaValue(unsigned long value):_type(Type::Unsigned) { _unsigned = value; }
+    SchemaValue(unsigned long long value):_type(Type::Unsigned) { _unsigned = value; }
+    SchemaValue(float value, int decimalPlaces = 2):_type(Type::Float),_decimalPlaces(decimalPlaces) { _double = value; }
+    SchemaValue(double value, int decimalPlaces = 2):_type(Type::Double),_decimalPlaces(decimalPlaces) { _double = value; }
+    SchemaValue(bool value):_type(Type::Bool) { _bool = value; }
+    SchemaValue(const char *value):_type(Type::String) { _string = value; }
+    SchemaValue(const String &value):_type(Type::String) { _string = value.c_str(); }
+    Type getType() const { return _type; }
+  protected:
+    friend class PointSchemaBase;
+    Type _type;
+    int8_t _decimalPlaces = 0;
+    union {
+        long long _integer;
+        unsigned long long _unsigned;
+        double _double;
+        bool _bool;
+        const char *_string;
+    };
+};
+
+/**
+ * PointSchemaBase keeps escaped measurement, tag and field names of a schema, laid out back-to-back, and encodes lines of values.
+ * Use PointSchema template.
+ */
+class PointSchemaBase {
+  public:
+    // Encodes line protocol of the tag and field values, in the order of names, into buff of size bytes, including terminating zero.
+    // Null tag value omits the tag, NaN field value omits the field. Timestamp is written as it is, if it is not 0, so it must be in the write precision of the client.
+    // Returns length of the line, or 0 if the line doesn't fit, number of values doesn't match the schema or there is no field
+    size_t encode(char *buff, size_t size, std::initializer_list<const char *> tagValues, std::initializer_list<SchemaValue> fieldValues, unsigned long long timestamp = 0) const;
+    // Returns true if the schema was created successfully
+    bool isValid() const { return _layout != nullptr; }
+    uint8_t getTagsCount() const { return _tagsCount; }
+    uint8_t getFieldsCount() const { return _fieldsCount; }
+  protected:
+    PointSchemaBase(const char *measurement, std::initializer_list<const char *> tagNames, std::initializer_list<const char *> fieldNames, uint8_t tagsCount, uint8_t fieldsCount);
+    ~PointSchemaBase();
+    PointSchemaBase(const PointSchemaBase &) = delete;
+    PointSchemaBase &operator=(const PointSchemaBase &) = delete;
+  private:
+    // End offsets of the parts of the layout, followed by escaped measurement, then escaped tag and field names, each followed by '='.
+    // Allocated at once.
+    uint16_t *_layout = nullptr;
+    uint8_t _tagsCount;
+    uint8_t _fieldsCount;
+};
+
+/**
+ * PointSchema describes points of the same measurement, tag and field names.
+ * Names are escaped once, when the schema is created, so encoding a sample only copies the names and formats the values,
+ * without any heap allocation. Lines are encoded into a fixed-size buffer, typically on stack:
+ * 
+ *   PointSchema<2, 2> envSchema("env", {"site", "dev"}, {"temp", "hum"});
+ *   auto line = envSchema.encode({"office", "esp1"}, {21.5, 45});
+ *   client.writeRecord(line.c_str());
+ * 
+ * Template parameters are number of tags, number of fields and max length of an encoded line.
+ */
+template<uint8_t TagsCount, uint8_t FieldsCount, uint16_t MaxLineLength = 256>
+class PointSchema : public PointSchemaBase {
+  public:
+    // Line encoded by the schema
+    class Line {
+      public:
+        // Returns line, or empty string if encoding failed
+        const char *c_str() const { return _data; }
+        size_t length() const { return _length; }
+      private:
+        friend class PointSchema;
+        char _data[MaxLineLength + 1];
+        size_t _length = 0;
+    };
+    // Creates schema with TagsCount tag names and FieldsCount field names. Check isValid() for allocation failure or wrong count of names.
+    PointSchema(const char *measurement, std::initializer_list<const char *> tagNames, std::initializer_list<const char *> fieldNames):
+        PointSchemaBase(measurement, tagNames, fieldNames, TagsCount, FieldsCount) {}
+    // Encodes values into a line, see PointSchemaBase::encode
+    Line encode(std::initializer_list<const char *> tagValues, std::initializer_list<SchemaValue> fieldValues, unsigned long long timestamp = 0) const {
+        Line line;
+        line._length = PointSchemaBase::encode(line._data, sizeof(line._data), tagValues, fieldValues, timestamp);
+        if(!line._length) {
+            line._data[0] = 0;
+        }
+        return line;
+    }
+};
+
+#endif //_POINT_SCHEMA_H_
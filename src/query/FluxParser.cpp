@@ -26,6 +26,7 @@
 */
 
 #include "FluxParser.h"
+#include "util/MemoryStats.h"
 // Uncomment bellow in case of a problem and rebuild sketch
 //#define INFLUXDB_CLIENT_DEBUG_ENABLE
 #include "util/debug.h"
@@ -88,6 +89,7 @@ void FluxQueryResult::close() {
 void FluxQueryResult::clearValues() {
     std::for_each(_data->_columnValues.begin(), _data->_columnValues.end(), [](FluxValue &value){ value = nullptr; });
     _data->_columnValues.clear();
+    _data->account();
 }
 
 void FluxQueryResult::clearColumns() {
@@ -96,12 +98,29 @@ void FluxQueryResult::clearColumns() {
 
     std::for_each(_data->_columnDatatypes.begin(), _data->_columnDatatypes.end(), [](String &value){ value = (const char *)nullptr; });
     _data->_columnDatatypes.clear();
+    _data->account();
 }
 
-FluxQueryResult::Data::Data(CsvReader *reader):_reader(reader) {}
+FluxQueryResult::Data::Data(CsvReader *reader):_reader(reader) {
+    _accounted = sizeof(Data);
+    MemoryAccounting::allocated(MemorySubsystem::Query, _accounted);
+}
 
 FluxQueryResult::Data::~Data() { 
     delete _reader;
+    MemoryAccounting::released(MemorySubsystem::Query, _accounted);
+}
+
+void FluxQueryResult::Data::account() {
+    uint32_t bytes = sizeof(Data) + _columnValues.size()*sizeof(FluxValue);
+    for(const String &s : _columnNames) {
+        bytes += sizeof(String) + s.length();
+    }
+    for(const String &s : _columnDatatypes) {
+        bytes += sizeof(String) + s.length();
+    }
+    MemoryAccounting::resized(MemorySubsystem::Query, _accounted, bytes);
+    _accounted = bytes;
 }
 
 enum ParsingState {
@@ -159,6 +178,7 @@ readRow:
                     for(unsigned int i=1;i < vals.size(); i++) {
                         _data->_columnNames.push_back(vals[i]);
                     }
+                    _data->account();
                 }
 				parsingState = ParsingStateNormal;
 			}
@@ -187,6 +207,7 @@ readRow:
             FluxValue val(v);
             _data->_columnValues.push_back(val);
 		}
+        _data->account();
     } else if(vals[0] == "#datatype") {
 		_data->_tablePosition++;
         clearColumns();
@@ -194,6 +215,7 @@ readRow:
 		for(unsigned int i=1;i < vals.size(); i++) {
 			_data->_columnDatatypes.push_back(vals[i]);
 		}
+        _data->account();
 		parsingState = ParsingStateNameRow;
 		goto readRow;
 	} else {
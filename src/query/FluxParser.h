@@ -102,6 +102,10 @@ private:
         std::vector<String> _columnNames;
         std::vector<FluxValue> _columnValues;
         String _error;
+        // Bytes reported to memory accounting, without values
+        uint32_t _accounted;
+        // Updates accounted memory after columns or values were changed
+        void account();
     };
     std::shared_ptr<Data> _data;
 };
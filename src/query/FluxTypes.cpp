@@ -27,6 +27,7 @@
 
 #include "FluxTypes.h"
 #include "util/helpers.h"
+#include "util/MemoryStats.h"
 
 const char	*FluxDatatypeString     = "string";
 const char	*FluxDatatypeDouble     = "double";
@@ -39,9 +40,12 @@ const char	*FluxDatatypeDatetimeRFC3339      = "dateTime:RFC3339";
 const char	*FluxDatatypeDatetimeRFC3339Nano  = "dateTime:RFC3339Nano";
 
 FluxBase::FluxBase(const String &rawValue):_rawValue(rawValue) {
+    _accounted = sizeof(FluxBase) + _rawValue.length();
+    MemoryAccounting::allocated(MemorySubsystem::Query, _accounted);
 }
 
 FluxBase::~FluxBase() {
+    MemoryAccounting::released(MemorySubsystem::Query, _accounted);
 }
 
 
@@ -145,7 +149,9 @@ FluxString::FluxString(const String &rawValue, const char *type):FluxString(rawV
 
 FluxString::FluxString(const String &rawValue, const String &value, const char *type):FluxBase(rawValue),_type(type),value(value)
 {
-
+    uint32_t bytes = _accounted + sizeof(FluxString) - sizeof(FluxBase) + value.length();
+    MemoryAccounting::resized(MemorySubsystem::Query, _accounted, bytes);
+    _accounted = bytes;
 }
 
 const char *FluxString::getType() {
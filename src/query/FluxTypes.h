@@ -54,6 +54,8 @@ extern const char	*FluxDatatypeDatetimeRFC3339Nano;
 class FluxBase {
 protected:
     String _rawValue;
+    // Bytes reported to memory accounting
+    uint32_t _accounted;
 public:
     FluxBase(const String &rawValue);
     virtual ~FluxBase();
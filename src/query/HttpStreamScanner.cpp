@@ -1,6 +1,6 @@
 /**
  * 
- * HttpStreamScanner.cpp: Scannes HttpClient stream for lines. Supports chunking.
+ * HttpStreamScanner.cpp: Scannes HttpClient stream for lines. Supports chunking and gzip compression.
  * 
  * MIT License
  * 
@@ -30,18 +30,31 @@
 //#define INFLUXDB_CLIENT_DEBUG_ENABLE
 #include "util/debug.h"
 #include "util/helpers.h"
+#include "util/GzipStream.h"
 
-HttpStreamScanner::HttpStreamScanner(HTTPClient *client, bool chunked)
+HttpStreamScanner::HttpStreamScanner(HTTPClient *client, bool chunked, bool gzip)
 {
     _client = client;
     _stream = client->getStreamPtr();
     _chunked = chunked;
     _chunkHeader = chunked;
     _len = client->getSize();
-    INFLUXDB_CLIENT_DEBUG("[D] HttpStreamScanner: chunked: %s, size: %d\n", bool2string(_chunked), _len);
+    if(gzip) {
+        _body = new HttpBodyStream(client, chunked);
+        _gunzip = new GunzipStream(_body);
+    }
+    INFLUXDB_CLIENT_DEBUG("[D] HttpStreamScanner: chunked: %s, gzip: %s, size: %d\n", bool2string(_chunked), bool2string(gzip), _len);
+}
+
+HttpStreamScanner::~HttpStreamScanner() {
+    delete _gunzip;
+    delete _body;
 }
 
 bool HttpStreamScanner::next() {
+    if(_gunzip) {
+        return nextInflated();
+    }
     while(_client->connected() && (_len > 0 || _len == -1)) {
         _line = _stream->readStringUntil('\n');
         INFLUXDB_CLIENT_DEBUG("[D] HttpStreamScanner: line: %s\n", _line.c_str());
@@ -102,3 +115,124 @@ void HttpStreamScanner::close() {
     _client->end();
 }
 
+bool HttpStreamScanner::nextInflated() {
+    _line = "";
+    char buff[65];
+    uint8_t n = 0;
+    int c;
+    while((c = _gunzip->read()) >= 0 && c != '\n') {
+        buff[n++] = c;
+        if(n == sizeof(buff) - 1) {
+            buff[n] = 0;
+            _line += buff;
+            n = 0;
+        }
+    }
+    buff[n] = 0;
+    _line += buff;
+    if(c < 0) {
+        if(_gunzip->getError() != GunzipError::None) {
+            // prefer reason from reading the body
+            _error = _body->getError() ? _body->getError() : HTTPC_ERROR_ENCODING;
+            return false;
+        }
+        if(_line.length() == 0) {
+            // end of data
+            _error = 0;
+            return false;
+        }
+    }
+    INFLUXDB_CLIENT_DEBUG("[D] HttpStreamScanner: line: %s\n", _line.c_str());
+    ++_linesNum;
+    _line.trim(); //remove \r
+    return true;
+}
+
+HttpBodyStream::HttpBodyStream(HTTPClient *client, bool chunked) {
+    _client = client;
+    _stream = client->getStreamPtr();
+    _chunked = chunked;
+    _len = chunked ? -1 : client->getSize();
+}
+
+bool HttpBodyStream::readChunkHeader() {
+    // skip new line after the previous chunk
+    String line;
+    do {
+        line = _stream->readStringUntil('\n');
+        if(line.length() == 0) {
+            _error = _client->connected() ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+            return false;
+        }
+        line.trim();
+    } while(line.length() == 0);
+    _chunkLen = (int) strtol(line.c_str(), NULL, 16);
+    INFLUXDB_CLIENT_DEBUG("[D] HttpBodyStream chunk len: %d\n", _chunkLen);
+    // last chunk, trailers are ignored
+    return _chunkLen > 0;
+}
+
+int HttpBodyStream::available() {
+    if(_end) {
+        return 0;
+    }
+    int a = _stream->available();
+    if(_chunked && _chunkLen > 0 && a > _chunkLen) {
+        a = _chunkLen;
+    }
+    if(_len > 0 && a > _len) {
+        a = _len;
+    }
+    return a;
+}
+
+int HttpBodyStream::read() {
+    char c;
+    return readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+}
+
+size_t HttpBodyStream::readBytes(char* buffer, size_t len) {
+    if(_end || _len == 0) {
+        _end = true;
+        return 0;
+    }
+    if(_chunked && _chunkLen == 0 && !readChunkHeader()) {
+        _end = true;
+        return 0;
+    }
+    int n = len;
+    if(_chunked && n > _chunkLen) {
+        n = _chunkLen;
+    }
+    if(_len > 0 && n > _len) {
+        n = _len;
+    }
+    // don't wait for more than is available, unless nothing is
+    int a = _stream->available();
+    if(a <= 0) {
+        if(!_client->connected()) {
+            _end = true;
+            if(_chunked || _len > 0) {
+                _error = HTTPC_ERROR_CONNECTION_LOST;
+            }
+            return 0;
+        }
+        a = 1;
+    }
+    if(n > a) {
+        n = a;
+    }
+    int r = _stream->readBytes(buffer, n);
+    if(r == 0) {
+        _end = true;
+        _error = HTTPC_ERROR_READ_TIMEOUT;
+        return 0;
+    }
+    if(_chunked) {
+        _chunkLen -= r;
+    }
+    if(_len > 0) {
+        _len -= r;
+    }
+    return r;
+}
@@ -1,6 +1,6 @@
 /**
  * 
- * HttpStreamScanner.h:  Scannes HttpClient stream for lines. Supports chunking.
+ * HttpStreamScanner.h:  Scannes HttpClient stream for lines. Supports chunking and gzip compression.
  * 
  * MIT License
  * 
@@ -33,6 +33,37 @@
 # include <HTTPClient.h>
 #endif //ESP8266
 
+class GunzipStream;
+
+/**
+ * HttpBodyStream reads response body from HTTPClient stream, decoding chunked transfer encoding.
+ **/
+class HttpBodyStream : public Stream {
+public:
+    HttpBodyStream(HTTPClient *client, bool chunked);
+    // Returns HTTPC_ERROR_* if reading failed before the end of body
+    int getError() const { return _error; }
+    // Stream overrides
+    virtual int available() override;
+    virtual int read() override;
+    virtual size_t readBytes(char* buffer, size_t len);
+    virtual int peek() override { return -1; }
+    virtual void flush() override {};
+    virtual size_t write(uint8_t) override { return 0; }
+private:
+    HTTPClient *_client;
+    Stream *_stream;
+    bool _chunked;
+    // Remaining length of the body, -1 if unknown
+    int _len;
+    // Remaining length of the current chunk
+    int _chunkLen = 0;
+    bool _end = false;
+    int _error = 0;
+    // Reads the next chunk header
+    bool readChunkHeader();
+};
+
 /** 
  * HttpStreamScanner parses response stream from  HTTPClient for lines.
  * By repeatedly calling next() it searches for new line.
@@ -41,7 +72,9 @@
  */ 
 class HttpStreamScanner {
 public:
-    HttpStreamScanner(HTTPClient *client, bool chunked);
+    // gzip - whether response has Content-Encoding: gzip 
+    HttpStreamScanner(HTTPClient *client, bool chunked, bool gzip = false);
+    ~HttpStreamScanner();
     bool next();
     void close();
     const String &getLine() const { return _line; }
@@ -59,6 +92,11 @@ private:
     int _chunkLen = 0;
     String _lastChunkLine;
     int _error = 0;
+    // Layers for compressed response: body decoded from chunks and then inflated
+    HttpBodyStream *_body = nullptr;
+    GunzipStream *_gunzip = nullptr;
+    // Splits inflated data to lines
+    bool nextInflated();
 };
 
 #endif //#_HTTP_STREAM_SCANNER_
\ No newline at end of file
@@ -0,0 +1,213 @@
+/**
+ * 
+ * Aggregator.cpp: Aggregation of points of a series in time windows
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "Aggregator.h"
+
+Aggregator::Aggregator(const Point &series, uint32_t windowMs, AggregateFunction functions, int decimalPlaces):
+    _point(""),_window(windowMs ? windowMs : 1),_functions(functions),_decimalPlaces(decimalPlaces) {
+    // the point must not share data with the series, which is reused by user
+    _point._data = std::make_shared<Point::Data>(cloneStr(series._data->measurement));
+    _point._data->tags = series._data->tags;
+    _point._data->account();
+}
+
+Aggregator::~Aggregator() {
+    for(int i=0;i<_fieldsCount;i++) {
+        delete [] _fields[i].name;
+    }
+    free(_fields);
+}
+
+bool Aggregator::matches(const Point &point) const {
+    return !strcmp(_point._data->measurement, point._data->measurement) && _point._data->tags == point._data->tags;
+}
+
+void Aggregator::align(uint32_t now) {
+    if(!_started) {
+        _start = now;
+        _started = true;
+    } else if(now - _start >= _window) {
+        _start += (now - _start) / _window * _window;
+    }
+}
+
+Aggregator::Field *Aggregator::getField(const char *name, size_t len) {
+    for(int i=0;i<_fieldsCount;i++) {
+        if(!strncmp(_fields[i].name, name, len) && !_fields[i].name[len]) {
+            return &_fields[i];
+        }
+    }
+    if(_fieldsCount == 255) {
+        return nullptr;
+    }
+    Field *fields = (Field *)realloc(_fields, (_fieldsCount + 1)*sizeof(Field));
+    if(!fields) {
+        return nullptr;
+    }
+    _fields = fields;
+    Field *field = &_fields[_fieldsCount];
+    field->name = new char[len + 1];
+    memcpy(field->name, name, len);
+    field->name[len] = 0;
+    field->count = 0;
+    _fieldsCount++;
+    return field;
+}
+
+bool Aggregator::isLess(Value a, Value b, char type) {
+    switch(type) {
+        case 'i':
+            return a.integer < b.integer;
+        case 'u':
+            return a.unsignedInteger < b.unsignedInteger;
+        default:
+            return a.number < b.number;
+    }
+}
+
+void Aggregator::addValue(Field *field, double number, Value value, char type) {
+    if(field->count == 0) {
+        field->sum = 0;
+    }
+    if(field->count == 0 || field->type != type) {
+        // values of a different type are not comparable
+        field->min = value;
+        field->max = value;
+    } else {
+        if(isLess(value, field->min, type)) {
+            field->min = value;
+        }
+        if(isLess(field->max, value, type)) {
+            field->max = value;
+        }
+    }
+    field->sum += number;
+    field->last = value;
+    field->type = type;
+    field->count++;
+}
+
+void Aggregator::add(const Point &point, uint32_t now, WritePriority priority, int16_t route) {
+    if(!_points) {
+        align(now);
+    }
+    _priority = priority;
+    _route = route;
+    _points++;
+    const char *p = point._data->fields.c_str();
+    const char *name, *value;
+    size_t nameLen, valueLen;
+    while((p = nextField(p, name, nameLen, value, valueLen))) {
+        double number;
+        char type;
+        if(!parseFieldValue(value, valueLen, number, type)) {
+            continue;
+        }
+        Value exact;
+        switch(type) {
+            case 'i':
+                exact.integer = strtoll(value, nullptr, 10);
+                break;
+            case 'u':
+                exact.unsignedInteger = strtoull(value, nullptr, 10);
+                break;
+            default:
+                exact.number = number;
+        }
+        Field *field = getField(name, nameLen);
+        if(field) {
+            addValue(field, number, exact, type);
+        }
+    }
+}
+
+void Aggregator::putValue(const Field &field, const char *suffix, Value value, char type) {
+    String &fields = _point._data->fields;
+    if(fields.length() > 0) {
+        fields += ',';
+    }
+    fields += field.name;
+    fields += suffix;
+    fields += '=';
+    char buff[MaxNumberLength + 2];
+    if(type) {
+        uint8_t len = type == 'u' ? formatUnsigned(buff, value.unsignedInteger) : formatInteger(buff, value.integer);
+        buff[len++] = type;
+        buff[len] = 0;
+    } else {
+        formatDecimal(buff, value.number, _decimalPlaces);
+    }
+    fields += buff;
+    _point._data->account();
+}
+
+Point &Aggregator::close(uint32_t now, WritePrecision precision) {
+    // buffers of the point are reused
+    _point._data->fields = "";
+    if(precision == WritePrecision::NoTime) {
+        _point.setTime((char *)nullptr);
+    } else {
+        // window start is in ms of uptime, it is converted to the clock time
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        unsigned long long start = tv.tv_sec * 1000000ULL + tv.tv_usec - (now - _start) * 1000ULL;
+        tv.tv_sec = start / 1000000;
+        tv.tv_usec = start % 1000000;
+        static const int digits[] = { 0, 0, 3, 6, 9 };
+        _point.setTime(getTimeStamp(&tv, digits[(uint8_t)precision]));
+    }
+    _point._data->tsWritePrecision = precision;
+    uint8_t functions = (uint8_t)_functions;
+    for(int i=0;i<_fieldsCount;i++) {
+        Field &field = _fields[i];
+        if(!field.count) {
+            continue;
+        }
+        if(functions & (uint8_t)AggregateFunction::Mean) {
+            Value mean;
+            mean.number = field.sum / field.count;
+            putValue(field, "_mean", mean, 0);
+        }
+        if(functions & (uint8_t)AggregateFunction::Min) {
+            putValue(field, "_min", field.min, field.type);
+        }
+        if(functions & (uint8_t)AggregateFunction::Max) {
+            putValue(field, "_max", field.max, field.type);
+        }
+        if(functions & (uint8_t)AggregateFunction::Count) {
+            Value count;
+            count.integer = field.count;
+            putValue(field, "_count", count, 'i');
+        }
+        if(functions & (uint8_t)AggregateFunction::Last) {
+            putValue(field, "_last", field.last, field.type);
+        }
+        field.count = 0;
+    }
+    _points = 0;
+    align(now);
+    return _point;
+}
@@ -0,0 +1,106 @@
+/**
+ * 
+ * Aggregator.h: Aggregation of points of a series in time windows
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#ifndef _INFLUXDB_CLIENT_AGGREGATOR_H
+#define _INFLUXDB_CLIENT_AGGREGATOR_H
+
+#include "../Point.h"
+#include "../Options.h"
+#include "Mutex.h"
+
+/**
+ * Aggregator accumulates numeric fields of points of a single series, measurement and tags, in tumbling time windows.
+ * Windows are aligned to the time of the first point. When a window ends, a point of the series with aggregated fields is created,
+ * e.g. temp_mean, temp_max. Fields are kept for next windows, so memory is allocated only when a new field appears.
+ **/
+class Aggregator {
+  public:
+    // Creates aggregation of the series of the point in windows of windowMs
+    Aggregator(const Point &series, uint32_t windowMs, AggregateFunction functions, int decimalPlaces);
+    ~Aggregator();
+    // Returns true if the point belongs to the series
+    bool matches(const Point &point) const;
+    // Accumulates numeric and boolean fields of the point at time now in ms. String fields are ignored.
+    // Route is the bucket route of the point, -1 for routing by measurement
+    void add(const Point &point, uint32_t now, WritePriority priority = WritePriority::Normal, int16_t route = -1);
+    // Returns true if the window has ended at time now and it contains points
+    bool isDue(uint32_t now) const { return _points && now - _start >= _window; }
+    // Fills the point of the series with fields aggregated in the window and starts the window containing time now.
+    // The point is stamped with the time of the window start in the precision, or left without time for WritePrecision::NoTime.
+    // Returns the point, which is valid until next call
+    Point &close(uint32_t now, WritePrecision precision = WritePrecision::NoTime);
+    // Returns number of points in the window
+    uint32_t getPoints() const { return _points; }
+    // Returns priority of the last added point
+    WritePriority getPriority() const { return _priority; }
+    // Returns bucket route of the last added point
+    int16_t getRoute() const { return _route; }
+    // Locks aggregation for adding a point or closing the window, when points are written by more tasks
+    void lock() { _mutex.lock(); }
+    void unlock() { _mutex.unlock(); }
+  private:
+    // Value of a field, integers are kept exactly
+    union Value {
+        double number;
+        long long integer;
+        unsigned long long unsignedInteger;
+    };
+    struct Field {
+        // Escaped name
+        char *name;
+        double sum;
+        Value min;
+        Value max;
+        Value last;
+        uint32_t count;
+        // Suffix of integer values, or 0
+        char type;
+    };
+    Point _point;
+    uint32_t _window;
+    uint32_t _start = 0;
+    uint32_t _points = 0;
+    bool _started = false;
+    AggregateFunction _functions;
+    int _decimalPlaces;
+    WritePriority _priority = WritePriority::Normal;
+    int16_t _route = -1;
+    Mutex _mutex;
+    Field *_fields = nullptr;
+    uint8_t _fieldsCount = 0;
+    // Returns field of the name of length len, adds it if it is not found. Returns nullptr if memory cannot be allocated
+    Field *getField(const char *name, size_t len);
+    // Accumulates value of field, number is the value converted to double
+    void addValue(Field *field, double number, Value value, char type);
+    // Returns true if value a is less than b
+    static bool isLess(Value a, Value b, char type);
+    // Moves window start to the window containing time now
+    void align(uint32_t now);
+    // Appends aggregated value to fields of the point
+    void putValue(const Field &field, const char *suffix, Value value, char type);
+};
+
+#endif //_INFLUXDB_CLIENT_AGGREGATOR_H
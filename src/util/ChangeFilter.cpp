@@ -0,0 +1,163 @@
+/**
+ * 
+ * ChangeFilter.cpp: Send-on-change filter of points
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "ChangeFilter.h"
+
+// FNV-1a
+static const uint32_t HashBasis = 2166136261u;
+static const uint32_t HashPrime = 16777619u;
+
+static uint32_t hash(uint32_t h, const char *data, size_t len) {
+    for(size_t i=0;i<len;i++) {
+        h = (h ^ (uint8_t)data[i]) * HashPrime;
+    }
+    return h;
+}
+
+// djb2, independent of FNV-1a
+static const uint32_t CheckBasis = 5381u;
+
+static uint32_t checkHash(uint32_t h, const char *data, size_t len) {
+    for(size_t i=0;i<len;i++) {
+        h = (h * 33) ^ (uint8_t)data[i];
+    }
+    return h;
+}
+
+ChangeFilter::ChangeFilter(uint16_t size, double absolute, double relative, uint32_t heartbeatMs):
+    _size(size),_absolute(absolute),_relative(relative),_heartbeat(heartbeatMs) {
+    _entries = _size ? (Entry *)calloc(_size, sizeof(Entry)) : nullptr;
+}
+
+ChangeFilter::~ChangeFilter() {
+    free(_entries);
+}
+
+uint32_t ChangeFilter::fieldKey(uint32_t series, const char *name, size_t len) {
+    uint32_t key = hash(series, name, len);
+    // zero marks free entry
+    return key ? key : 1;
+}
+
+double ChangeFilter::fieldValue(const char *value, size_t len, uint32_t &length) {
+    double number;
+    char type;
+    if(parseFieldValue(value, len, number, type)) {
+        length = NumericLength;
+        return number;
+    }
+    length = len;
+    return hash(HashBasis, value, len);
+}
+
+ChangeFilter::Entry *ChangeFilter::find(uint32_t key, uint32_t check) const {
+    uint16_t index = key % _size;
+    for(int i=0;i<MaxProbes && i<_size;i++) {
+        Entry *entry = &_entries[index];
+        if(entry->key == key && entry->check == check) {
+            return entry;
+        }
+        if(!entry->key) {
+            return nullptr;
+        }
+        if(++index == _size) {
+            index = 0;
+        }
+    }
+    return nullptr;
+}
+
+ChangeFilter::Entry *ChangeFilter::slot(uint32_t key, uint32_t check, uint32_t now) {
+    uint16_t index = key % _size;
+    Entry *oldest = nullptr;
+    for(int i=0;i<MaxProbes && i<_size;i++) {
+        Entry *entry = &_entries[index];
+        if((entry->key == key && entry->check == check) || !entry->key) {
+            return entry;
+        }
+        if(!oldest || now - entry->time > now - oldest->time) {
+            oldest = entry;
+        }
+        if(++index == _size) {
+            index = 0;
+        }
+    }
+    return oldest;
+}
+
+bool ChangeFilter::check(const Point &point, uint32_t now) {
+    size_t measurementLen = strlen(point._data->measurement);
+    uint32_t series = hash(HashBasis, point._data->measurement, measurementLen);
+    series = hash(series, ",", 1);
+    series = hash(series, point._data->tags.c_str(), point._data->tags.length());
+    uint32_t seriesCheck = checkHash(CheckBasis, point._data->measurement, measurementLen);
+    seriesCheck = checkHash(seriesCheck, ",", 1);
+    seriesCheck = checkHash(seriesCheck, point._data->tags.c_str(), point._data->tags.length());
+    const char *fields = point._data->fields.c_str();
+    const char *p = fields;
+    const char *name, *value;
+    size_t nameLen, valueLen;
+    bool changed = false;
+    _mutex.lock();
+    while(!changed && (p = nextField(p, name, nameLen, value, valueLen))) {
+        Entry *entry = find(fieldKey(series, name, nameLen), checkHash(seriesCheck, name, nameLen));
+        if(!entry || (_heartbeat && now - entry->time >= _heartbeat)) {
+            changed = true;
+            continue;
+        }
+        uint32_t length;
+        double v = fieldValue(value, valueLen, length);
+        if(length != entry->length) {
+            changed = true;
+        } else if(length == NumericLength) {
+            double band = _relative*fabs(entry->value);
+            if(band < _absolute) {
+                band = _absolute;
+            }
+            changed = fabs(v - entry->value) > band;
+        } else {
+            changed = v != entry->value;
+        }
+    }
+    if(!changed) {
+        _suppressed++;
+        _mutex.unlock();
+        return false;
+    }
+    // values of written point are the reference for next ones
+    p = fields;
+    while((p = nextField(p, name, nameLen, value, valueLen))) {
+        uint32_t key = fieldKey(series, name, nameLen);
+        uint32_t fieldCheck = checkHash(seriesCheck, name, nameLen);
+        Entry *entry = slot(key, fieldCheck, now);
+        entry->key = key;
+        entry->check = fieldCheck;
+        entry->time = now;
+        entry->value = fieldValue(value, valueLen, entry->length);
+    }
+    _mutex.unlock();
+    return true;
+}
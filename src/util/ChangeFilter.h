@@ -0,0 +1,89 @@
+/**
+ * 
+ * ChangeFilter.h: Send-on-change filter of points
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#ifndef _INFLUXDB_CLIENT_CHANGE_FILTER_H
+#define _INFLUXDB_CLIENT_CHANGE_FILTER_H
+
+#include "../Point.h"
+#include "Mutex.h"
+
+/**
+ * ChangeFilter suppresses points, whose field values haven't changed beyond a deadband since the last written point of the series.
+ * The last written value and time of each field of a series, measurement and tags, are kept in a hash table of fixed size, allocated at once.
+ * Fields are identified by two independent 32-bit hashes of the series and the field name, string values by their length and a 32-bit hash.
+ * Keys are not stored, so a field of another series is taken for a known one if both hashes collide, about 1 in 2^64 per lookup,
+ * and a changed string value is suppressed if it has the same length and hash, about 1 in 2^32 per check.
+ * When the table is full, the oldest entry of the probed ones is replaced, so a forgotten field is just written again.
+ **/
+class ChangeFilter {
+  public:
+    // Creates filter with table of size entries. Numeric field has changed if it differs from the last written value more than
+    // absolute, or relative part of the last value, whichever is greater. Other fields have changed if they differ.
+    // Point is written also when heartbeatMs elapsed since its field was written, zero disables it.
+    ChangeFilter(uint16_t size, double absolute, double relative, uint32_t heartbeatMs);
+    ~ChangeFilter();
+    bool isValid() const { return _entries != nullptr; }
+    // Returns true if the point should be written at time now, because a field changed, is new or the heartbeat is due.
+    // Then values of all fields of the point are remembered. It can be called by more tasks at once.
+    bool check(const Point &point, uint32_t now);
+    // Returns number of points suppressed
+    uint32_t getSuppressed() const { return _suppressed; }
+  private:
+    struct Entry {
+        // Hash of series and field name, 0 for free entry
+        uint32_t key;
+        // Second hash of series and field name
+        uint32_t check;
+        // Time of the last written value
+        uint32_t time;
+        // Length of other than numeric value, NumericLength for numeric value
+        uint32_t length;
+        // Numeric value, or hash of other value
+        double value;
+    };
+    // Length of numeric values
+    static const uint32_t NumericLength = 0xFFFFFFFF;
+    // Max number of entries probed for a key
+    static const uint8_t MaxProbes = 8;
+    Entry *_entries;
+    uint16_t _size;
+    double _absolute;
+    double _relative;
+    uint32_t _heartbeat;
+    uint32_t _suppressed = 0;
+    // Serializes checks of points written by more tasks
+    Mutex _mutex;
+    // Returns entry of the key and check, or nullptr if it is not in the table
+    Entry *find(uint32_t key, uint32_t check) const;
+    // Returns entry for the key and check, the found one, a free one or the one probed, which was written longest before now
+    Entry *slot(uint32_t key, uint32_t check, uint32_t now);
+    // Returns key of the field of the series hash
+    static uint32_t fieldKey(uint32_t series, const char *name, size_t len);
+    // Returns value of the field to compare and its length, NumericLength if it is numeric
+    static double fieldValue(const char *value, size_t len, uint32_t &length);
+};
+
+#endif //_INFLUXDB_CLIENT_CHANGE_FILTER_H
@@ -0,0 +1,799 @@
+/**
+ * 
+ * GzipStream.cpp: Streams compressing and decompressing data in gzip format
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "GzipStream.h"
+
+// Uncomment bellow in case of a problem and rebuild sketch
+//#define INFLUXDB_CLIENT_DEBUG_ENABLE
+#include "debug.h"
+
+#define GZIP_HASH_BITS 10
+#define GZIP_HASH_SIZE (1 << GZIP_HASH_BITS)
+#define GZIP_MIN_MATCH 3
+#define GZIP_MAX_MATCH 258
+
+// Gzip header: magic, deflate method, no flags, no mtime, no extra flags, unknown OS
+static const uint8_t GzipHeader[] PROGMEM = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+// Base lengths for length codes 257..285 
+static const uint16_t LengthBase[] PROGMEM = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t LengthExtra[] PROGMEM = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+// Base distances for distance codes 0..29
+static const uint16_t DistanceBase[] PROGMEM = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t DistanceExtra[] PROGMEM = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// CRC32 for half a byte
+static const uint32_t CrcTable[] PROGMEM = { 
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c, 
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c 
+};
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t *data, size_t len) {
+    crc = ~crc;
+    for(size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = pgm_read_dword(CrcTable + (crc & 0x0f)) ^ (crc >> 4);
+        crc = pgm_read_dword(CrcTable + (crc & 0x0f)) ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+GzipStream::GzipStream(Stream *source, uint16_t windowSize):_source(source) {
+    if(windowSize < 512) {
+        windowSize = 512;
+    } else if(windowSize > 16384) {
+        windowSize = 16384;
+    }
+    _windowSize = windowSize;
+    _window = new uint8_t[2*windowSize];
+    _head = new uint16_t[GZIP_HASH_SIZE];
+    reset();
+}
+
+GzipStream::~GzipStream() {
+    delete [] _window;
+    delete [] _head;
+    free(_data);
+}
+
+void GzipStream::reset() {
+    _read = 0;
+    if(_data) {
+        return;
+    }
+    if(_head) {
+        memset(_head, 0, GZIP_HASH_SIZE*sizeof(uint16_t));
+    }
+    _pos = 0;
+    _end = 0;
+    _sourceEnd = false;
+    _state = State::Header;
+    _bitBuffer = 0;
+    _bitCount = 0;
+    _outPos = 0;
+    _outLen = 0;
+    _crc = 0;
+    _inputSize = 0;
+}
+
+uint32_t GzipStream::compress(uint32_t limit) {
+    if(!_window || !_head || _data) {
+        return _size;
+    }
+    uint8_t *data = nullptr;
+    uint32_t size = 0, capacity = 0;
+    while(produce()) {
+        if(size + _outLen > capacity) {
+            // start with a quarter of the limit, line protocol is compressed several times
+            uint32_t newCapacity = capacity ? 2*capacity : limit/4;
+            if(newCapacity < size + _outLen) {
+                newCapacity = size + _outLen;
+            }
+            if(newCapacity > limit) {
+                newCapacity = limit;
+            }
+            uint8_t *newData = size + _outLen <= newCapacity ? (uint8_t *)realloc(data, newCapacity) : nullptr;
+            if(!newData) {
+                INFLUXDB_CLIENT_DEBUG("[W] Gzip: cannot keep %u compressed bytes, limit %u\n", size + _outLen, limit);
+                free(data);
+                reset();
+                return 0;
+            }
+            data = newData;
+            capacity = newCapacity;
+        }
+        memcpy(data + size, _out, _outLen);
+        size += _outLen;
+    }
+    INFLUXDB_CLIENT_DEBUG("[D] Gzip: %u -> %u bytes\n", _inputSize, size);
+    _data = data;
+    _size = size;
+    _read = 0;
+    // window is not needed anymore
+    delete [] _window;
+    _window = nullptr;
+    delete [] _head;
+    _head = nullptr;
+    return _size;
+}
+
+int GzipStream::available() {
+    if(_data) {
+        return _size - _read;
+    }
+    return _outPos < _outLen || _state != State::Done ? 1 : 0;
+}
+
+int GzipStream::read(uint8_t* buffer, size_t len) {
+    return readBytes((char *)buffer, len);
+}
+
+size_t GzipStream::readBytes(char* buffer, size_t len) {
+    if(_data) {
+        size_t n = _size - _read;
+        if(n > len) {
+            n = len;
+        }
+        memcpy(buffer, _data + _read, n);
+        _read += n;
+        return n;
+    }
+    size_t r = 0;
+    while(r < len) {
+        if(_outPos == _outLen && !produce()) {
+            break;
+        }
+        size_t n = _outLen - _outPos;
+        if(n > len - r) {
+            n = len - r;
+        }
+        memcpy(buffer + r, _out + _outPos, n);
+        _outPos += n;
+        r += n;
+    }
+    _read += r;
+    return r;
+}
+
+int GzipStream::read() {
+    int c = peek();
+    if(c >= 0) {
+        if(!_data) {
+            _outPos++;
+        }
+        _read++;
+    }
+    return c;
+}
+
+int GzipStream::peek() {
+    if(_data) {
+        return _read < _size ? _data[_read] : -1;
+    }
+    if(_outPos == _outLen && !produce()) {
+        return -1;
+    }
+    return _out[_outPos];
+}
+
+void GzipStream::fill() {
+    if(_end == 2*_windowSize) {
+        // slide window, only the last windowSize bytes are kept as history
+        memmove(_window, _window + _windowSize, _windowSize);
+        _pos -= _windowSize;
+        _end -= _windowSize;
+        for(int i = 0; i < GZIP_HASH_SIZE; i++) {
+            _head[i] = _head[i] > _windowSize ? _head[i] - _windowSize : 0;
+        }
+    }
+    size_t n = 0;
+    if(_source->available() > 0) {
+        n = _source->readBytes((char *)_window + _end, 2*_windowSize - _end);
+    }
+    if(n == 0) {
+        _sourceEnd = true;
+        return;
+    }
+    _crc = updateCrc(_crc, _window + _end, n);
+    _inputSize += n;
+    _end += n;
+}
+
+bool GzipStream::produce() {
+    _outPos = 0;
+    _outLen = 0;
+    if(!_window || !_head) {
+        return false;
+    }
+    switch(_state) {
+        case State::Header:
+            memcpy_P(_out, GzipHeader, sizeof(GzipHeader));
+            _outLen = sizeof(GzipHeader);
+            // the only block, BFINAL=1, BTYPE=01 (fixed Huffman codes)
+            putBits(1, 1);
+            putBits(1, 2);
+            _state = State::Data;
+            return true;
+        case State::Done:
+            return false;
+        default:
+            break;
+    }
+    // leave space for the longest match code and trailer
+    while(_outLen < sizeof(_out) - 16) {
+        if(!_sourceEnd && _end - _pos < GZIP_MAX_MATCH) {
+            fill();
+            continue;
+        }
+        uint16_t lookahead = _end - _pos;
+        if(lookahead == 0) {
+            // end of block code, then trailer: CRC32 and input size
+            putCode(0, 7);
+            if(_bitCount) {
+                putBits(0, 8 - _bitCount);
+            }
+            for(int i = 0; i < 32; i += 8) {
+                putByte(_crc >> i);
+            }
+            for(int i = 0; i < 32; i += 8) {
+                putByte(_inputSize >> i);
+            }
+            _state = State::Done;
+            break;
+        }
+        uint16_t length = 0;
+        uint16_t distance = 0;
+        if(lookahead >= GZIP_MIN_MATCH) {
+            uint16_t h = hash(_pos);
+            uint16_t candidate = _head[h];
+            _head[h] = _pos + 1;
+            // window holds also the lookahead, so older data must be skipped 
+            if(candidate && _pos - (candidate - 1) <= _windowSize) {
+                candidate--;
+                uint16_t max = lookahead < GZIP_MAX_MATCH ? lookahead : GZIP_MAX_MATCH;
+                const uint8_t *a = _window + candidate;
+                const uint8_t *b = _window + _pos;
+                while(length < max && a[length] == b[length]) {
+                    length++;
+                }
+                distance = _pos - candidate;
+            }
+        }
+        if(length >= GZIP_MIN_MATCH) {
+            putMatch(length, distance);
+            // index skipped positions to find matches in them later
+            for(uint16_t i = 1; i < length && _pos + i + GZIP_MIN_MATCH <= _end; i++) {
+                _head[hash(_pos + i)] = _pos + i + 1;
+            }
+            _pos += length;
+        } else {
+            putLiteral(_window[_pos++]);
+        }
+    }
+    return true;
+}
+
+uint16_t GzipStream::hash(uint16_t pos) const {
+    const uint8_t *p = _window + pos;
+    return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & (GZIP_HASH_SIZE - 1);
+}
+
+void GzipStream::putBits(uint32_t value, uint8_t bits) {
+    _bitBuffer |= value << _bitCount;
+    _bitCount += bits;
+    while(_bitCount >= 8) {
+        putByte(_bitBuffer);
+        _bitBuffer >>= 8;
+        _bitCount -= 8;
+    }
+}
+
+void GzipStream::putCode(uint16_t code, uint8_t bits) {
+    uint16_t reversed = 0;
+    for(uint8_t i = 0; i < bits; i++) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    putBits(reversed, bits);
+}
+
+void GzipStream::putLiteral(uint8_t c) {
+    if(c < 144) {
+        putCode(0x30 + c, 8);
+    } else {
+        putCode(0x190 + c - 144, 9);
+    }
+}
+
+void GzipStream::putMatch(uint16_t length, uint16_t distance) {
+    uint8_t code = 28;
+    while(pgm_read_word(LengthBase + code) > length) {
+        code--;
+    }
+    uint16_t symbol = 257 + code;
+    if(symbol < 280) {
+        putCode(symbol - 256, 7);
+    } else {
+        putCode(0xc0 + symbol - 280, 8);
+    }
+    putBits(length - pgm_read_word(LengthBase + code), pgm_read_byte(LengthExtra + code));
+    code = 29;
+    while(pgm_read_word(DistanceBase + code) > distance) {
+        code--;
+    }
+    putCode(code, 5);
+    putBits(distance - pgm_read_word(DistanceBase + code), pgm_read_byte(DistanceExtra + code));
+}
+
+// Order of code length codes in dynamic block header
+static const uint8_t CodeLengthOrder[] PROGMEM = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+GunzipStream::GunzipStream(Stream *source, uint16_t windowSize):_source(source) {
+    if(windowSize < 512) {
+        windowSize = 512;
+    }
+    _windowSize = windowSize;
+    _window = new uint8_t[windowSize];
+    if(!_window) {
+        setError(GunzipError::NotEnoughMemory);
+    }
+    _lengthCode.symbol = _lengthSymbols;
+    _distanceCode.symbol = _distanceSymbols;
+}
+
+GunzipStream::~GunzipStream() {
+    delete [] _window;
+}
+
+bool GunzipStream::setError(GunzipError error) {
+    INFLUXDB_CLIENT_DEBUG("[E] Gunzip error %d, at %u bytes\n", (int)error, _outputSize);
+    _error = error;
+    _state = State::Error;
+    _unread = 0;
+    return false;
+}
+
+int GunzipStream::available() {
+    if(_unread) {
+        return _unread;
+    }
+    return _state == State::Done || _state == State::Error ? 0 : 1;
+}
+
+int GunzipStream::read(uint8_t* buffer, size_t len) {
+    return readBytes((char *)buffer, len);
+}
+
+size_t GunzipStream::readBytes(char* buffer, size_t len) {
+    size_t r = 0;
+    while(r < len) {
+        if(!_unread && !produce()) {
+            break;
+        }
+        // unread data can wrap around the end of the window
+        uint16_t start = (_writePos + _windowSize - _unread) % _windowSize;
+        size_t n = _unread;
+        if(n > (size_t)(_windowSize - start)) {
+            n = _windowSize - start;
+        }
+        if(n > len - r) {
+            n = len - r;
+        }
+        memcpy(buffer + r, _window + start, n);
+        _unread -= n;
+        r += n;
+    }
+    return r;
+}
+
+int GunzipStream::read() {
+    int c = peek();
+    if(c >= 0) {
+        _unread--;
+    }
+    return c;
+}
+
+int GunzipStream::peek() {
+    if(!_unread && !produce()) {
+        return -1;
+    }
+    return _window[(_writePos + _windowSize - _unread) % _windowSize];
+}
+
+int GunzipStream::nextByte() {
+    if(_inPos == _inLen) {
+        // read what is available, but wait at least for one byte
+        int n = _source->available();
+        if(n <= 0) {
+            n = 1;
+        } else if(n > (int)sizeof(_in)) {
+            n = sizeof(_in);
+        }
+        _inLen = _source->readBytes((char *)_in, n);
+        _inPos = 0;
+        if(!_inLen) {
+            return -1;
+        }
+    }
+    return _in[_inPos++];
+}
+
+int32_t GunzipStream::getBits(uint8_t bits) {
+    while(_bitCount < bits) {
+        int b = nextByte();
+        if(b < 0) {
+            return -1;
+        }
+        _bitBuffer |= (uint32_t)b << _bitCount;
+        _bitCount += 8;
+    }
+    int32_t value = _bitBuffer & ((1UL << bits) - 1);
+    _bitBuffer >>= bits;
+    _bitCount -= bits;
+    return value;
+}
+
+void GunzipStream::putByte(uint8_t b) {
+    _window[_writePos] = b;
+    if(++_writePos == _windowSize) {
+        _writePos = 0;
+    }
+    _unread++;
+    _outputSize++;
+}
+
+bool GunzipStream::buildHuffman(Huffman &h, const uint8_t *lengths, uint16_t n) {
+    memset(h.count, 0, sizeof(h.count));
+    for(uint16_t i = 0; i < n; i++) {
+        h.count[lengths[i]]++;
+    }
+    if(h.count[0] == n) {
+        // no codes, valid e.g. for distances when there are only literals
+        return true;
+    }
+    // check that the code is not over-subscribed
+    int left = 1;
+    for(int len = 1; len < 16; len++) {
+        left <<= 1;
+        left -= h.count[len];
+        if(left < 0) {
+            return false;
+        }
+    }
+    uint16_t offsets[16];
+    offsets[1] = 0;
+    for(int len = 1; len < 15; len++) {
+        offsets[len + 1] = offsets[len] + h.count[len];
+    }
+    for(uint16_t i = 0; i < n; i++) {
+        if(lengths[i]) {
+            h.symbol[offsets[lengths[i]]++] = i;
+        }
+    }
+    return true;
+}
+
+int GunzipStream::decodeSymbol(const Huffman &h) {
+    // codes are stored from the most significant bit, so they are read bit by bit 
+    int code = 0, first = 0, index = 0;
+    for(int len = 1; len < 16; len++) {
+        int32_t bit = getBits(1);
+        if(bit < 0) {
+            return -1;
+        }
+        code |= bit;
+        int count = h.count[len];
+        if(code - count < first) {
+            return h.symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -2;
+}
+
+bool GunzipStream::readHeader() {
+    uint8_t header[10];
+    for(uint8_t i = 0; i < sizeof(header); i++) {
+        int b = nextByte();
+        if(b < 0) {
+            return setError(GunzipError::UnexpectedEnd);
+        }
+        header[i] = b;
+    }
+    uint8_t flags = header[3];
+    if(header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || (flags & 0xe0)) {
+        return setError(GunzipError::InvalidData);
+    }
+    uint32_t skip = 0;
+    if(flags & 0x04) { // FEXTRA
+        int lo = nextByte();
+        int hi = nextByte();
+        if(hi < 0) {
+            return setError(GunzipError::UnexpectedEnd);
+        }
+        skip = lo | (hi << 8);
+    }
+    if(flags & 0x02) { // FHCRC
+        skip += 2;
+    }
+    for(uint32_t i = 0; i < skip; i++) {
+        if(nextByte() < 0) {
+            return setError(GunzipError::UnexpectedEnd);
+        }
+    }
+    // FNAME and FCOMMENT are zero terminated
+    for(uint8_t f = 0x08; f <= 0x10; f <<= 1) {
+        if(flags & f) {
+            int b;
+            while((b = nextByte()) > 0);
+            if(b < 0) {
+                return setError(GunzipError::UnexpectedEnd);
+            }
+        }
+    }
+    _state = State::BlockHeader;
+    return true;
+}
+
+bool GunzipStream::readDynamicCodes() {
+    int32_t nlen = getBits(5);
+    int32_t ndist = getBits(5);
+    int32_t ncode = getBits(4);
+    if(ncode < 0) {
+        return setError(GunzipError::UnexpectedEnd);
+    }
+    nlen += 257;
+    ndist += 1;
+    ncode += 4;
+    if(nlen > 286 || ndist > 30) {
+        return setError(GunzipError::InvalidData);
+    }
+    uint8_t lengths[286 + 30];
+    memset(lengths, 0, 19);
+    for(int i = 0; i < ncode; i++) {
+        int32_t len = getBits(3);
+        if(len < 0) {
+            return setError(GunzipError::UnexpectedEnd);
+        }
+        lengths[pgm_read_byte(CodeLengthOrder + i)] = len;
+    }
+    // code length codes are temporarily decoded using the length code
+    if(!buildHuffman(_lengthCode, lengths, 19)) {
+        return setError(GunzipError::InvalidData);
+    }
+    int index = 0;
+    while(index < nlen + ndist) {
+        int symbol = decodeSymbol(_lengthCode);
+        if(symbol == -1) {
+            return setError(GunzipError::UnexpectedEnd);
+        }
+        if(symbol < 0) {
+            return setError(GunzipError::InvalidData);
+        }
+        if(symbol < 16) {
+            lengths[index++] = symbol;
+            continue;
+        }
+        uint8_t len = 0;
+        int32_t repeat;
+        if(symbol == 16) {
+            if(index == 0) {
+                return setError(GunzipError::InvalidData);
+            }
+            len = lengths[index - 1];
+            repeat = getBits(2) + 3;
+        } else if(symbol == 17) {
+            repeat = getBits(3) + 3;
+        } else {
+            repeat = getBits(7) + 11;
+        }
+        if(repeat < 3) {
+            return setError(GunzipError::UnexpectedEnd);
+        }
+        if(index + repeat > nlen + ndist) {
+            return setError(GunzipError::InvalidData);
+        }
+        while(repeat--) {
+            lengths[index++] = len;
+        }
+    }
+    // end of block code must be present
+    if(lengths[256] == 0) {
+        return setError(GunzipError::InvalidData);
+    }
+    if(!buildHuffman(_lengthCode, lengths, nlen) || !buildHuffman(_distanceCode, lengths + nlen, ndist)) {
+        return setError(GunzipError::InvalidData);
+    }
+    return true;
+}
+
+bool GunzipStream::readBlockHeader() {
+    int32_t header = getBits(3);
+    if(header < 0) {
+        return setError(GunzipError::UnexpectedEnd);
+    }
+    _lastBlock = header & 1;
+    switch(header >> 1) {
+        case 0: { 
+            // stored block starts at byte boundary
+            _bitBuffer = 0;
+            _bitCount = 0;
+            int32_t len = getBits(16);
+            int32_t nlen = getBits(16);
+            if(nlen < 0) {
+                return setError(GunzipError::UnexpectedEnd);
+            }
+            if((len ^ 0xffff) != nlen) {
+                return setError(GunzipError::InvalidData);
+            }
+            _storedLen = len;
+            _state = State::Stored;
+            return true;
+        }
+        case 1: {
+            uint8_t lengths[288];
+            memset(lengths, 8, 144);
+            memset(lengths + 144, 9, 112);
+            memset(lengths + 256, 7, 24);
+            memset(lengths + 280, 8, 8);
+            buildHuffman(_lengthCode, lengths, 288);
+            memset(lengths, 5, 30);
+            buildHuffman(_distanceCode, lengths, 30);
+            break;
+        }
+        case 2:
+            if(!readDynamicCodes()) {
+                return false;
+            }
+            break;
+        default:
+            return setError(GunzipError::InvalidData);
+    }
+    _state = State::Codes;
+    return true;
+}
+
+bool GunzipStream::readTrailer() {
+    // trailer starts at byte boundary
+    _bitBuffer = 0;
+    _bitCount = 0;
+    uint32_t crc = 0, size = 0;
+    for(int i = 0; i < 32; i += 8) {
+        int b = nextByte();
+        if(b < 0) {
+            return setError(GunzipError::UnexpectedEnd);
+        }
+        crc |= (uint32_t)b << i;
+    }
+    for(int i = 0; i < 32; i += 8) {
+        int b = nextByte();
+        if(b < 0) {
+            return setError(GunzipError::UnexpectedEnd);
+        }
+        size |= (uint32_t)b << i;
+    }
+    if(crc != _crc || size != _outputSize) {
+        return setError(GunzipError::InvalidData);
+    }
+    _state = State::Done;
+    return true;
+}
+
+bool GunzipStream::produce() {
+    uint16_t start = _writePos;
+    // decode until there is something to read, at most one match at once, so unread data are never overwritten
+    while(!_unread) {
+        switch(_state) {
+            case State::Header:
+                if(!readHeader()) {
+                    return false;
+                }
+                break;
+            case State::BlockHeader:
+                if(!readBlockHeader()) {
+                    return false;
+                }
+                break;
+            case State::Stored: {
+                if(!_storedLen) {
+                    _state = _lastBlock ? State::Trailer : State::BlockHeader;
+                    break;
+                }
+                uint16_t n = _storedLen < 256 ? _storedLen : 256;
+                for(uint16_t i = 0; i < n; i++) {
+                    int b = nextByte();
+                    if(b < 0) {
+                        return setError(GunzipError::UnexpectedEnd);
+                    }
+                    putByte(b);
+                }
+                _storedLen -= n;
+                break;
+            }
+            case State::Codes: {
+                int symbol = decodeSymbol(_lengthCode);
+                if(symbol < 0) {
+                    return setError(symbol == -1 ? GunzipError::UnexpectedEnd : GunzipError::InvalidData);
+                }
+                if(symbol < 256) {
+                    putByte(symbol);
+                } else if(symbol == 256) {
+                    _state = _lastBlock ? State::Trailer : State::BlockHeader;
+                } else {
+                    symbol -= 257;
+                    if(symbol >= 29) {
+                        return setError(GunzipError::InvalidData);
+                    }
+                    int32_t extra = getBits(pgm_read_byte(LengthExtra + symbol));
+                    int dsymbol = decodeSymbol(_distanceCode);
+                    if(extra < 0 || dsymbol == -1) {
+                        return setError(GunzipError::UnexpectedEnd);
+                    }
+                    if(dsymbol < 0 || dsymbol >= 30) {
+                        return setError(GunzipError::InvalidData);
+                    }
+                    uint16_t length = pgm_read_word(LengthBase + symbol) + extra;
+                    int32_t dextra = getBits(pgm_read_byte(DistanceExtra + dsymbol));
+                    if(dextra < 0) {
+                        return setError(GunzipError::UnexpectedEnd);
+                    }
+                    uint32_t distance = pgm_read_word(DistanceBase + dsymbol) + dextra;
+                    if(distance > _outputSize) {
+                        return setError(GunzipError::InvalidData);
+                    }
+                    if(distance > _windowSize) {
+                        return setError(GunzipError::WindowTooSmall);
+                    }
+                    uint16_t from = (_writePos + _windowSize - distance) % _windowSize;
+                    while(length--) {
+                        putByte(_window[from]);
+                        if(++from == _windowSize) {
+                            from = 0;
+                        }
+                    }
+                }
+                break;
+            }
+            case State::Trailer:
+                // all data were already read and counted in CRC
+                readTrailer();
+                return false;
+            case State::Done:
+            case State::Error:
+                return false;
+        }
+    }
+    // update CRC with new data, which can wrap around the end of the window
+    if(_writePos >= start) {
+        _crc = updateCrc(_crc, _window + start, _writePos - start);
+    } else {
+        _crc = updateCrc(_crc, _window + start, _windowSize - start);
+        _crc = updateCrc(_crc, _window, _writePos);
+    }
+    return true;
+}
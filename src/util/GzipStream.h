@@ -0,0 +1,195 @@
+/**
+ * 
+ * GzipStream.h: Streams compressing and decompressing data in gzip format
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#ifndef _INFLUXDB_CLIENT_GZIP_STREAM_H
+#define _INFLUXDB_CLIENT_GZIP_STREAM_H
+
+#include <Arduino.h>
+
+// Size of the window for decompression. Gzip allows back references up to 32KB and servers use the whole window, 
+// so data compressed with a bigger window than this cannot be decompressed.
+// On ESP8266, 32KB doesn't fit into memory along with TLS buffers, so compressed responses are enabled only by defining the window.
+#ifndef INFLUXDB_CLIENT_GUNZIP_WINDOW
+# define INFLUXDB_CLIENT_GUNZIP_WINDOW 32768
+# if defined(ESP8266)
+#  define INFLUXDB_CLIENT_GUNZIP_DISABLED
+# endif
+#endif
+
+/**
+ * GzipStream reads data from the source stream and provides them compressed in the gzip format (RFC 1952).
+ * Data are deflated on the fly using a single block with fixed Huffman codes and LZ77 matching 
+ * in a sliding window of limited size, so memory usage is bounded (2*windowSize + 2KB).
+ * Only the latest position of each hash is kept, without chains, so the ratio is lower than of zlib, 
+ * about 4x on line protocol with changing values and timestamps (see testGzipStream).
+ * As HTTP request requires Content-Length, compress() deflates whole source at once into memory, which is then read.
+ **/
+class GzipStream : public Stream {
+  public:
+    // Creates stream compressing data from source, using window of windowSize bytes (512-16384)
+    GzipStream(Stream *source, uint16_t windowSize = 1024);
+    virtual ~GzipStream();
+    // Compresses whole source into memory, the window is released afterwards. Returns compressed size, 
+    // or 0 if there is not enough memory, or compressed data would be longer than limit bytes.
+    uint32_t compress(uint32_t limit);
+    // Starts reading from the beginning. Compressed data are kept, otherwise the source must be rewound as well.
+    void reset();
+    // Returns number of bytes read from source
+    uint32_t getInputSize() const { return _inputSize; }
+
+    // Stream overrides
+    // Returns remaining number of compressed bytes if data were compressed at once, otherwise 1 until the end of data
+    virtual int available() override;
+    virtual int read() override;
+    virtual int read(uint8_t* buffer, size_t len);
+    virtual size_t readBytes(char* buffer, size_t len);
+    virtual int peek() override;
+    virtual void flush() override {};
+    virtual size_t write(uint8_t) override { return 0; }
+  private:
+    enum class State : uint8_t { Header, Data, Done };
+    Stream *_source;
+    uint16_t _windowSize;
+    // Sliding window, history of windowSize and lookahead
+    uint8_t *_window = nullptr;
+    // Last position + 1 of 3 bytes sequence with the hash
+    uint16_t *_head = nullptr;
+    // Position of the next byte to compress in the window
+    uint16_t _pos = 0;
+    // End of data in the window
+    uint16_t _end = 0;
+    bool _sourceEnd = false;
+    State _state = State::Header;
+    uint32_t _bitBuffer = 0;
+    uint8_t _bitCount = 0;
+    // Compressed data waiting to be read
+    uint8_t _out[64];
+    uint8_t _outPos = 0;
+    uint8_t _outLen = 0;
+    uint32_t _crc = 0;
+    uint32_t _inputSize = 0;
+    // Data compressed by compress(), and their size
+    uint8_t *_data = nullptr;
+    uint32_t _size = 0;
+    uint32_t _read = 0;
+
+    // Compresses next part of data to the output buffer. Returns false at the end of data.
+    bool produce();
+    // Reads more data from source to the window
+    void fill();
+    void putByte(uint8_t b) { _out[_outLen++] = b; }
+    void putBits(uint32_t value, uint8_t bits);
+    // Puts Huffman code, which is stored from the most significant bit
+    void putCode(uint16_t code, uint8_t bits);
+    void putLiteral(uint8_t c);
+    void putMatch(uint16_t length, uint16_t distance);
+    uint16_t hash(uint16_t pos) const;
+};
+
+enum class GunzipError : uint8_t {
+    None = 0,
+    // Source ended before the end of compressed data
+    UnexpectedEnd,
+    // Data are not valid gzip, or CRC or size doesn't match
+    InvalidData,
+    // Back reference points further than the window size
+    WindowTooSmall,
+    NotEnoughMemory
+};
+
+/**
+ * GunzipStream reads gzip compressed data (RFC 1952) from the source stream and provides them decompressed.
+ * Data are inflated incrementally, as they are read. Only the window of last windowSize bytes is kept in memory.
+ * read() returns -1 at the end of data or in case of an error, check getError().
+ **/
+class GunzipStream : public Stream {
+  public:
+    // Creates stream decompressing data from source, using window of windowSize bytes (at least 512)
+    GunzipStream(Stream *source, uint16_t windowSize = INFLUXDB_CLIENT_GUNZIP_WINDOW);
+    virtual ~GunzipStream();
+    GunzipError getError() const { return _error; }
+    // Returns true if all data were decompressed and verified
+    bool isFinished() const { return _state == State::Done; }
+
+    // Stream overrides
+    // Returns number of decompressed bytes ready to be read, or 1 if more data can be decompressed
+    virtual int available() override;
+    virtual int read() override;
+    virtual int read(uint8_t* buffer, size_t len);
+    virtual size_t readBytes(char* buffer, size_t len);
+    virtual int peek() override;
+    virtual void flush() override {};
+    virtual size_t write(uint8_t) override { return 0; }
+  private:
+    enum class State : uint8_t { Header, BlockHeader, Stored, Codes, Trailer, Done, Error };
+    // Canonical Huffman code, count of codes of each length and symbols ordered by code
+    struct Huffman {
+        uint16_t count[16];
+        uint16_t *symbol;
+    };
+    Stream *_source;
+    uint16_t _windowSize;
+    // Circular buffer with recently decompressed data
+    uint8_t *_window = nullptr;
+    // Position where the next byte will be written to the window
+    uint16_t _writePos = 0;
+    // Number of decompressed bytes not yet read
+    uint16_t _unread = 0;
+    // Total number of decompressed bytes
+    uint32_t _outputSize = 0;
+    uint32_t _crc = 0;
+    State _state = State::Header;
+    GunzipError _error = GunzipError::None;
+    bool _lastBlock = false;
+    // Remaining bytes of a stored block
+    uint16_t _storedLen = 0;
+    uint32_t _bitBuffer = 0;
+    uint8_t _bitCount = 0;
+    // Compressed data read from source
+    uint8_t _in[64];
+    uint8_t _inPos = 0;
+    uint8_t _inLen = 0;
+    uint16_t _lengthSymbols[288];
+    uint16_t _distanceSymbols[30];
+    Huffman _lengthCode;
+    Huffman _distanceCode;
+
+    // Decompresses next part of data to the window. Returns false at the end of data or in case of error.
+    bool produce();
+    int nextByte();
+    // Returns next bits, or -1 if there are no more data
+    int32_t getBits(uint8_t bits);
+    int decodeSymbol(const Huffman &h);
+    bool buildHuffman(Huffman &h, const uint8_t *lengths, uint16_t n);
+    bool readHeader();
+    bool readBlockHeader();
+    bool readDynamicCodes();
+    bool readTrailer();
+    void putByte(uint8_t b);
+    bool setError(GunzipError error);
+};
+
+#endif //_INFLUXDB_CLIENT_GZIP_STREAM_H
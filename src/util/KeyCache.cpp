@@ -0,0 +1,230 @@
+/**
+ * 
+ * KeyCache.cpp: Fixed-capacity cache of escaped tag and field keys
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "KeyCache.h"
+#include <atomic>
+
+// True if char must be escaped in a key
+static bool isEscaped(char c) {
+    return c == ',' || c == '=' || c == ' ' || c == '\r' || c == '\n' || c == '\t';
+}
+
+static char readChar(const char *s, bool flash) {
+    return flash ? (char)pgm_read_byte(s) : *s;
+}
+
+// Appends escaped key to dest without the cache
+static void appendEscaped(String &dest, const char *key, bool flash) {
+    if(flash) {
+        char c;
+        while((c = readChar(key++, true))) {
+            if(isEscaped(c)) {
+                dest += '\\';
+            }
+            dest += c;
+        }
+        return;
+    }
+    // parts without chars to escape are copied at once
+    const char *start = key;
+    for(; *key; key++) {
+        if(isEscaped(*key)) {
+            dest.concat(start, key - start);
+            dest += '\\';
+            start = key;
+        }
+    }
+    dest.concat(start, key - start);
+}
+
+#if INFLUXDB_CLIENT_KEY_CACHE_SIZE > 0
+
+// Hash values of a free entry, of an entry being added and of an entry, which couldn't be added.
+// Unused entry isn't freed, as keys after it would be cut off from their probe sequence
+static const uint32_t Free = 0;
+static const uint32_t Busy = 1;
+static const uint32_t Unused = 2;
+// Max entries checked for a key, limits cost of a miss when the cache is full
+static const uint8_t MaxProbes = 8;
+
+struct Entry {
+    // Hash of the key, published after the entry is written
+    std::atomic<uint32_t> hash;
+    // Offset of the key in the memory block, followed by the escaped key, if it is different
+    uint16_t offset;
+    uint8_t length;
+    uint8_t escapedLength;
+};
+
+static Entry entries[INFLUXDB_CLIENT_KEY_CACHE_SIZE];
+static char keys[INFLUXDB_CLIENT_KEY_CACHE_BYTES];
+static std::atomic<uint16_t> keysUsed;
+static std::atomic<uint16_t> count;
+
+// FNV-1a hash of the key, also returns its length and length of the escaped key
+static uint32_t hashKey(const char *key, bool flash, size_t &length, size_t &escapedLength) {
+    uint32_t hash = 2166136261UL;
+    length = 0;
+    escapedLength = 0;
+    char c;
+    while((c = readChar(key + length, flash))) {
+        hash = (hash ^ (uint8_t)c) * 16777619UL;
+        length++;
+        escapedLength += isEscaped(c) ? 2 : 1;
+    }
+    return hash > Unused ? hash : hash + 3;
+}
+
+static bool equals(const Entry &entry, const char *key, bool flash, size_t length) {
+    if(entry.length != length) {
+        return false;
+    }
+    if(!flash) {
+        return !memcmp(keys + entry.offset, key, length);
+    }
+    for(size_t i = 0; i < length; i++) {
+        if(keys[entry.offset + i] != readChar(key + i, true)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static const char *escapedKey(const Entry &entry) {
+    return keys + entry.offset + (entry.escapedLength != entry.length ? entry.length : 0);
+}
+
+// Returns bytes of memory taken by the key
+static size_t entryBytes(size_t length, size_t escapedLength) {
+    return length + (escapedLength != length ? escapedLength : 0);
+}
+
+// Writes key to the claimed entry and publishes it. Returns false if there is not enough memory
+static bool addEntry(Entry &entry, const char *key, bool flash, uint32_t hash, size_t length, size_t escapedLength) {
+    size_t bytes = entryBytes(length, escapedLength);
+    uint16_t offset = keysUsed.load(std::memory_order_relaxed);
+    do {
+        if(offset + bytes > INFLUXDB_CLIENT_KEY_CACHE_BYTES) {
+            // memory was taken by another task meanwhile
+            entry.hash.store(Unused, std::memory_order_release);
+            return false;
+        }
+    } while(!keysUsed.compare_exchange_weak(offset, offset + bytes, std::memory_order_relaxed));
+    char *d = keys + offset;
+    for(size_t i = 0; i < length; i++) {
+        d[i] = readChar(key + i, flash);
+    }
+    if(escapedLength != length) {
+        d += length;
+        for(size_t i = 0; i < length; i++) {
+            char c = keys[offset + i];
+            if(isEscaped(c)) {
+                *d++ = '\\';
+            }
+            *d++ = c;
+        }
+    }
+    entry.offset = offset;
+    entry.length = length;
+    entry.escapedLength = escapedLength;
+    count.fetch_add(1, std::memory_order_relaxed);
+    entry.hash.store(hash, std::memory_order_release);
+    return true;
+}
+
+void KeyCache::append(String &dest, const KeyName &key) {
+    const char *name = key.c_str();
+    if(!name) {
+        return;
+    }
+    size_t length, escapedLength;
+    uint32_t hash = hashKey(name, key.isFlash(), length, escapedLength);
+    if(escapedLength <= 0xFF) {
+        uint16_t index = hash % INFLUXDB_CLIENT_KEY_CACHE_SIZE;
+        for(uint8_t i = 0; i < MaxProbes && i < INFLUXDB_CLIENT_KEY_CACHE_SIZE; i++, index = (index + 1) % INFLUXDB_CLIENT_KEY_CACHE_SIZE) {
+            Entry &entry = entries[index];
+            uint32_t h = entry.hash.load(std::memory_order_acquire);
+            if(h == Free && keysUsed.load(std::memory_order_relaxed) + entryBytes(length, escapedLength) > INFLUXDB_CLIENT_KEY_CACHE_BYTES) {
+                // key doesn't fit, entry is left free
+                break;
+            }
+            // failed exchange loads hash of the entry taken by another task meanwhile
+            if(h == Free && entry.hash.compare_exchange_strong(h, Busy, std::memory_order_acquire)) {
+                if(addEntry(entry, name, key.isFlash(), hash, length, escapedLength)) {
+                    dest.concat(escapedKey(entry), escapedLength);
+                    return;
+                }
+                break;
+            }
+            if(h == Busy) {
+                // being added by another task, don't wait
+                break;
+            }
+            if(h == hash && equals(entry, name, key.isFlash(), length)) {
+                dest.concat(escapedKey(entry), escapedLength);
+                return;
+            }
+        }
+    }
+    appendEscaped(dest, name, key.isFlash());
+}
+
+uint16_t KeyCache::getCount() {
+    return count.load(std::memory_order_relaxed);
+}
+
+uint16_t KeyCache::getBytes() {
+    return keysUsed.load(std::memory_order_relaxed);
+}
+
+void KeyCache::clear() {
+    for(Entry &entry : entries) {
+        entry.hash.store(Free, std::memory_order_relaxed);
+    }
+    keysUsed.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+}
+
+#else
+
+void KeyCache::append(String &dest, const KeyName &key) {
+    if(key.c_str()) {
+        appendEscaped(dest, key.c_str(), key.isFlash());
+    }
+}
+
+uint16_t KeyCache::getCount() {
+    return 0;
+}
+
+uint16_t KeyCache::getBytes() {
+    return 0;
+}
+
+void KeyCache::clear() {
+}
+
+#endif
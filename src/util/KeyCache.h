@@ -0,0 +1,75 @@
+/**
+ * 
+ * KeyCache.h: Fixed-capacity cache of escaped tag and field keys
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#ifndef _INFLUXDB_CLIENT_KEY_CACHE_H
+#define _INFLUXDB_CLIENT_KEY_CACHE_H
+
+#include <Arduino.h>
+
+// Max number of keys in the cache. Define as 0 in build flags to disable the cache
+#ifndef INFLUXDB_CLIENT_KEY_CACHE_SIZE
+#define INFLUXDB_CLIENT_KEY_CACHE_SIZE 64
+#endif
+// Bytes of memory for the keys in the cache
+#ifndef INFLUXDB_CLIENT_KEY_CACHE_BYTES
+#define INFLUXDB_CLIENT_KEY_CACHE_BYTES 1024
+#endif
+
+// Name of a tag or a field, in RAM or in flash, referenced without copying.
+// The name must stay valid and unchanged as long as the KeyName is used, so KeyName is meant only for parameters
+// and must not be kept after the call. It cannot be created from a temporary String, which is released before the KeyName.
+class KeyName {
+  public:
+    KeyName(const char *name):_name(name),_flash(false) {}
+    KeyName(const String &name):_name(name.c_str()),_flash(false) {}
+    KeyName(String &&name) = delete;
+    KeyName(const __FlashStringHelper *name):_name((const char *)name),_flash(true) {}
+    const char *c_str() const { return _name; }
+    bool isFlash() const { return _flash; }
+  private:
+    const char *_name;
+    bool _flash;
+};
+
+/**
+ * KeyCache keeps escaped tag and field keys, so a key used repeatedly is escaped only once and points don't allocate memory for it.
+ * Keys are found by hash of the unescaped key and compared, keys in flash are read in place.
+ * Entries are stored in a fixed-size hash table and their bytes in a fixed memory block, both allocated statically.
+ * When the cache is full, keys are escaped every time. Keys can be added from more tasks at once, without locking.
+ **/
+class KeyCache {
+  public:
+    // Appends escaped key to dest. The key is added to the cache if it is not there and there is space.
+    static void append(String &dest, const KeyName &key);
+    // Returns number of cached keys
+    static uint16_t getCount();
+    // Returns bytes of memory used by cached keys
+    static uint16_t getBytes();
+    // Removes all keys, e.g. after keys used only at start. Must not be called while points are being created in other tasks.
+    static void clear();
+};
+
+#endif //_INFLUXDB_CLIENT_KEY_CACHE_H
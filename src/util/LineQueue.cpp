@@ -0,0 +1,146 @@
+/**
+ * 
+ * LineQueue.cpp: Lock-free queue of lines from multiple producers to a single consumer
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "LineQueue.h"
+#include "MemoryStats.h"
+
+// Header flag of the committed record, then 7 bits of the tag and line length
+static const uint32_t Committed = 0x80000000;
+static const uint8_t TagShift = 24;
+static const uint32_t LengthMask = (1ul << TagShift) - 1;
+
+// Returns the largest power of two not above size, at least 4, or 0 for a smaller size
+static uint32_t ringSize(uint32_t size) {
+    if(size < 4) {
+        return 0;
+    }
+    uint32_t ring = 4;
+    while(ring <= size/2) {
+        ring <<= 1;
+    }
+    return ring;
+}
+
+LineQueue::LineQueue(uint32_t size):_size(ringSize(size)),_mask(_size - 1),_head(0),_tail(0),_dropped(0) {
+    // headers of records not committed yet must be zero
+    _data = _size ? (char *)calloc(_size, 1) : nullptr;
+    if(_data) {
+        MemoryAccounting::allocated(MemorySubsystem::WriteBuffer, _size);
+    }
+}
+
+LineQueue::~LineQueue() {
+    if(_data) {
+        MemoryAccounting::released(MemorySubsystem::WriteBuffer, _size);
+    }
+    free(_data);
+}
+
+void LineQueue::copyIn(uint32_t pos, const void *src, uint32_t len) {
+    pos &= _mask;
+    uint32_t n = _size - pos;
+    if(n > len) {
+        n = len;
+    }
+    memcpy(_data + pos, src, n);
+    memcpy(_data, (const char *)src + n, len - n);
+}
+
+void LineQueue::copyOut(uint32_t pos, void *dest, uint32_t len) const {
+    pos &= _mask;
+    uint32_t n = _size - pos;
+    if(n > len) {
+        n = len;
+    }
+    memcpy(dest, _data + pos, n);
+    memcpy((char *)dest + n, _data, len - n);
+}
+
+bool LineQueue::push(const char *line, uint32_t length, uint8_t tag) {
+    uint32_t size = recordSize(length);
+    if(length > LengthMask || tag >= 0x80 || size > _size) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    while(true) {
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        uint32_t used = head - tail;
+        if(used > _size) {
+            // head was loaded before the consumer passed it
+            head = _head.load(std::memory_order_relaxed);
+            continue;
+        }
+        if(used + size > _size) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        // on failure head is reloaded
+        if(_head.compare_exchange_weak(head, head + size, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    copyIn(head + sizeof(uint32_t), line, length);
+    // publish line after it is copied. Header is aligned, so it doesn't wrap
+    __atomic_store_n((uint32_t *)(_data + (head & _mask)), length | ((uint32_t)tag << TagShift) | Committed, __ATOMIC_RELEASE);
+    return true;
+}
+
+int32_t LineQueue::frontLength() const {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if(tail == _head.load(std::memory_order_relaxed)) {
+        return -1;
+    }
+    uint32_t h = header(tail);
+    if(!(h & Committed)) {
+        // reserved, but still being copied
+        return -1;
+    }
+    return h & LengthMask;
+}
+
+uint8_t LineQueue::frontTag() const {
+    return (header(_tail.load(std::memory_order_relaxed)) & ~Committed) >> TagShift;
+}
+
+void LineQueue::pop(char *dest) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    uint32_t length = header(tail) & LengthMask;
+    uint32_t size = recordSize(length);
+    if(dest) {
+        copyOut(tail + sizeof(uint32_t), dest, length);
+    }
+    // clear record, so its memory doesn't look like a committed header when reserved again
+    uint32_t index = tail & _mask;
+    uint32_t n = _size - index;
+    if(n > size) {
+        n = size;
+    }
+    memset(_data + index, 0, n);
+    memset(_data, 0, size - n);
+    // release space after line is copied
+    _tail.store(tail + size, std::memory_order_release);
+}
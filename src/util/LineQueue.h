@@ -0,0 +1,80 @@
+/**
+ * 
+ * LineQueue.h: Lock-free queue of lines from multiple producers to a single consumer
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#ifndef _INFLUXDB_CLIENT_LINE_QUEUE_H
+#define _INFLUXDB_CLIENT_LINE_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * LineQueue passes lines from multiple producers to a single consumer, which can run in different threads or tasks, without locking.
+ * Lines are stored back-to-back with their length in a ring of fixed size, allocated at once. Records are aligned to 4 bytes.
+ * Producer reserves space by moving the head with compare-and-swap, copies the line and then commits the record by storing its header.
+ * Consumer only moves the tail. It stops at a record not committed yet, so lines are taken in the order of reservation.
+ * Head and tail only grow and wrap at 2^32, they are masked to the ring size when indexing, so a stale head never passes
+ * compare-and-swap after the ring went around (ABA). Used space is head - tail.
+ **/
+class LineQueue {
+friend class Test;
+  public:
+    // Creates queue with size bytes of memory, rounded down to a power of two. Check isValid() for allocation failure.
+    LineQueue(uint32_t size);
+    ~LineQueue();
+    bool isValid() const { return _data != nullptr; }
+    // Producer: copies line of length bytes to the queue, with a tag (0-127) passed along. Can be called from more threads at once. 
+    // Returns false if there is not enough space.
+    bool push(const char *line, uint32_t length, uint8_t tag = 0);
+    // Consumer: returns length of the oldest line, or -1 if queue is empty or the oldest line is still being copied
+    int32_t frontLength() const;
+    // Consumer: returns tag of the oldest line, valid when frontLength() is not -1
+    uint8_t frontTag() const;
+    // Consumer: copies the oldest line to dest, which must have space for frontLength() bytes, and removes it from the queue.
+    // With dest nullptr, the line is only removed.
+    void pop(char *dest);
+    bool isEmpty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+    // Returns number of lines not pushed because the queue was full
+    uint32_t getDropped() const { return _dropped.load(std::memory_order_relaxed); }
+  private:
+    char *_data;
+    uint32_t _size;
+    // Size - 1, masks position to index of the ring
+    uint32_t _mask;
+    // Position where next line will be reserved
+    std::atomic<uint32_t> _head;
+    // Position of the oldest line, moved only by consumer
+    std::atomic<uint32_t> _tail;
+    std::atomic<uint32_t> _dropped;
+    // Copies data to/from the ring at position, wrapping at its end
+    void copyIn(uint32_t pos, const void *src, uint32_t len);
+    void copyOut(uint32_t pos, void *dest, uint32_t len) const;
+    // Returns header of the record at position, zero if it is not committed
+    uint32_t header(uint32_t pos) const { return __atomic_load_n((uint32_t *)(_data + (pos & _mask)), __ATOMIC_ACQUIRE); }
+    // Returns size of record for line of length bytes, including the header
+    static uint32_t recordSize(uint32_t length) { return sizeof(uint32_t) + ((length + 3) & ~3u); }
+};
+
+#endif //_INFLUXDB_CLIENT_LINE_QUEUE_H
@@ -0,0 +1,90 @@
+/**
+ * 
+ * MemoryStats.cpp: Accounting of heap memory used by the library
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "MemoryStats.h"
+
+// Counters of subsystems followed by the total
+static const uint8_t TotalIndex = 4;
+static std::atomic<uint32_t> current[TotalIndex + 1];
+static std::atomic<uint32_t> peak[TotalIndex + 1];
+static std::atomic<uint32_t> allocations[TotalIndex + 1];
+
+const MemoryUsage &MemoryStats::get(MemorySubsystem subsystem) const {
+    switch(subsystem) {
+        case MemorySubsystem::WriteBuffer:
+            return writeBuffer;
+        case MemorySubsystem::Points:
+            return points;
+        case MemorySubsystem::Query:
+            return query;
+        default:
+            return http;
+    }
+}
+
+void MemoryAccounting::add(uint8_t index, int32_t bytes, uint32_t allocs) {
+    uint32_t now = current[index].fetch_add((uint32_t)bytes, std::memory_order_relaxed) + (uint32_t)bytes;
+    if(allocs) {
+        allocations[index].fetch_add(allocs, std::memory_order_relaxed);
+    }
+    if(bytes > 0) {
+        uint32_t max = peak[index].load(std::memory_order_relaxed);
+        while(now > max && !peak[index].compare_exchange_weak(max, now, std::memory_order_relaxed));
+    }
+}
+
+void MemoryAccounting::allocated(MemorySubsystem subsystem, uint32_t bytes) {
+    add((uint8_t)subsystem, bytes, 1);
+    add(TotalIndex, bytes, 1);
+}
+
+void MemoryAccounting::released(MemorySubsystem subsystem, uint32_t bytes) {
+    add((uint8_t)subsystem, -(int32_t)bytes, 0);
+    add(TotalIndex, -(int32_t)bytes, 0);
+}
+
+void MemoryAccounting::resized(MemorySubsystem subsystem, uint32_t oldBytes, uint32_t newBytes) {
+    if(newBytes == oldBytes) {
+        return;
+    }
+    uint32_t allocs = newBytes > oldBytes ? 1 : 0;
+    add((uint8_t)subsystem, (int32_t)(newBytes - oldBytes), allocs);
+    add(TotalIndex, (int32_t)(newBytes - oldBytes), allocs);
+}
+
+static MemoryUsage usage(uint8_t index) {
+    return MemoryUsage{ current[index].load(std::memory_order_relaxed), peak[index].load(std::memory_order_relaxed), allocations[index].load(std::memory_order_relaxed) };
+}
+
+MemoryStats MemoryAccounting::getStats() {
+    return MemoryStats{ usage(0), usage(1), usage(2), usage(3), usage(TotalIndex) };
+}
+
+void MemoryAccounting::resetPeaks() {
+    for(uint8_t i = 0; i <= TotalIndex; i++) {
+        peak[i].store(current[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,89 @@
+/**
+ * 
+ * MemoryStats.h: Accounting of heap memory used by the library
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#ifndef _INFLUXDB_CLIENT_MEMORY_STATS_H
+#define _INFLUXDB_CLIENT_MEMORY_STATS_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Parts of the library heap usage is reported for
+enum class MemorySubsystem : uint8_t {
+    // Batches, write buffer array, line buffer, writer task queue and data of sync writes
+    WriteBuffer = 0,
+    // Data of points
+    Points,
+    // Query results and query parameters
+    Query,
+    // HTTP services, network clients, estimated TLS buffers and request buffers
+    Http
+};
+
+// Heap usage of a single subsystem
+struct MemoryUsage {
+    // Bytes allocated at the moment
+    uint32_t current;
+    // Maximum of bytes allocated at once since start or last resetMemoryPeaks()
+    uint32_t peak;
+    // Number of allocations since start
+    uint32_t allocations;
+};
+
+// Snapshot of heap usage of the library, returned by InfluxDBClient::getMemoryStats()
+struct MemoryStats {
+    MemoryUsage writeBuffer;
+    MemoryUsage points;
+    MemoryUsage query;
+    MemoryUsage http;
+    // Sum of all subsystems, peak is the maximum of the sum
+    MemoryUsage total;
+    // Returns usage of the subsystem
+    const MemoryUsage &get(MemorySubsystem subsystem) const;
+};
+
+/**
+ * MemoryAccounting keeps library-wide counters of heap used by the subsystems.
+ * Allocation sites report sizes of the blocks they allocate and release. Sizes of String contents are taken by their length,
+ * TLS buffers allocated by the network client are estimated, so the numbers are close to, but not exactly the heap consumption.
+ * Counters are relaxed atomics, so accounting can be called from any task and costs a few instructions.
+ **/
+class MemoryAccounting {
+  public:
+    // Adds a block of bytes allocated by the subsystem
+    static void allocated(MemorySubsystem subsystem, uint32_t bytes);
+    // Removes a block of bytes released by the subsystem
+    static void released(MemorySubsystem subsystem, uint32_t bytes);
+    // Changes accounted size of a block from oldBytes to newBytes, counts a new allocation if the block grows
+    static void resized(MemorySubsystem subsystem, uint32_t oldBytes, uint32_t newBytes);
+    // Returns snapshot of all counters
+    static MemoryStats getStats();
+    // Sets peaks to the current usage
+    static void resetPeaks();
+  private:
+    static void add(uint8_t index, int32_t bytes, uint32_t allocations);
+};
+
+#endif //_INFLUXDB_CLIENT_MEMORY_STATS_H
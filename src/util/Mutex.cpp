@@ -0,0 +1,55 @@
+/**
+ * 
+ * Mutex.cpp: Lock of data shared by writing tasks
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "Mutex.h"
+
+Mutex::Mutex() {
+#if defined(ESP32)
+    _mutex = xSemaphoreCreateMutex();
+#endif
+}
+
+Mutex::~Mutex() {
+#if defined(ESP32)
+    vSemaphoreDelete(_mutex);
+#endif
+}
+
+void Mutex::lock() {
+#if defined(ESP32)
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+#elif !defined(ESP8266)
+    _mutex.lock();
+#endif
+}
+
+void Mutex::unlock() {
+#if defined(ESP32)
+    xSemaphoreGive(_mutex);
+#elif !defined(ESP8266)
+    _mutex.unlock();
+#endif
+}
@@ -0,0 +1,56 @@
+/**
+ * 
+ * Mutex.h: Lock of data shared by writing tasks
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#ifndef _INFLUXDB_CLIENT_MUTEX_H
+#define _INFLUXDB_CLIENT_MUTEX_H
+
+#include <Arduino.h>
+#if !defined(ESP32) && !defined(ESP8266)
+#include <mutex>
+#endif
+
+/**
+ * Mutex guards data, which is changed by tasks writing points at once, e.g. state of send-on-change filter or aggregation.
+ * It is FreeRTOS mutex with priority inheritance on ESP32, std::mutex in other builds. ESP8266 has a single task, lock does nothing.
+ * It is not recursive and it should be held only for a short time, without any network operation.
+ **/
+class Mutex {
+  public:
+    Mutex();
+    ~Mutex();
+    Mutex(const Mutex &) = delete;
+    Mutex &operator=(const Mutex &) = delete;
+    void lock();
+    void unlock();
+  private:
+#if defined(ESP32)
+    SemaphoreHandle_t _mutex = nullptr;
+#elif !defined(ESP8266)
+    std::mutex _mutex;
+#endif
+};
+
+#endif //_INFLUXDB_CLIENT_MUTEX_H
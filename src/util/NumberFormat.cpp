@@ -0,0 +1,185 @@
+/**
+ * 
+ * NumberFormat.cpp: Allocation-free formatting of numbers for line protocol
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "NumberFormat.h"
+#include <math.h>
+
+// Pairs of digits 00-99, to convert two digits at once
+static const char DigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Powers of ten exactly representable by double
+static const double PowersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17 };
+static const uint8_t MaxDecimalPlaces = 17;
+
+// Integers up to 2^53 are exact in double
+static const double MaxExactInteger = 9007199254740992.0;
+
+uint8_t formatUnsigned(char *buff, unsigned long long value) {
+    // digits are written from the end of a temporary buffer
+    char tmp[20];
+    char *d = tmp + sizeof(tmp);
+    while(value >= 100) {
+        uint8_t pair = value % 100;
+        value /= 100;
+        *--d = DigitPairs[pair*2 + 1];
+        *--d = DigitPairs[pair*2];
+    }
+    if(value >= 10) {
+        *--d = DigitPairs[value*2 + 1];
+        *--d = DigitPairs[value*2];
+    } else {
+        *--d = '0' + value;
+    }
+    uint8_t len = tmp + sizeof(tmp) - d;
+    memcpy(buff, d, len);
+    buff[len] = 0;
+    return len;
+}
+
+uint8_t formatInteger(char *buff, long long value) {
+    if(value < 0) {
+        *buff = '-';
+        // negation of the minimum is done in unsigned
+        return formatUnsigned(buff + 1, 0ull - (unsigned long long)value) + 1;
+    }
+    return formatUnsigned(buff, value);
+}
+
+// Writes inf or nan, returns 0 for finite number
+static uint8_t formatNonFinite(char *buff, double value) {
+    const char *s;
+    if(isnan(value)) {
+        s = "nan";
+    } else if(isinf(value)) {
+        s = value < 0 ? "-inf" : "inf";
+    } else {
+        return 0;
+    }
+    strcpy(buff, s);
+    return strlen(s);
+}
+
+// Writes scaled/10^decimalPlaces with the sign
+static uint8_t formatScaled(char *buff, bool negative, unsigned long long scaled, uint8_t decimalPlaces) {
+    char *d = buff;
+    if(negative) {
+        *d++ = '-';
+    }
+    unsigned long long divisor = (unsigned long long)PowersOf10[decimalPlaces];
+    d += formatUnsigned(d, scaled / divisor);
+    if(decimalPlaces) {
+        *d++ = '.';
+        // fraction with leading zeroes
+        unsigned long long fraction = scaled % divisor;
+        for(int8_t i = decimalPlaces - 1; i >= 0; i--) {
+            d[i] = '0' + fraction % 10;
+            fraction /= 10;
+        }
+        d += decimalPlaces;
+    }
+    *d = 0;
+    return d - buff;
+}
+
+uint8_t formatDecimal(char *buff, double value, int decimalPlaces) {
+    uint8_t len = formatNonFinite(buff, value);
+    if(len) {
+        return len;
+    }
+    if(decimalPlaces < 0 || decimalPlaces > MaxDecimalPlaces) {
+        return formatShortest(buff, value);
+    }
+    double scaled = fabs(value) * PowersOf10[decimalPlaces] + 0.5;
+    if(scaled >= MaxExactInteger) {
+        return formatShortest(buff, value);
+    }
+    return formatScaled(buff, value < 0, (unsigned long long)scaled, decimalPlaces);
+}
+
+// Finds the least decimal places, by which the number parses back to the same value. 
+// Returns false if fixed notation doesn't fit into double, then precision is set to the least number of significant digits to try.
+template<typename T>
+static bool findShortestFixed(T value, unsigned long long &scaled, uint8_t &decimalPlaces, uint8_t &precision) {
+    double a = fabs((double)value);
+    precision = 1;
+    for(uint8_t d = 0; d <= MaxDecimalPlaces; d++) {
+        double s = round(a * PowersOf10[d]);
+        if(s >= MaxExactInteger) {
+            // representations with up to 15 significant digits were checked, unless the number is too large
+            precision = d ? 16 : 1;
+            return false;
+        }
+        // both s and 10^d are exact, so the quotient is the correctly rounded value of the decimal number
+        if((T)(s / PowersOf10[d]) == (T)a) {
+            scaled = (unsigned long long)s;
+            decimalPlaces = d;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Formats number in exponent notation with the least significant digits, which parse back to the same value
+template<typename T>
+static uint8_t formatExponent(char *buff, T value, uint8_t precision) {
+    int len = 0;
+    for(; precision <= 17; precision++) {
+        len = snprintf(buff, MaxNumberLength + 1, "%.*g", precision, (double)value);
+        if((T)strtod(buff, nullptr) == value) {
+            break;
+        }
+    }
+    return len;
+}
+
+template<typename T>
+static uint8_t formatShortestNumber(char *buff, T value) {
+    uint8_t len = formatNonFinite(buff, value);
+    if(len) {
+        return len;
+    }
+    if(value == 0) {
+        strcpy(buff, "0");
+        return 1;
+    }
+    unsigned long long scaled;
+    uint8_t decimalPlaces, precision;
+    if(findShortestFixed(value, scaled, decimalPlaces, precision)) {
+        return formatScaled(buff, value < 0, scaled, decimalPlaces);
+    }
+    return formatExponent(buff, value, precision);
+}
+
+uint8_t formatShortest(char *buff, double value) {
+    return formatShortestNumber(buff, value);
+}
+
+uint8_t formatShortest(char *buff, float value) {
+    return formatShortestNumber(buff, value);
+}
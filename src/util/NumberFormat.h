@@ -0,0 +1,53 @@
+/**
+ * 
+ * NumberFormat.h: Allocation-free formatting of numbers for line protocol
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#ifndef _INFLUXDB_CLIENT_NUMBER_FORMAT_H
+#define _INFLUXDB_CLIENT_NUMBER_FORMAT_H
+
+#include <Arduino.h>
+
+// Max length of a formatted number, without terminating zero
+const uint8_t MaxNumberLength = 24;
+// Decimal places to format a floating point number by the round-trip representation, with the least digits which parse back to the same value
+const int DecimalPlacesShortest = -1;
+
+// Formatting functions write a number into buff, which must have space for MaxNumberLength + 1 chars,
+// terminate it and return its length. They don't allocate any memory.
+
+// Formats signed integer
+uint8_t formatInteger(char *buff, long long value);
+// Formats unsigned integer
+uint8_t formatUnsigned(char *buff, unsigned long long value);
+// Formats number with fixed decimal places, rounding half away from zero as String(value, decimalPlaces).
+// Numbers too large for fixed notation and negative decimal places are formatted by formatShortest.
+uint8_t formatDecimal(char *buff, double value, int decimalPlaces);
+// Formats number by the least significant digits, which parse back to the same double, or float respectively (round-trip).
+// Exponent notation is used only when fixed notation would need more than 17 digits, so the text isn't always the shortest one,
+// e.g. 1.5e-10 is written as 0.00000000015.
+uint8_t formatShortest(char *buff, double value);
+uint8_t formatShortest(char *buff, float value);
+
+#endif //_INFLUXDB_CLIENT_NUMBER_FORMAT_H
@@ -0,0 +1,177 @@
+/**
+ * 
+ * WriterTask.cpp: Background task running write work periodically
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "WriterTask.h"
+
+// Task running in the current thread
+static thread_local WriterTask *currentTask = nullptr;
+
+WriterTask::WriterTask():_running(false),_finished(true),_request(nullptr) {
+#if defined(ESP32)
+    _mutex = xSemaphoreCreateMutex();
+#endif
+}
+
+WriterTask::~WriterTask() {
+    stop();
+#if defined(ESP32)
+    vSemaphoreDelete(_mutex);
+#endif
+}
+
+bool WriterTask::isSupported() {
+#if defined(ESP8266)
+    return false;
+#else
+    return true;
+#endif
+}
+
+bool WriterTask::start(Work work, uint16_t intervalMs) {
+    if(_running.load()) {
+        return true;
+    }
+    _work = work;
+    _interval = intervalMs;
+    _running = true;
+    _finished = false;
+#if defined(ESP32)
+    if(!_mutex || xTaskCreatePinnedToCore(run, "influxdb-writer", INFLUXDB_CLIENT_WRITER_STACK_SIZE, this, 
+            INFLUXDB_CLIENT_WRITER_PRIORITY, &_handle, INFLUXDB_CLIENT_WRITER_CORE) != pdPASS) {
+        _running = false;
+        _finished = true;
+        return false;
+    }
+    return true;
+#elif defined(ESP8266)
+    _running = false;
+    _finished = true;
+    return false;
+#else
+    _thread = new std::thread(run, this);
+    return true;
+#endif
+}
+
+void WriterTask::stop() {
+    if(!_running.load()) {
+        return;
+    }
+#if defined(ESP32)
+    // waits for a call in progress
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _running = false;
+    xSemaphoreGive(_mutex);
+    notify();
+    // task deletes itself
+    while(!_finished.load()) {
+        delay(1);
+    }
+    _handle = nullptr;
+#elif !defined(ESP8266)
+    _mutex.lock();
+    _running = false;
+    _mutex.unlock();
+    notify();
+    _thread->join();
+    delete _thread;
+    _thread = nullptr;
+#endif
+}
+
+bool WriterTask::isCurrent() const {
+    return currentTask == this;
+}
+
+void WriterTask::call(const Work &work) {
+#if !defined(ESP8266)
+    if(!isCurrent()) {
+#if defined(ESP32)
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+#else
+        _mutex.lock();
+#endif
+        bool running = _running.load();
+        if(running) {
+            _request = &work;
+            notify();
+            while(_request.load()) {
+                delay(1);
+            }
+        }
+#if defined(ESP32)
+        xSemaphoreGive(_mutex);
+#else
+        _mutex.unlock();
+#endif
+        if(running) {
+            return;
+        }
+    }
+#endif
+    work();
+}
+
+void WriterTask::notify() {
+#if defined(ESP32)
+    if(_handle) {
+        xTaskNotifyGive(_handle);
+    }
+#elif !defined(ESP8266)
+    std::lock_guard<std::mutex> lock(_waitMutex);
+    _wake.notify_one();
+#endif
+}
+
+void WriterTask::wait() {
+#if defined(ESP32)
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(_interval));
+#elif !defined(ESP8266)
+    std::unique_lock<std::mutex> lock(_waitMutex);
+    _wake.wait_for(lock, std::chrono::milliseconds(_interval), [this]() {
+        return _request.load() || !_running.load();
+    });
+#endif
+}
+
+void WriterTask::run(void *param) {
+    WriterTask *task = (WriterTask *)param;
+    currentTask = task;
+    while(task->_running.load()) {
+        task->_work();
+        task->wait();
+        const Work *request = task->_request.load();
+        if(request) {
+            (*request)();
+            task->_request = nullptr;
+        }
+    }
+    currentTask = nullptr;
+    task->_finished = true;
+#if defined(ESP32)
+    vTaskDelete(nullptr);
+#endif
+}
@@ -0,0 +1,99 @@
+/**
+ * 
+ * WriterTask.h: Background task running write work periodically
+ * 
+ * MIT License
+ * 
+ * Copyright (c) 2020 InfluxData
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#ifndef _INFLUXDB_CLIENT_WRITER_TASK_H
+#define _INFLUXDB_CLIENT_WRITER_TASK_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#if !defined(ESP32) && !defined(ESP8266)
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+// Stack size of the writer task on ESP32. HTTPS requires more than HTTP.
+#ifndef INFLUXDB_CLIENT_WRITER_STACK_SIZE
+#define INFLUXDB_CLIENT_WRITER_STACK_SIZE 8192
+#endif
+#ifndef INFLUXDB_CLIENT_WRITER_PRIORITY
+#define INFLUXDB_CLIENT_WRITER_PRIORITY 1
+#endif
+// Core where the writer task runs on ESP32. Arduino loop runs on core 1 by default.
+#ifndef INFLUXDB_CLIENT_WRITER_CORE
+#define INFLUXDB_CLIENT_WRITER_CORE 0
+#endif
+
+/**
+ * WriterTask runs work function periodically in a background task: FreeRTOS task on ESP32, std::thread in other builds.
+ * ESP8266 doesn't support it. Work is run without any lock, data used by it belong to the task while it runs.
+ * Other threads pass their work on the same data to the task by call() and wait for it, instead of locking the data out.
+ **/
+class WriterTask {
+  public:
+    typedef std::function<void()> Work;
+    WriterTask();
+    // Stops task, if running
+    ~WriterTask();
+    // Starts task running work and waiting intervalMs after each run. Returns false if task cannot be created.
+    bool start(Work work, uint16_t intervalMs);
+    // Stops task, waits for the current run to finish
+    void stop();
+    bool isRunning() const { return _running.load(); }
+    // Runs work in the task between its periodic runs and waits for it. Calls from more threads are served one by one.
+    // Work is run directly, if the caller is the task itself or the task doesn't run.
+    void call(const Work &work);
+    // Returns true if called from the task
+    bool isCurrent() const;
+    // Returns true if the task is supported on this platform
+    static bool isSupported();
+  private:
+    Work _work;
+    uint16_t _interval = 0;
+    std::atomic<bool> _running;
+    std::atomic<bool> _finished;
+    // Work passed by call(), cleared by the task when done
+    std::atomic<const Work *> _request;
+#if defined(ESP32)
+    TaskHandle_t _handle = nullptr;
+    // Serializes callers
+    SemaphoreHandle_t _mutex = nullptr;
+#elif !defined(ESP8266)
+    std::thread *_thread = nullptr;
+    std::mutex _mutex;
+    // Wakes the task waiting for the next run
+    std::mutex _waitMutex;
+    std::condition_variable _wake;
+#endif
+    static void run(void *param);
+    // Waits the interval, or less if there is a request or the task is stopped
+    void wait();
+    // Wakes the task
+    void notify();
+};
+
+#endif //_INFLUXDB_CLIENT_WRITER_TASK_H
@@ -25,6 +25,7 @@
  * SOFTWARE.
 */
 #include "helpers.h"
+#include "NumberFormat.h"
 
 void timeSync(const char *tzInfo, const char* ntpServer1, const char* ntpServer2, const char* ntpServer3) {
   // Accurate time is necessary for certificate validion
@@ -69,9 +70,8 @@ unsigned long long getTimeStamp(struct timeval *tv, int secFracDigits) {
 }
 
 char *timeStampToString(unsigned long long timestamp, int extraCharsSpace) {
-    //22 is max long long string length (18)
-    char *buff = new char[22+extraCharsSpace+1];
-    snprintf(buff, 22, "%llu", timestamp);
+    char *buff = new char[MaxNumberLength+extraCharsSpace+1];
+    formatUnsigned(buff, timestamp);
     return buff;
 }
 
@@ -98,6 +98,25 @@ char *escapeKey(const String &key, bool escapeEqual) {
    return ret;
 }
 
+size_t escapeKeyTo(char *dest, size_t size, const char *key, bool escapeEqual) {
+    const char *chars = escapeEqual?escapeChars:escapeChars+1;
+    size_t n = 0;
+    char c;
+    while ((c = *key++)) {
+        if(strchr(chars, c)) {
+            if(n < size) {
+                dest[n] = '\\';
+            }
+            n++;
+        }
+        if(n < size) {
+            dest[n] = c;
+        }
+        n++;
+    }
+    return n;
+}
+
 String escapeValue(const char *value) {
     String ret;
     int len = strlen_P(value);
@@ -185,4 +204,67 @@ size_t strLen(const char *str) {
         return 0;
     }
     return strlen(str);
+}
+
+const char *nextField(const char *fields, const char *&name, size_t &nameLen, const char *&value, size_t &valueLen) {
+    const char *p = fields;
+    if(!p || !*p) {
+        return nullptr;
+    }
+    name = p;
+    while(*p && *p != '=') {
+        if(*p == '\\' && p[1]) {
+            p++;
+        }
+        p++;
+    }
+    nameLen = p - name;
+    if(*p) {
+        p++;
+    }
+    value = p;
+    if(*p == '"') {
+        // string can contain escaped quote and comma
+        p++;
+        while(*p && *p != '"') {
+            if(*p == '\\' && p[1]) {
+                p++;
+            }
+            p++;
+        }
+        if(*p) {
+            p++;
+        }
+    } else {
+        while(*p && *p != ',') {
+            p++;
+        }
+    }
+    valueLen = p - value;
+    if(*p == ',') {
+        p++;
+    }
+    return p;
+}
+
+bool parseFieldValue(const char *value, size_t len, double &number, char &type) {
+    type = 0;
+    if(!len || *value == '"') {
+        return false;
+    }
+    if(*value == 't' || *value == 'T') {
+        number = 1;
+        return true;
+    }
+    if(*value == 'f' || *value == 'F') {
+        number = 0;
+        return true;
+    }
+    const char *end = value + len;
+    char *parsed;
+    number = strtod(value, &parsed);
+    if(parsed < end && (*parsed == 'i' || *parsed == 'u')) {
+        type = *parsed++;
+    }
+    return parsed == end && parsed != value && isfinite(number);
 }
\ No newline at end of file
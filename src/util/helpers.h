@@ -43,6 +43,8 @@ char *timeStampToString(unsigned long long timestamp, int extraCharsSpace = 0);
 
 // Escape invalid chars in measurement, tag key, tag value and field key
 char *escapeKey(const String &key, bool escapeEqual = true);
+// Writes escaped key to dest, if it fits into size bytes. Returns length of the escaped key, without terminating zero
+size_t escapeKeyTo(char *dest, size_t size, const char *key, bool escapeEqual = true);
 
 // Escape invalid chars in field value
 String escapeValue(const char *value);
@@ -58,6 +60,12 @@ uint8_t getNumLength(long long l);
 char *cloneStr(const char *str);
 // Like strlen, but accepts nullptr
 size_t strLen(const char *str);
+// Splits the first field of fields in line protocol, name=value,name=value, to escaped name and value with their lengths.
+// Returns pointer to the next field, or nullptr if there is no field
+const char *nextField(const char *fields, const char *&name, size_t &nameLen, const char *&value, size_t &valueLen);
+// Parses field value in line protocol of length len. Booleans are 1 and 0, type is set to suffix of integers, 'i' or 'u', otherwise to 0.
+// Returns false for string or invalid value
+bool parseFieldValue(const char *value, size_t len, double &number, char &type);
 
 
 #endif //_INFLUXDB_CLIENT_HELPERS_H
\ No newline at end of file
@@ -31,8 +31,17 @@
 #include <Platform.h>
 #include "../src/Version.h"
 #include "InfluxData.h"
+#include "util/GzipStream.h"
+#include "util/LineQueue.h"
+#include "util/Aggregator.h"
+#include "util/ChangeFilter.h"
+#if !defined(ESP8266)
+#include <thread>
+#endif
 
 #define INFLUXDB_CLIENT_TESTING_BAD_URL "http://127.0.0.1:999"
+// Local port of a server, which accepts connections, but never reads
+#define INFLUXDB_CLIENT_TESTING_SILENT_PORT 9998
 
 void Test::run() {
     failures = 0;
@@ -43,6 +52,13 @@ void Test::run() {
     testPoint();
     testOldAPI();
     testBatch();
+    testWriteBuffer();
+    testBatchPerformance();
+    testGzipStream();
+    testGunzipStream();
+    testLineQueue();
+    testLineQueueProducers();
+    testConcurrentWrites();
     testLineProtocol();
     testEscaping();
     testUrlEncode();
@@ -72,6 +88,12 @@ void Test::run() {
     testDefaultTags();
     // Advanced tests
     testLargeBatch();  
+    testWriteCompression();
+    testQueryCompression(false);
+    testQueryCompression(true);
+    testAsyncWrite();
+    testWriterTask();
+    testPipelinedWrites();
     testFailedWrites();
     testTimestamp();
     testRetryOnFailedConnection();
@@ -79,9 +101,27 @@ void Test::run() {
     testNonRetry();
     testBufferOverwriteBatchsize1();
     testBufferOverwriteBatchsize5();
+    testBufferBytes();
+    testFlushBytes();
+    testAdaptiveBatchSize();
+    testPriorityLanes();
+    testOverflowPolicy();
+    testAggregation();
+    testChangeFilter();
+    testFanOut();
+    testBucketRouting();
+    testMemoryStats();
+    testPointSchema();
+    testNumberFormat();
+    testKeyCache();
+    testPointReset();
+    testSeriesPrefix();
+    testAsyncWriteFullSocket();
+    testWriterTaskLatency();
     testServerTempDownBatchsize5();
     testRetriesOnServerOverload();
     testRetryInterval();
+    testRetryBackoff();
     testBuckets(); 
     testQueryWithParams();
     Serial.printf("Tests %s\n", failures ? "FAILED" : "SUCCEEDED");
@@ -109,9 +149,23 @@ void Test::testOptions() {
     TEST_ASSERT(defWO._retryInterval == 5);
     TEST_ASSERT(defWO._maxRetryInterval == 300);
     TEST_ASSERT(defWO._maxRetryAttempts == 3);
+    TEST_ASSERT(defWO._retryMultiplier == 0);
+    TEST_ASSERT(!defWO._retryJitter);
     TEST_ASSERT(defWO._defaultTags.length() == 0);
     TEST_ASSERT(!defWO._useServerTimestamp);
-
+    TEST_ASSERT(defWO._bufferBytes == 0);
+    TEST_ASSERT(defWO._highWatermark == 80);
+    TEST_ASSERT(defWO._lowWatermark == 50);
+    TEST_ASSERT(defWO._flushBytes == 0);
+    TEST_ASSERT(!defWO._alignFlushBytes);
+    TEST_ASSERT(defWO._compression == Compression::None);
+    TEST_ASSERT(defWO._asyncBudget == 0);
+    TEST_ASSERT(defWO._asyncConnectTimeout == 1000);
+    TEST_ASSERT(defWO._maxInFlight == 1);
+    TEST_ASSERT(defWO._minBatchSize == 0);
+    TEST_ASSERT(defWO._targetRtt == 1000);
+    TEST_ASSERT(defWO._overflowPolicy == OverflowPolicy::DropOldest);
+    TEST_ASSERT(defWO._changeFilterSize == 0);
 
     defWO = WriteOptions().writePrecision(WritePrecision::NS).batchSize(32000).bufferSize(20).flushInterval(120).retryInterval(1).maxRetryInterval(20).maxRetryAttempts(5).addDefaultTag("tag1","val1").addDefaultTag("tag2","val2").useServerTimestamp(true);
     TEST_ASSERT(defWO._writePrecision == WritePrecision::NS);
@@ -127,12 +181,23 @@ void Test::testOptions() {
     HTTPOptions defHO;
     TEST_ASSERT(!defHO._connectionReuse);
     TEST_ASSERT(defHO._httpReadTimeout == 5000);
+    TEST_ASSERT(defHO._queryCompression == Compression::None);
 
     defHO = HTTPOptions().connectionReuse(true).httpReadTimeout(20000);
     TEST_ASSERT(defHO._connectionReuse);
     TEST_ASSERT(defHO._httpReadTimeout == 20000);
+    TEST_ASSERT(HTTPOptions().queryCompression(Compression::Gzip)._queryCompression == Compression::Gzip);
 
     InfluxDBClient c;
+#if defined(INFLUXDB_CLIENT_GUNZIP_DISABLED)
+    // default window is too big for ESP8266
+    TEST_ASSERT(!c.setHTTPOptions(HTTPOptions().queryCompression(Compression::Gzip)));
+    TEST_ASSERT(c._connInfo.httpOptions._queryCompression == Compression::None);
+#else
+    TEST_ASSERT(c.setHTTPOptions(HTTPOptions().queryCompression(Compression::Gzip)));
+    TEST_ASSERT(c._connInfo.httpOptions._queryCompression == Compression::Gzip);
+#endif
+    c.setHTTPOptions(HTTPOptions());
     TEST_ASSERT(c._writeOptions._writePrecision == WritePrecision::NoTime);
     TEST_ASSERT(c._writeOptions._batchSize == 1);
     TEST_ASSERT(c._writeOptions._bufferSize == 5);
@@ -181,6 +246,69 @@ void Test::testOptions() {
     c.setWriteOptions(defWO);
     TEST_ASSERTM(c._writeBufferSize == 70, String(c._writeBufferSize));
 
+    defWO = WriteOptions().batchSize(100).bufferSize(7000).bufferBytes(10000).bufferWatermarks(90, 20);
+    TEST_ASSERT(defWO._bufferBytes == 10000);
+    TEST_ASSERT(defWO._highWatermark == 90);
+    TEST_ASSERT(defWO._lowWatermark == 20);
+    // invalid watermarks are limited
+    TEST_ASSERT(WriteOptions().bufferWatermarks(150, 120)._highWatermark == 100);
+    TEST_ASSERT(WriteOptions().bufferWatermarks(150, 120)._lowWatermark == 99);
+    TEST_ASSERT(WriteOptions().bufferWatermarks(40, 60)._highWatermark == 40);
+    TEST_ASSERT(WriteOptions().bufferWatermarks(40, 60)._lowWatermark == 39);
+    TEST_ASSERT(WriteOptions().bufferWatermarks(0, 0)._highWatermark == 1);
+    TEST_ASSERT(WriteOptions().bufferWatermarks(0, 0)._lowWatermark == 0);
+    c.setWriteOptions(defWO);
+    TEST_ASSERT(c._writeOptions._bufferBytes == 10000);
+    TEST_ASSERT(c._writeOptions._highWatermark == 90);
+    TEST_ASSERT(c._writeOptions._lowWatermark == 20);
+    TEST_ASSERT(!c._lineBuffer);
+
+    defWO = WriteOptions().flushBytes(4096, true);
+    TEST_ASSERT(defWO._flushBytes == 4096);
+    TEST_ASSERT(defWO._alignFlushBytes);
+    c.setWriteOptions(defWO);
+    TEST_ASSERT(c._writeOptions._flushBytes == 4096);
+    TEST_ASSERT(c._writeOptions._alignFlushBytes);
+
+    defWO = WriteOptions().compression(Compression::Gzip);
+    TEST_ASSERT(defWO._compression == Compression::Gzip);
+    c.setWriteOptions(defWO);
+    TEST_ASSERT(c._writeOptions._compression == Compression::Gzip);
+
+    defWO = WriteOptions().asyncWrite(10, 3000);
+    TEST_ASSERT(defWO._asyncBudget == 10);
+    TEST_ASSERT(defWO._asyncConnectTimeout == 3000);
+    c.setWriteOptions(defWO);
+    TEST_ASSERT(c._writeOptions._asyncBudget == 10);
+    TEST_ASSERT(c._writeOptions._asyncConnectTimeout == 3000);
+
+    defWO = WriteOptions().maxInFlight(4);
+    TEST_ASSERT(defWO._maxInFlight == 4);
+    c.setWriteOptions(defWO);
+    TEST_ASSERT(c._writeOptions._maxInFlight == 4);
+    defWO = WriteOptions().maxInFlight(0);
+    TEST_ASSERT(defWO._maxInFlight == 1);
+    defWO = WriteOptions().retryBackoff(3, true);
+    TEST_ASSERT(defWO._retryMultiplier == 3);
+    TEST_ASSERT(defWO._retryJitter);
+    defWO = WriteOptions().retryBackoff(0);
+    TEST_ASSERT(defWO._retryMultiplier == 0);
+    TEST_ASSERT(!defWO._retryJitter);
+    defWO = WriteOptions().adaptiveBatchSize(5, 300);
+    TEST_ASSERT(defWO._minBatchSize == 5);
+    TEST_ASSERT(defWO._targetRtt == 300);
+    defWO = WriteOptions().overflowPolicy(OverflowPolicy::Decimate);
+    TEST_ASSERT(defWO._overflowPolicy == OverflowPolicy::Decimate);
+    c.setWriteOptions(defWO);
+    TEST_ASSERT(c._writeOptions._overflowPolicy == OverflowPolicy::Decimate);
+    defWO = WriteOptions().sendOnChange(0.5, 0.01, 60, 32);
+    TEST_ASSERT(defWO._deadbandAbsolute == 0.5);
+    TEST_ASSERT(defWO._deadbandRelative == 0.01f);
+    TEST_ASSERT(defWO._heartbeatInterval == 60);
+    TEST_ASSERT(defWO._changeFilterSize == 32);
+    c.setWriteOptions(defWO);
+    TEST_ASSERT(c._writeOptions._changeFilterSize == 32);
+
     defWO = WriteOptions().batchSize(10).bufferSize(7000);
     c.setWriteOptions(defWO);
     TEST_ASSERTM(c._writeBufferSize == 255, String(c._writeBufferSize));
@@ -388,20 +516,26 @@ void Test::testBatch() {
     InfluxDBClient::Batch batch(2);
     TEST_ASSERT(batch._size == 2);
     TEST_ASSERT(batch.pointer == 0);
-    TEST_ASSERT(!batch.buffer[0]);
     TEST_ASSERT(batch.isEmpty());
     TEST_ASSERT(!batch.isFull());
     const char *line = "air,location=Zdiby,sensor=STH31 temp=22.1,hum=44";
-    TEST_ASSERT(!batch.append(line));
+    int len = strlen(line);
+    // lines are stored back-to-back in the write buffer memory
+    char *data = new char[2*len+2];
+    strcpy(data, line);
+    strcpy(data+len+1, line);
+    TEST_ASSERT(!batch.append(0, len));
     TEST_ASSERT(!batch.isEmpty());
     TEST_ASSERT(!batch.isFull());
-    TEST_ASSERT(batch.append(line));
+    TEST_ASSERT(batch.append(len+1, len));
     TEST_ASSERT(!batch.isEmpty());
     TEST_ASSERT(batch.isFull());
     TEST_ASSERT(batch.pointer == 2);
+    TEST_ASSERT(batch.length == 2*len);
+    TEST_ASSERT(batch.dataLength() == 2*len+2);
+    TEST_ASSERT(!strcmp(batch.line(data, 1), line));
 
-    InfluxDBClient::BatchStreamer str(&batch);
-    int len = strlen(line);
+    InfluxDBClient::BatchStreamer str(&batch, data);
     TEST_ASSERT(str.available() == len*2+2);
     int size = str.available()+1;
     char *buff = new char[size];
@@ -437,10 +571,605 @@ void Test::testBatch() {
     TEST_ASSERT(s->readBytes(buff+2*len+1, 1) == 1);
     TEST_ASSERT(s->available() == 0);
 
+    // read in blocks not aligned with lines
+    str.reset();
+    memset(buff, 0, size);
+    for(int r = 0, n = 1; n > 0; r += n) {
+        n = str.readBytes(buff + r, 7);
+        TEST_ASSERT(str.available() == size - 1 - r - n);
+    }
+    TEST_ASSERT(str.available() == 0);
+
+    char *body = batch.createData(data);
+    TEST_ASSERT(!strncmp(body, buff, 2*len+2));
+    TEST_ASSERT(strlen(body) == 2*len+2);
+    delete [] body;
+
+    batch.clear();
+    TEST_ASSERT(batch.isEmpty());
+    TEST_ASSERT(batch.pointer == 0);
+    TEST_ASSERT(batch.length == 0);
+
+    delete [] data;
     delete [] buff;
     TEST_END();
 }
 
+void Test::testWriteBuffer() {
+    TEST_INIT("testWriteBuffer");
+    // Unconfigured client cannot write, so full batches are dropped immediately
+    InfluxDBClient client;
+    client.setWriteOptions(WriteOptions().batchSize(3).bufferSize(6).flushInterval(0));
+    char line[100];
+    uint32_t size = 0;
+    for(int i=0;i<100;i++) {
+        sprintf(line, "test,tag=%.*s index=%di", i%5*10, "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx", i);
+        client.writeRecord(line);
+        InfluxDBClient::Batch *batch = client._writeBuffer[client._bufferPointer];
+        if(i%3 < 2) {
+            TEST_ASSERTM(batch->pointer == i%3+1, String(i) + ": " + batch->pointer);
+            TEST_ASSERTM(!strcmp(batch->line(client._lineBuffer, i%3), line), batch->line(client._lineBuffer, i%3));
+        } else {
+            TEST_ASSERTM(client.isBufferEmpty(), String(i));
+        }
+        TEST_ASSERT(client._lineBufferHead <= client._lineBufferSize);
+        if(i == 50) {
+            size = client._lineBufferSize;
+        }
+    }
+    // memory is reused once allocated
+    TEST_ASSERTM(client._lineBufferSize == size, String(client._lineBufferSize) + " vs " + size);
+    client.resetBuffer();
+    TEST_ASSERT(!client._lineBuffer);
+    TEST_ASSERT(client.isBufferEmpty());
+    TEST_END();
+}
+
+#if defined(ESP8266)
+# define MAX_ALLOC_HEAP() ESP.getMaxFreeBlockSize()
+#elif defined(ESP32)
+# define MAX_ALLOC_HEAP() ESP.getMaxAllocHeap()
+#endif
+
+void Test::testBatchPerformance() {
+    TEST_INIT("testBatchPerformance");
+    const char *line = "air,location=Zdiby,sensor=STH31 temp=22.1,hum=44";
+    uint32_t len = strlen(line);
+    uint16_t sizes[] = { 10, 100, 500, 1000, 2000, 5000 };
+    for(uint16_t size : sizes) {
+        uint32_t dataSize = size*(len+1)+1;
+        // created data and data created the original way must fit into memory
+        if(size*sizeof(InfluxDBClient::Line) + 2*dataSize > MAX_ALLOC_HEAP()) {
+            Serial.printf("  %4d lines: skipped, not enough memory\n", size);
+            continue;
+        }
+        InfluxDBClient::Batch batch(size);
+        for(int i=0;i<size;i++) {
+            // all lines can point to the same data
+            batch.append(0, len);
+        }
+        uint32_t start = micros();
+        char *data = batch.createData(line);
+        uint32_t took = micros() - start;
+        TEST_ASSERT(data);
+        // original way, rescanning the data for each line
+        start = micros();
+        char *ref = new char[dataSize];
+        ref[0] = 0;
+        for(int i=0;i<size;i++) {
+            strcat(ref+strlen(ref), line);
+            strcat(ref+strlen(ref), "\n");
+        }
+        uint32_t tookRef = micros() - start;
+        TEST_ASSERT(strlen(data) == dataSize - 1);
+        TEST_ASSERT(!strcmp(data, ref));
+        // stream write, reading in blocks like WiFi client does
+        InfluxDBClient::BatchStreamer str(&batch, line);
+        char block[1460];
+        start = micros();
+        char *d = ref;
+        for(int n = 1; n > 0; d += n) {
+            n = str.readBytes(block, sizeof(block));
+            memcpy(d, block, n);
+        }
+        uint32_t tookStream = micros() - start;
+        TEST_ASSERT(d - ref == (int)dataSize - 1);
+        TEST_ASSERT(!strncmp(data, ref, dataSize - 1));
+        Serial.printf("  %4d lines: createData %7uus, strcat %7uus, stream %7uus\n", size, took, tookRef, tookStream);
+        delete [] data;
+        delete [] ref;
+    }
+    TEST_END();
+}
+
+void Test::testGzipStream() {
+    TEST_INIT("testGzipStream");
+    const int lines = 100;
+    InfluxDBClient::Batch batch(lines);
+    char *data = new char[lines*60];
+    uint32_t offset = 0;
+    for(int i = 0; i < lines; i++) {
+        int len = sprintf(data + offset, "air,location=Zdiby,sensor=STH%d temp=%d.%d,hum=%di", i%3, 20 + i%7, i%10, 40 + i%13);
+        batch.append(offset, len);
+        offset += len + 1;
+    }
+    uint32_t inSize = batch.dataLength();
+    InfluxDBClient::BatchStreamer bs(&batch, data);
+    GzipStream gz(&bs, 512);
+    uint32_t size = gz.compress(inSize);
+    TEST_ASSERTM(gz.getInputSize() == inSize, String(gz.getInputSize()));
+    // line protocol with repeating keys compresses well
+    TEST_ASSERTM(size > 18 && size < inSize/4, String(size) + " of " + String(inSize));
+    // compressed once, source is not read again
+    TEST_ASSERT(bs.available() == 0);
+    TEST_ASSERTM(gz.available() == (int)size, String(gz.available()));
+    uint8_t *out = new uint8_t[size + 10];
+    // read in odd sized blocks
+    uint32_t read = 0, r;
+    while((r = gz.readBytes((char *)out + read, 7)) > 0) {
+        read += r;
+    }
+    TEST_ASSERTM(read == size, String(read));
+    TEST_ASSERT(gz.available() == 0);
+    TEST_ASSERT(gz.read() == -1);
+    // header: magic, deflate method
+    TEST_ASSERT(out[0] == 0x1f && out[1] == 0x8b && out[2] == 8);
+    // trailer ends with input size
+    uint32_t isize = out[size-4] | (out[size-3] << 8) | (out[size-2] << 16) | ((uint32_t)out[size-1] << 24);
+    TEST_ASSERTM(isize == inSize, String(isize));
+    // reset rewinds compressed data, byte-by-byte reading gives the same output
+    gz.reset();
+    TEST_ASSERT(gz.peek() == 0x1f);
+    int c;
+    uint32_t i = 0;
+    bool same = true;
+    while((c = gz.read()) >= 0) {
+        same = same && i < size && out[i] == c;
+        i++;
+    }
+    TEST_ASSERT(same);
+    TEST_ASSERTM(i == size, String(i));
+    // streaming without compress() gives the same output
+    bs.reset();
+    GzipStream streamed(&bs, 512);
+    i = 0;
+    same = true;
+    while((c = streamed.read()) >= 0) {
+        same = same && i < size && out[i] == c;
+        i++;
+    }
+    TEST_ASSERT(same);
+    TEST_ASSERTM(i == size, String(i));
+    // data which would be longer than the limit are not kept
+    bs.reset();
+    GzipStream limited(&bs, 512);
+    TEST_ASSERT(limited.compress(size - 1) == 0);
+    delete [] out;
+    delete [] data;
+
+    // typical line protocol: few series with timestamps and changing values, default window
+    InfluxDBClient::Batch typical(lines);
+    data = new char[lines*120];
+    offset = 0;
+    for(int i = 0; i < lines; i++) {
+        int len = sprintf(data + offset, "environment,device=esp32-%02d,location=greenhouse temperature=%d.%02d,humidity=%d.%d,rssi=-%di %lu", 
+            i%4, 18 + (i*7)%9, (i*37)%100, 40 + (i*13)%20, (i*3)%10, 50 + (i*11)%30, 1700000000UL + i*10);
+        typical.append(offset, len);
+        offset += len + 1;
+    }
+    inSize = typical.dataLength();
+    InfluxDBClient::BatchStreamer tbs(&typical, data);
+    GzipStream tgz(&tbs);
+    size = tgz.compress(inSize);
+    Serial.printf("  Gzip ratio of typical line protocol: %u -> %u bytes, %.1fx\n", inSize, size, (float)inSize/size);
+    TEST_ASSERTM(size > 0 && size*4 < inSize, String(size) + " of " + String(inSize));
+    delete [] data;
+    TEST_END();
+}
+
+// 40 lines of testGunzipStream, compressed by zlib at level 9 into a dynamic Huffman block
+static const uint8_t gzipLines[] PROGMEM = {
+    0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0x8d,0x94,0x31,0x4e,0x03,0x41,
+    0x0c,0x45,0x7b,0x4e,0xc1,0x01,0x56,0xd6,0x8c,0xc7,0x9e,0x99,0x2d,0xb6,0x4f,0x0f,
+    0x15,0xdd,0x02,0x91,0x58,0x89,0x64,0x51,0x12,0x0a,0x6e,0x4f,0xe1,0x31,0xee,0xc8,
+    0x3f,0xc0,0x97,0x9e,0xe4,0xe7,0xb7,0x6e,0x97,0xe9,0x73,0x7f,0x5b,0x6f,0xdb,0x7e,
+    0x5e,0x5e,0xde,0xb7,0xd7,0x9f,0xe9,0x7a,0x3c,0x5f,0xf7,0xcb,0xf2,0xf4,0x7c,0x48,
+    0x8f,0xb7,0xe3,0xe9,0x6b,0xe1,0x44,0x69,0xfa,0xf8,0x3e,0x2d,0x92,0xb6,0x87,0xf5,
+    0xbf,0x41,0x1e,0x83,0x4c,0xd9,0x06,0xf9,0xce,0x80,0xc7,0x80,0x89,0x6d,0xc0,0x77,
+    0x06,0x8e,0x54,0xa8,0xd8,0xa0,0x80,0x48,0x42,0x62,0x03,0x01,0x91,0x94,0xd4,0x06,
+    0x0a,0x22,0x55,0xaa,0x36,0xa8,0x20,0x52,0xa2,0x66,0x83,0x06,0x22,0x65,0xea,0x36,
+    0xe8,0x20,0x12,0xd3,0x6c,0x83,0x19,0x44,0x2a,0xe3,0xd2,0x9a,0x40,0x24,0x19,0x97,
+    0xd6,0x0c,0x22,0xe9,0xb8,0xb4,0x32,0x88,0x54,0xfd,0xd2,0x28,0x52,0xf2,0x4b,0xa3,
+    0x48,0xd9,0x2f,0x8d,0x22,0xb1,0x5f,0xba,0x80,0x48,0xc5,0x2f,0x2d,0x20,0x92,0xf8,
+    0xa5,0x15,0x44,0x52,0xbf,0x74,0x05,0x91,0xaa,0xff,0x74,0x03,0x91,0x92,0xff,0x74,
+    0x87,0x23,0xc0,0x98,0x7c,0x11,0x81,0x82,0xc9,0x17,0x11,0x10,0x4c,0xbe,0x88,0x80,
+    0x62,0xf2,0x45,0x04,0x2a,0x26,0x5f,0x44,0xa0,0x61,0xf2,0x45,0x04,0x3a,0x26,0x5f,
+    0x44,0x60,0xc6,0xe4,0x8b,0x08,0x24,0x4c,0xbe,0x88,0x40,0xc6,0xe4,0x8b,0x08,0x30,
+    0x26,0x5f,0x44,0xa0,0x60,0xf2,0x45,0x04,0x04,0x93,0x2f,0x22,0xa0,0x98,0x7c,0x11,
+    0x81,0x8a,0xc9,0x17,0x11,0x68,0x98,0x7c,0x11,0x81,0x8e,0xc9,0x17,0x11,0x98,0xff,
+    0xe4,0xfb,0x05,0xb2,0xb2,0xca,0xb5,0xa8,0x07,0x00,0x00
+};
+
+void Test::testGunzipStream() {
+    TEST_INIT("testGunzipStream");
+    const int lines = 100;
+    InfluxDBClient::Batch batch(lines);
+    char *data = new char[lines*60];
+    uint32_t offset = 0;
+    for(int i = 0; i < lines; i++) {
+        int len = sprintf(data + offset, "air,location=Zdiby,sensor=STH%d temp=%d.%d,hum=%di", i%3, 20 + i%7, i%10, 40 + i%13);
+        batch.append(offset, len);
+        offset += len + 1;
+    }
+    uint32_t inSize = batch.dataLength();
+    char *out = new char[inSize + 10];
+    // round trip of own compression
+    InfluxDBClient::BatchStreamer bs(&batch, data);
+    GzipStream gz(&bs, 512);
+    GunzipStream gunzip(&gz, 512);
+    uint32_t read = 0, r;
+    while((r = gunzip.readBytes(out + read, 13)) > 0) {
+        read += r;
+    }
+    TEST_ASSERTM(gunzip.getError() == GunzipError::None, String((int)gunzip.getError()));
+    TEST_ASSERT(gunzip.isFinished());
+    TEST_ASSERTM(read == inSize, String(read));
+    bool same = true;
+    for(int i = 0, o = 0; i < lines; i++) {
+        uint16_t len = batch.lines[i].length;
+        same = same && memcmp(out + o, data + batch.lines[i].offset, len) == 0 && out[o + len] == '\n';
+        o += len + 1;
+    }
+    TEST_ASSERT(same);
+    TEST_ASSERT(gunzip.read() == -1);
+
+    // zlib output, decompressed byte by byte
+    uint8_t *gzipData = new uint8_t[sizeof(gzipLines)];
+    memcpy_P(gzipData, gzipLines, sizeof(gzipLines));
+    MemoryStream ms(gzipData, sizeof(gzipLines));
+    GunzipStream gunzip2(&ms);
+    int c;
+    read = 0;
+    while((c = gunzip2.read()) >= 0) {
+        // lines in data are separated by \0
+        same = same && read < inSize && c == (data[read] ? data[read] : '\n');
+        read++;
+    }
+    TEST_ASSERTM(gunzip2.getError() == GunzipError::None, String((int)gunzip2.getError()));
+    TEST_ASSERT(same);
+    TEST_ASSERTM(read == 1960, String(read));
+
+    // corrupted CRC
+    gzipData[sizeof(gzipLines) - 6] ^= 0x55;
+    MemoryStream ms3(gzipData, sizeof(gzipLines));
+    GunzipStream gunzip3(&ms3);
+    while(gunzip3.readBytes(out, 64) > 0);
+    TEST_ASSERTM(gunzip3.getError() == GunzipError::InvalidData, String((int)gunzip3.getError()));
+    TEST_ASSERT(!gunzip3.isFinished());
+
+    // truncated data
+    MemoryStream ms4(gzipData, sizeof(gzipLines)/2);
+    GunzipStream gunzip4(&ms4);
+    while(gunzip4.readBytes(out, 64) > 0);
+    TEST_ASSERTM(gunzip4.getError() == GunzipError::UnexpectedEnd, String((int)gunzip4.getError()));
+
+    // back references more than 8KB back need the default window
+    const uint32_t segment = 9000;
+    const char *marker = "0123456789ABCDEF";
+    uint8_t *repeated = new uint8_t[2*segment];
+    memset(repeated, 'z', 2*segment);
+    // marker is repeated after 9000 bytes, runs of z refer just one byte back
+    memcpy(repeated, marker, 16);
+    memcpy(repeated + segment, marker, 16);
+    MemoryStream msFar(repeated, 2*segment);
+    GzipStream gzFar(&msFar, 16384);
+    GunzipStream gunzipFar(&gzFar);
+    read = 0;
+    same = true;
+    while((c = gunzipFar.read()) >= 0) {
+        same = same && read < 2*segment && c == repeated[read];
+        read++;
+    }
+    TEST_ASSERTM(gunzipFar.getError() == GunzipError::None, String((int)gunzipFar.getError()));
+    TEST_ASSERT(same);
+    TEST_ASSERTM(read == 2*segment, String(read));
+    MemoryStream msNear(repeated, 2*segment);
+    GzipStream gzNear(&msNear, 16384);
+    GunzipStream gunzipNear(&gzNear, 8192);
+    while(gunzipNear.read() >= 0);
+    TEST_ASSERTM(gunzipNear.getError() == GunzipError::WindowTooSmall, String((int)gunzipNear.getError()));
+    delete [] repeated;
+
+    delete [] gzipData;
+    delete [] out;
+    delete [] data;
+    TEST_END();
+}
+
+void Test::testLineQueue() {
+    TEST_INIT("testLineQueue");
+    // rounded down to 32
+    LineQueue queue(42);
+    TEST_ASSERT(queue.isValid());
+    TEST_ASSERT(queue.isEmpty());
+    TEST_ASSERT(queue.frontLength() == -1);
+    char buff[32];
+    // each line takes 4 bytes of length + data aligned to 4 bytes
+    TEST_ASSERT(queue.push("line1", 5));
+    TEST_ASSERT(queue.push("line-2", 6));
+    TEST_ASSERT(!queue.isEmpty());
+    // 8 bytes free
+    TEST_ASSERT(!queue.push("123456789", 9));
+    TEST_ASSERT(queue.getDropped() == 1);
+    TEST_ASSERT(queue.frontLength() == 5);
+    queue.pop(buff);
+    TEST_ASSERT(!strncmp(buff, "line1", 5));
+    // line wraps around the end
+    TEST_ASSERT(queue.push("12345678", 8));
+    TEST_ASSERT(queue.frontLength() == 6);
+    queue.pop(buff);
+    TEST_ASSERT(!strncmp(buff, "line-2", 6));
+    TEST_ASSERT(queue.frontLength() == 8);
+    queue.pop(buff);
+    TEST_ASSERT(!strncmp(buff, "12345678", 8));
+    TEST_ASSERT(queue.isEmpty());
+    // whole ring can be used
+    for(int i = 0; i < 4; i++) {
+        TEST_ASSERT(queue.push("full", 4));
+    }
+    TEST_ASSERT(!queue.push("", 0));
+    TEST_ASSERT(queue.getDropped() == 2);
+    while(queue.frontLength() == 4) {
+        queue.pop(buff);
+        TEST_ASSERT(!strncmp(buff, "full", 4));
+    }
+    TEST_ASSERT(queue.isEmpty());
+    // empty line
+    TEST_ASSERT(queue.push("", 0));
+    TEST_ASSERT(queue.frontLength() == 0);
+    queue.pop(buff);
+    TEST_ASSERT(queue.isEmpty());
+    // line can be removed without copying
+    TEST_ASSERT(queue.push("skipped", 7));
+    TEST_ASSERT(queue.push("next", 4));
+    queue.pop(nullptr);
+    TEST_ASSERT(queue.frontLength() == 4);
+    queue.pop(buff);
+    TEST_ASSERT(!strncmp(buff, "next", 4));
+    TEST_ASSERT(queue.isEmpty());
+    // positions wrap at 2^32
+    queue._head = queue._tail = 0xFFFFFFF4;
+    TEST_ASSERT(queue.push("line1", 5));
+    TEST_ASSERT(queue.push("line-2", 6));
+    TEST_ASSERT(!queue.push("123456789", 9));
+    TEST_ASSERT(queue._head.load() == 12);
+    queue.pop(buff);
+    TEST_ASSERT(!strncmp(buff, "line1", 5));
+    queue.pop(buff);
+    TEST_ASSERT(!strncmp(buff, "line-2", 6));
+    TEST_ASSERT(queue.isEmpty());
+    TEST_ASSERT(queue.getDropped() == 3);
+    TEST_END();
+}
+
+void Test::testLineQueueProducers() {
+    TEST_INIT("testLineQueueProducers");
+#if defined(ESP8266)
+    Serial.println("  skipped, no threads");
+#else
+    const int producers = 8;
+    const int count = 20000;
+    // small queue goes around often, positions start just before they wrap at 2^32
+    LineQueue queue(256);
+    queue._head = queue._tail = 0xFFFFF000;
+    std::vector<std::thread> threads;
+    uint32_t start = millis();
+    for(int p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, p]() {
+            char line[40];
+            for(int i = 0; i < count; i++) {
+                // varying length
+                int len = sprintf(line, "%d:%d:%.*s", p, i, i % 13, "xxxxxxxxxxxxx");
+                while(!queue.push(line, len, p)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    // consumer
+    int next[producers] = { 0 };
+    int received = 0, errors = 0;
+    char line[41];
+    while(received < producers*count && errors == 0) {
+        int32_t len = queue.frontLength();
+        if(len < 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        uint8_t tag = queue.frontTag();
+        queue.pop(line);
+        line[len] = 0;
+        int p = -1, index = -1;
+        char expected[41];
+        if(sscanf(line, "%d:%d:", &p, &index) != 2 || p != tag || p < 0 || p >= producers || index != next[p]) {
+            errors++;
+            break;
+        }
+        sprintf(expected, "%d:%d:%.*s", p, index, index % 13, "xxxxxxxxxxxxx");
+        if(strcmp(line, expected)) {
+            errors++;
+            break;
+        }
+        next[p]++;
+        received++;
+    }
+    TEST_ASSERTM(errors == 0, line);
+    for(std::thread &t : threads) {
+        t.join();
+    }
+    uint32_t took = millis() - start;
+    TEST_ASSERTM(received == producers*count, String(received));
+    TEST_ASSERT(queue.isEmpty());
+    // ring went around the 2^32 boundary
+    TEST_ASSERT(queue._tail.load() < 0xFFFFF000);
+    Serial.printf("  %d producers, %d lines each: %ums, queue full %u times\n", producers, count, took, queue.getDropped());
+#endif
+    TEST_END();
+}
+
+void Test::testConcurrentWrites() {
+    TEST_INIT("testConcurrentWrites");
+#if defined(ESP8266)
+    Serial.println("  skipped, writer task is not supported");
+#else
+    const int producers = 4;
+    const int count = 1000;
+    // nothing is flushed, all lines stay in a single batch
+    InfluxDBClient client;
+    client.setWriteOptions(WriteOptions().batchSize(producers*count).bufferSize(2*producers*count).flushInterval(0));
+    // small queue, so producers often find it full
+    TEST_ASSERTM(client.startWriterTask(512, 1), client.getLastErrorMessage());
+    std::atomic<uint32_t> retries(0);
+    std::vector<std::thread> threads;
+    uint32_t start = millis();
+    for(int p = 0; p < producers; p++) {
+        threads.emplace_back([&client, &retries, p]() {
+            char line[50];
+            for(int i = 0; i < count; i++) {
+                sprintf(line, "test,producer=%d index=%di", p, i);
+                while(!client.writeRecord(line)) {
+                    retries++;
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for(std::thread &t : threads) {
+        t.join();
+    }
+    uint32_t took = millis() - start;
+    TEST_ASSERTM(client.getWriterQueueDropped() == retries.load(), String(client.getWriterQueueDropped()));
+    client.stopWriterTask();
+    InfluxDBClient::Batch *batch = client._writeBuffer[0];
+    TEST_ASSERT(batch);
+    TEST_ASSERTM(batch->pointer == producers*count, String(batch->pointer));
+    // lines of each producer are all there, once and in order
+    int next[producers] = { 0 };
+    for(int i = 0; i < batch->pointer; i++) {
+        int p = -1, index = -1;
+        TEST_ASSERTM(sscanf(batch->line(client._lineBuffer, i), "test,producer=%d index=%di", &p, &index) == 2, batch->line(client._lineBuffer, i));
+        TEST_ASSERTM(p >= 0 && p < producers, String(p));
+        TEST_ASSERTM(index == next[p], String(p) + ": " + String(index) + " != " + String(next[p]));
+        next[p]++;
+    }
+    for(int p = 0; p < producers; p++) {
+        TEST_ASSERTM(next[p] == count, String(next[p]));
+    }
+    Serial.printf("  %d producers, %d lines each: %ums, queue full %u times\n", producers, count, took, retries.load());
+
+    // buckets are added before the task is started
+    InfluxDBClient bucketClient;
+    bucketClient.setWriteOptions(WriteOptions().batchSize(100).bufferSize(200).flushInterval(0));
+    TEST_ASSERT(bucketClient.addBucket("debug"));
+    TEST_ASSERTM(bucketClient.startWriterTask(512, 1), bucketClient.getLastErrorMessage());
+    threads.clear();
+    for(int p = 0; p < producers; p++) {
+        threads.emplace_back([&bucketClient, p]() {
+            char line[50];
+            for(int i = 0; i < 10; i++) {
+                sprintf(line, "test,producer=%d index=%di", p, i);
+                while(!bucketClient.writeRecord(line, "debug")) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for(std::thread &t : threads) {
+        t.join();
+    }
+    // new bucket or route is refused while the task runs
+    TEST_ASSERT(!bucketClient.writeRecord("test,producer=0 index=10i", "other"));
+    TEST_ASSERT(!bucketClient.routeMeasurement("test", "debug"));
+    bucketClient.stopWriterTask();
+    TEST_ASSERTM(bucketClient._bucketRoutesCount == 1, String(bucketClient._bucketRoutesCount));
+    int16_t index = bucketClient.getLaneBatch(WritePriority::Normal, 1);
+    TEST_ASSERT(index >= 0);
+    TEST_ASSERTM(bucketClient._writeBuffer[index]->pointer == producers*10, String(bucketClient._writeBuffer[index]->pointer));
+    TEST_ASSERT(bucketClient.routeMeasurement("test", "other"));
+
+    // send-on-change filter is shared by producers
+    InfluxDBClient filterClient;
+    filterClient.setWriteOptions(WriteOptions().batchSize(1000).bufferSize(2000).flushInterval(0).sendOnChange(0.5));
+    TEST_ASSERT(filterClient._changeFilter);
+    TEST_ASSERTM(filterClient.startWriterTask(16384, 1), filterClient.getLastErrorMessage());
+    threads.clear();
+    for(int p = 0; p < producers; p++) {
+        threads.emplace_back([&filterClient, p]() {
+            Point point("test");
+            point.addTag("producer", String(p));
+            for(int i = 0; i < 100; i++) {
+                point.clearFields();
+                // each value is repeated once
+                point.addField("value", i/2);
+                filterClient.writePoint(point);
+            }
+        });
+    }
+    for(std::thread &t : threads) {
+        t.join();
+    }
+    filterClient.stopWriterTask();
+    TEST_ASSERTM(filterClient.getWriterQueueDropped() == 0, String(filterClient.getWriterQueueDropped()));
+    TEST_ASSERTM(filterClient.getSuppressedPoints() == producers*50, String(filterClient.getSuppressedPoints()));
+    TEST_ASSERTM(filterClient._writeBuffer[0]->pointer == producers*50, String(filterClient._writeBuffer[0]->pointer));
+
+    // aggregated series is written by producers and windows are closed by poll
+    InfluxDBClient aggregateClient;
+    aggregateClient.setWriteOptions(WriteOptions().batchSize(1000).bufferSize(2000).flushInterval(0));
+    Point series("test");
+    series.addTag("tag", "a");
+    TEST_ASSERT(aggregateClient.aggregateSeries(series, 2, AggregateFunction::Count));
+    TEST_ASSERTM(aggregateClient.startWriterTask(16384, 1), aggregateClient.getLastErrorMessage());
+    TEST_ASSERT(!aggregateClient.aggregateSeries(series, 0));
+    std::atomic<bool> writing(true);
+    std::thread poller([&aggregateClient, &writing]() {
+        while(writing.load()) {
+            aggregateClient.poll();
+        }
+    });
+    threads.clear();
+    for(int p = 0; p < producers; p++) {
+        threads.emplace_back([&aggregateClient]() {
+            Point point("test");
+            point.addTag("tag", "a");
+            for(int i = 0; i < count; i++) {
+                point.clearFields();
+                point.addField("value", i);
+                aggregateClient.writePoint(point);
+            }
+        });
+    }
+    for(std::thread &t : threads) {
+        t.join();
+    }
+    writing = false;
+    poller.join();
+    aggregateClient.stopWriterTask();
+    TEST_ASSERT(aggregateClient.aggregateSeries(series, 0));
+    TEST_ASSERTM(aggregateClient.getWriterQueueDropped() == 0, String(aggregateClient.getWriterQueueDropped()));
+    // all points are counted in windows
+    InfluxDBClient::Batch *aggregated = aggregateClient._writeBuffer[0];
+    int total = 0;
+    for(int i = 0; i < aggregated->pointer; i++) {
+        int points = 0;
+        TEST_ASSERTM(sscanf(aggregated->line(aggregateClient._lineBuffer, i), "test,tag=a value_count=%di", &points) == 1, aggregated->line(aggregateClient._lineBuffer, i));
+        total += points;
+    }
+    TEST_ASSERTM(total == producers*count, String(total));
+#endif
+    TEST_END();
+}
+
 void Test::testLineProtocol() {
     TEST_INIT("testLineProtocol");
 
@@ -801,14 +1530,14 @@ void Test::testRetryOnFailedConnection() {
     Serial.println("Stop server!");
     waitServer(Test::managementUrl, false);
     TEST_ASSERT(!clientOk.validateConnection());
-    TEST_ASSERTM(clientOk._retryTime == 0, String(clientOk._retryTime));
+    TEST_ASSERTM(clientOk._retryDelay == 0, String(clientOk._retryDelay));
     p = createPoint("test1");
     TEST_ASSERT(!clientOk.writePoint(*p));
-    TEST_ASSERTM(clientOk._retryTime == 0, String(clientOk._retryTime));
+    TEST_ASSERTM(clientOk._retryDelay == 0, String(clientOk._retryDelay));
     delete p;
     p = createPoint("test1");
     TEST_ASSERT(!clientOk.writePoint(*p));
-    TEST_ASSERTM(clientOk._retryTime == 0, String(clientOk._retryTime));
+    TEST_ASSERTM(clientOk._retryDelay == 0, String(clientOk._retryDelay));
     delete p;
 
     Serial.println("Start server!");
@@ -817,7 +1546,7 @@ void Test::testRetryOnFailedConnection() {
     TEST_ASSERT(clientOk.validateConnection());
     p = createPoint("test1");
     TEST_ASSERT(clientOk.writePoint(*p));
-    TEST_ASSERTM(clientOk._retryTime == 0, String(clientOk._retryTime));
+    TEST_ASSERTM(clientOk._retryDelay == 0, String(clientOk._retryDelay));
     delete p;
     TEST_ASSERT(clientOk.isBufferEmpty());
     String query = "select";
@@ -917,7 +1646,7 @@ void Test::testBufferOverwriteBatchsize1() {
         delete p;
     }
     TEST_ASSERT(client.isBufferFull());
-    TEST_ASSERTM(strstr(client._writeBuffer[0]->buffer[0], "index=10i"), client._writeBuffer[0]->buffer[0]);
+    TEST_ASSERTM(strstr(client._writeBuffer[0]->line(client._lineBuffer, 0), "index=10i"), client._writeBuffer[0]->line(client._lineBuffer, 0));
 
     setServerUrl(client,Test::apiUrl );
     
@@ -958,7 +1687,7 @@ void Test::testBufferOverwriteBatchsize5() {
         delete p;
     }
     TEST_ASSERT(client.isBufferFull());
-    TEST_ASSERTM(strstr(client._writeBuffer[0]->buffer[0], "index=20i"), client._writeBuffer[0]->buffer[0]);
+    TEST_ASSERTM(strstr(client._writeBuffer[0]->line(client._lineBuffer, 0), "index=20i"), client._writeBuffer[0]->line(client._lineBuffer, 0));
 
     setServerUrl(client,Test::apiUrl );
 
@@ -1014,6 +1743,1158 @@ void Test::testBufferOverwriteBatchsize5() {
     deleteAll(Test::apiUrl);
 }
 
+void Test::testBufferBytes() {
+    TEST_INIT("testBufferBytes");
+    InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    client.setWriteOptions(WriteOptions().batchSize(5).bufferSize(100).bufferBytes(1000).bufferWatermarks(70, 30));
+    client.setHTTPOptions(HTTPOptions().httpReadTimeout(500));
+    int high = 0, low = 0;
+    client.setWatermarkCallback([&](bool above) {
+        if(above) {
+            high++;
+        } else {
+            low++;
+        }
+    });
+    TEST_ASSERT(!client.isAboveHighWatermark());
+    char line[60];
+    for (int i = 0; i < 40; i++) {
+        // 49 chars + terminating zero
+        sprintf(line, "test1,tag=xxxxxxxxxxxxxxxxxxxxxxxxxxxx index=%03di", i);
+        client.writeRecord(line);
+        TEST_ASSERTM(client._lineBufferSize == 1000, String(client._lineBufferSize));
+        TEST_ASSERTM(client.getLineBufferUsed() <= 1000, String(client.getLineBufferUsed()));
+        TEST_ASSERTM(client.getBufferUsage() == client.getLineBufferUsed()/10, String(client.getBufferUsage()));
+        TEST_ASSERTM(client.isAboveHighWatermark() == (i >= 13), String(i));
+    }
+    TEST_ASSERTM(high == 1 && low == 0, String(high) + "," + low);
+    // oldest points were dropped
+    TEST_ASSERTM(client._bufferedPoints <= 20 && client._bufferedPoints >= 15, String(client._bufferedPoints));
+    TEST_ASSERTM(client.getLineBufferUsed() == client._bufferedPoints*50, String(client.getLineBufferUsed()));
+    TEST_ASSERTM(strstr(client._writeBuffer[client._batchPointer]->line(client._lineBuffer, 0), "index=02"), client._writeBuffer[client._batchPointer]->line(client._lineBuffer, 0));
+    TEST_ASSERTM(!strcmp(client._writeBuffer[client._bufferPointer==0?client._writeBufferSize-1:client._bufferPointer-1]->line(client._lineBuffer, 4), line), line);
+
+    client.resetBuffer();
+    TEST_ASSERT(!client.isAboveHighWatermark());
+    TEST_ASSERTM(high == 1 && low == 1, String(high) + "," + low);
+    TEST_END();
+}
+
+void Test::testFlushBytes() {
+    TEST_INIT("testFlushBytes");
+    InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    client.setWriteOptions(WriteOptions().batchSize(10).bufferSize(100).flushBytes(220));
+    client.setHTTPOptions(HTTPOptions().httpReadTimeout(500));
+    TEST_ASSERT(client.getFlushBytes() == 220);
+    char line[310];
+    for (int i = 0; i < 8; i++) {
+        // 49 chars + new line
+        sprintf(line, "test1,tag=xxxxxxxxxxxxxxxxxxxxxxxxxxxx index=%03di", i);
+        client.writeRecord(line);
+    }
+    // 5th line would exceed 220 bytes
+    TEST_ASSERTM(client._writeBuffer[0]->pointer == 4, String(client._writeBuffer[0]->pointer));
+    TEST_ASSERTM(client._writeBuffer[0]->dataLength() == 200, String(client._writeBuffer[0]->dataLength()));
+    TEST_ASSERT(client._writeBuffer[0]->isFull());
+    TEST_ASSERTM(client._writeBuffer[1]->pointer == 4, String(client._writeBuffer[1]->pointer));
+    TEST_ASSERT(!client._writeBuffer[1]->isFull());
+    TEST_ASSERTM(client._bufferPointer == 1, String(client._bufferPointer));
+    // line longer than flush size goes to a batch alone
+    memset(line, 'x', 299);
+    memcpy(line, "test1 f=\"", 9);
+    strcpy(line + 298, "\"");
+    client.writeRecord(line);
+    TEST_ASSERT(client._writeBuffer[1]->isFull());
+    TEST_ASSERTM(client._writeBuffer[2]->pointer == 1, String(client._writeBuffer[2]->pointer));
+    TEST_ASSERT(client._writeBuffer[2]->isFull());
+    TEST_ASSERTM(client._bufferPointer == 3, String(client._bufferPointer));
+    TEST_ASSERTM(client._bufferedPoints == 9, String(client._bufferedPoints));
+    // closed batch is reused as a normal one
+    client._writeBuffer[0]->clear();
+    TEST_ASSERT(!client._writeBuffer[0]->isFull());
+
+    client.setWriteOptions(WriteOptions().flushBytes(3000, true));
+    TEST_ASSERTM(client.getFlushBytes() == 2*HTTPService::DefaultSendBlockSize, String(client.getFlushBytes()));
+    client.setWriteOptions(WriteOptions().flushBytes(1000, true));
+    TEST_ASSERTM(client.getFlushBytes() == 1000, String(client.getFlushBytes()));
+    client.setWriteOptions(WriteOptions().flushBytes(3000));
+    TEST_ASSERTM(client.getFlushBytes() == 3000, String(client.getFlushBytes()));
+    // compressed body doesn't follow the size of lines
+    client.setWriteOptions(WriteOptions().flushBytes(3000, true).compression(Compression::Gzip));
+    TEST_ASSERTM(client.getFlushBytes() == 3000, String(client.getFlushBytes()));
+    TEST_END();
+}
+
+void Test::testAdaptiveBatchSize() {
+    TEST_INIT("testAdaptiveBatchSize");
+    InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    client.setWriteOptions(WriteOptions().batchSize(20).bufferSize(200).adaptiveBatchSize(4, 500));
+    // starts at the max
+    TEST_ASSERTM(client.getBatchSize() == 20, String(client.getBatchSize()));
+    client.adaptBatchSize(204, 100);
+    TEST_ASSERTM(client.getBatchSize() == 20, String(client.getBatchSize()));
+    // slow write
+    client.adaptBatchSize(204, 600);
+    TEST_ASSERTM(client.getBatchSize() == 10, String(client.getBatchSize()));
+    // overloaded server
+    client.adaptBatchSize(429, 100);
+    TEST_ASSERTM(client.getBatchSize() == 5, String(client.getBatchSize()));
+    // network failure, not under the min
+    client.adaptBatchSize(-1, 0);
+    TEST_ASSERTM(client.getBatchSize() == 4, String(client.getBatchSize()));
+    // client error doesn't say anything about latency
+    client.adaptBatchSize(400, 100);
+    TEST_ASSERTM(client.getBatchSize() == 4, String(client.getBatchSize()));
+    // grows by 1/16 of the range
+    client.adaptBatchSize(204, 100);
+    client.adaptBatchSize(204, 500);
+    TEST_ASSERTM(client.getBatchSize() == 6, String(client.getBatchSize()));
+
+    char line[50];
+    for (int i = 0; i < 8; i++) {
+        sprintf(line, "test1,tag=a index=%03di", i);
+        TEST_ASSERT(client.bufferRecord(line, strlen(line)));
+    }
+    TEST_ASSERTM(client._writeBuffer[0]->pointer == 6, String(client._writeBuffer[0]->pointer));
+    TEST_ASSERT(client._writeBuffer[0]->isFull());
+    TEST_ASSERTM(client._writeBuffer[1]->pointer == 2, String(client._writeBuffer[1]->pointer));
+    TEST_ASSERT(!client._writeBuffer[1]->isFull());
+    TEST_ASSERTM(client._bufferPointer == 1, String(client._bufferPointer));
+    // shrinking closes the current batch early, points are kept
+    client.adaptBatchSize(503, 100);
+    TEST_ASSERTM(client.getBatchSize() == 4, String(client.getBatchSize()));
+    for (int i = 8; i < 11; i++) {
+        sprintf(line, "test1,tag=a index=%03di", i);
+        TEST_ASSERT(client.bufferRecord(line, strlen(line)));
+    }
+    TEST_ASSERTM(client._writeBuffer[1]->pointer == 4, String(client._writeBuffer[1]->pointer));
+    TEST_ASSERT(client._writeBuffer[1]->isFull());
+    TEST_ASSERTM(client._writeBuffer[2]->pointer == 1, String(client._writeBuffer[2]->pointer));
+    TEST_ASSERTM(client._bufferPointer == 2, String(client._bufferPointer));
+    TEST_ASSERTM(client._bufferedPoints == 11, String(client._bufferedPoints));
+    // slow write doesn't shrink batch, when more full batches are waiting
+    client.adaptBatchSize(204, 100);
+    client.adaptBatchSize(204, 600);
+    TEST_ASSERTM(client.getBatchSize() == 5, String(client.getBatchSize()));
+
+    // min is limited by batch size
+    client.setWriteOptions(WriteOptions().batchSize(20).bufferSize(200).adaptiveBatchSize(50));
+    TEST_ASSERTM(client._writeOptions._minBatchSize == 20, String(client._writeOptions._minBatchSize));
+    TEST_ASSERTM(client.getBatchSize() == 20, String(client.getBatchSize()));
+    // disabled
+    client.setWriteOptions(WriteOptions().batchSize(20).bufferSize(200));
+    client.adaptBatchSize(429, 100);
+    TEST_ASSERTM(client.getBatchSize() == 20, String(client.getBatchSize()));
+    TEST_END();
+}
+
+void Test::testPriorityLanes() {
+    TEST_INIT("testPriorityLanes");
+    InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    client.setWriteOptions(WriteOptions().batchSize(2).bufferSize(8));
+    client.setHTTPOptions(HTTPOptions().httpReadTimeout(500));
+    // points of different priority go to separate batches
+    TEST_ASSERT(client.bufferRecord("test1,tag=n index=0i", 20));
+    TEST_ASSERT(client.bufferRecord("test1,tag=h index=0i", 20, WritePriority::High));
+    TEST_ASSERT(client.bufferRecord("test1,tag=n index=1i", 20));
+    TEST_ASSERT(client.bufferRecord("test1,tag=h index=1i", 20, WritePriority::High));
+    TEST_ASSERTM(client._bufferPointer == 2, String(client._bufferPointer));
+    TEST_ASSERT(client._writeBuffer[0]->priority == WritePriority::Normal);
+    TEST_ASSERTM(!strcmp(client._writeBuffer[0]->line(client._lineBuffer, 1), "test1,tag=n index=1i"), client._writeBuffer[0]->line(client._lineBuffer, 1));
+    TEST_ASSERT(client._writeBuffer[1]->priority == WritePriority::High);
+    TEST_ASSERTM(!strcmp(client._writeBuffer[1]->line(client._lineBuffer, 1), "test1,tag=h index=1i"), client._writeBuffer[1]->line(client._lineBuffer, 1));
+    // high priority is written first
+    TEST_ASSERTM(client.nextBatchToWrite() == 1, String(client.nextBatchToWrite()));
+    TEST_ASSERT(client.bufferRecord("test1,tag=l index=0i", 20, WritePriority::Low));
+    TEST_ASSERT(client.bufferRecord("test1,tag=l index=1i", 20, WritePriority::Low));
+    TEST_ASSERT(client.bufferRecord("test1,tag=n index=2i", 20));
+    TEST_ASSERTM(client._bufferPointer == 3, String(client._bufferPointer));
+    TEST_ASSERT(!client.isBufferFull());
+    // full buffer overwrites the lowest priority first
+    TEST_ASSERT(client.bufferRecord("test1,tag=h index=2i", 20, WritePriority::High));
+    TEST_ASSERT(client.isBufferFull());
+    TEST_ASSERTM(client._bufferedPoints == 6, String(client._bufferedPoints));
+    for(int i=0;i<client._writeBufferSize;i++) {
+        TEST_ASSERTM(client.isBatchEmpty(i) || client._writeBuffer[i]->priority != WritePriority::Low, String(i));
+    }
+    TEST_ASSERT(client._writeBuffer[0]->priority == WritePriority::High);
+    TEST_ASSERTM(client._writeBuffer[2]->pointer == 2 && client._writeBuffer[2]->priority == WritePriority::Normal, String(client._writeBuffer[2]->pointer));
+    TEST_ASSERTM(client.nextBatchToWrite() == 1, String(client.nextBatchToWrite()));
+    TEST_ASSERT(!client.handleWriteResult(1, 204));
+    TEST_ASSERTM(client.nextBatchToWrite() == 0, String(client.nextBatchToWrite()));
+    // not full high priority batch doesn't block full batches of lower priority
+    TEST_ASSERTM(client.nextBatchToWrite(true) == 2, String(client.nextBatchToWrite(true)));
+    TEST_ASSERT(client.hasFullBatch());
+    TEST_ASSERT(checkBatchLists(client));
+
+    // buffer full of higher priority points rejects lower priority
+    client.resetBuffer();
+    char line[60];
+    for (int i = 0; i < 8; i++) {
+        sprintf(line, "test1,tag=h index=%di", i);
+        TEST_ASSERT(client.bufferRecord(line, strlen(line), WritePriority::High));
+    }
+    TEST_ASSERT(client.isBufferFull());
+    TEST_ASSERT(!client.bufferRecord("test1,tag=l index=0i", 20, WritePriority::Low));
+    TEST_ASSERTM(client.getLastErrorMessage() == "Write buffer is full of points of higher priority", client.getLastErrorMessage());
+    TEST_ASSERT(client.bufferRecord("test1,tag=h index=8i", 20, WritePriority::High));
+    TEST_ASSERTM(client._bufferedPoints == 7, String(client._bufferedPoints));
+
+    // lanes share the write buffer memory, lower priority lines are dropped and memory is compacted
+    client.setWriteOptions(WriteOptions().batchSize(5).bufferSize(50).bufferBytes(500));
+    for (int i = 0; i < 5; i++) {
+        // 49 chars + terminating zero
+        sprintf(line, "test1,tag=hhhhhhhhhhhhhhhhhhhhhhhhhhhh index=%03di", i);
+        TEST_ASSERT(client.bufferRecord(line, strlen(line), WritePriority::High));
+    }
+    for (int i = 0; i < 6; i++) {
+        sprintf(line, "test1,tag=llllllllllllllllllllllllllll index=%03di", i);
+        TEST_ASSERT(client.bufferRecord(line, strlen(line), WritePriority::Low));
+    }
+    TEST_ASSERTM(client._bufferedPoints == 6, String(client._bufferedPoints));
+    TEST_ASSERTM(client.getLineBufferUsed() == 300, String(client.getLineBufferUsed()));
+    for (int i = 5; i < 10; i++) {
+        sprintf(line, "test1,tag=hhhhhhhhhhhhhhhhhhhhhhhhhhhh index=%03di", i);
+        TEST_ASSERT(client.bufferRecord(line, strlen(line), WritePriority::High));
+    }
+    TEST_ASSERTM(client._bufferedPoints == 10, String(client._bufferedPoints));
+    TEST_ASSERTM(client.getLineBufferUsed() == 500, String(client.getLineBufferUsed()));
+    int found = 0;
+    for(int i=0;i<client._writeBufferSize;i++) {
+        if(client.isBatchEmpty(i)) {
+            continue;
+        }
+        InfluxDBClient::Batch *batch = client._writeBuffer[i];
+        TEST_ASSERTM(batch->priority == WritePriority::High, String(i));
+        for(int j=0;j<batch->pointer;j++) {
+            sprintf(line, "test1,tag=hhhhhhhhhhhhhhhhhhhhhhhhhhhh index=%03di", found++);
+            TEST_ASSERTM(!strcmp(batch->line(client._lineBuffer, j), line), batch->line(client._lineBuffer, j));
+        }
+    }
+    TEST_ASSERTM(found == 10, String(found));
+    TEST_ASSERT(!client.bufferRecord("test1,tag=llllllllllllllllllllllllllll index=006i", 49, WritePriority::Low));
+    TEST_ASSERTM(client._bufferedPoints == 10, String(client._bufferedPoints));
+    TEST_ASSERT(checkBatchLists(client));
+
+    // priority is passed through the writer task queue
+    LineQueue queue(64);
+    TEST_ASSERT(queue.push("line1", 5, (uint8_t)WritePriority::High));
+    TEST_ASSERT(queue.frontLength() == 5);
+    TEST_ASSERT(queue.frontTag() == (uint8_t)WritePriority::High);
+    TEST_END();
+}
+
+void Test::testOverflowPolicy() {
+    TEST_INIT("testOverflowPolicy");
+    InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    char line[60];
+    // oldest points are overwritten by default
+    client.setWriteOptions(WriteOptions().batchSize(2).bufferSize(8));
+    for (int i = 0; i < 12; i++) {
+        sprintf(line, "test1,tag=a index=%02di", i);
+        TEST_ASSERTM(client.bufferRecord(line, strlen(line)), String(i));
+    }
+    TEST_ASSERTM(client._bufferedPoints == 8, String(client._bufferedPoints));
+    TEST_ASSERTM(client.getDroppedPoints() == 4, String(client.getDroppedPoints()));
+    int16_t index = client.nextBatchToWrite();
+    TEST_ASSERTM(!strcmp(client._writeBuffer[index]->line(client._lineBuffer, 0), "test1,tag=a index=04i"), client._writeBuffer[index]->line(client._lineBuffer, 0));
+    TEST_ASSERT(checkBatchLists(client));
+
+    // new points are rejected
+    client.setWriteOptions(WriteOptions().batchSize(2).bufferSize(8).overflowPolicy(OverflowPolicy::DropNewest));
+    client.resetBuffer();
+    for (int i = 0; i < 12; i++) {
+        sprintf(line, "test1,tag=a index=%02di", i);
+        TEST_ASSERTM(client.bufferRecord(line, strlen(line)) == (i < 8), String(i));
+    }
+    TEST_ASSERTM(client.getLastErrorMessage() == "Write buffer is full", client.getLastErrorMessage());
+    TEST_ASSERTM(client._bufferedPoints == 8, String(client._bufferedPoints));
+    TEST_ASSERTM(client.getDroppedPoints() == 8, String(client.getDroppedPoints()));
+    index = client.nextBatchToWrite();
+    TEST_ASSERTM(!strcmp(client._writeBuffer[index]->line(client._lineBuffer, 0), "test1,tag=a index=00i"), client._writeBuffer[index]->line(client._lineBuffer, 0));
+    // written batch makes place for new points
+    TEST_ASSERT(!client.handleWriteResult(index, 204));
+    TEST_ASSERT(client.bufferRecord("test1,tag=a index=12i", 21));
+    TEST_ASSERTM(client._bufferedPoints == 7, String(client._bufferedPoints));
+
+    // buffer is decimated, covering the whole time with fewer points
+    client.setWriteOptions(WriteOptions().batchSize(2).bufferSize(8).overflowPolicy(OverflowPolicy::Decimate));
+    client.resetBuffer();
+    for (int i = 0; i < 12; i++) {
+        sprintf(line, "test1,tag=a index=%02di", i);
+        TEST_ASSERTM(client.bufferRecord(line, strlen(line)), String(i));
+    }
+    TEST_ASSERTM(client._bufferedPoints == 6, String(client._bufferedPoints));
+    TEST_ASSERTM(client.getDroppedPoints() == 14, String(client.getDroppedPoints()));
+    TEST_ASSERT(checkBatchLists(client));
+    int found = 0;
+    while((index = client.nextBatchToWrite()) >= 0) {
+        InfluxDBClient::Batch *batch = client._writeBuffer[index];
+        for(int j=0;j<batch->pointer;j++) {
+            sprintf(line, "test1,tag=a index=%02di", found*2);
+            found++;
+            TEST_ASSERTM(!strcmp(batch->line(client._lineBuffer, j), line), batch->line(client._lineBuffer, j));
+        }
+        client.handleWriteResult(index, 204);
+    }
+    TEST_ASSERTM(found == 6, String(found));
+    // written buffer stops decimation
+    TEST_ASSERT(client.bufferRecord("test1,tag=a index=12i", 21));
+    TEST_ASSERT(client.bufferRecord("test1,tag=a index=13i", 21));
+    TEST_ASSERTM(client._bufferedPoints == 2, String(client._bufferedPoints));
+
+    // only the lowest priority is decimated
+    client.resetBuffer();
+    for (int i = 0; i < 4; i++) {
+        sprintf(line, "test1,tag=h index=%02di", i);
+        TEST_ASSERT(client.bufferRecord(line, strlen(line), WritePriority::High));
+    }
+    for (int i = 0; i < 8; i++) {
+        sprintf(line, "test1,tag=n index=%02di", i);
+        TEST_ASSERTM(client.bufferRecord(line, strlen(line)), String(i));
+    }
+    TEST_ASSERTM(client._bufferedPoints == 8, String(client._bufferedPoints));
+    int high = 0;
+    for(int i=0;i<client._writeBufferSize;i++) {
+        if(!client.isBatchEmpty(i) && client._writeBuffer[i]->priority == WritePriority::High) {
+            high += client._writeBuffer[i]->pointer;
+        }
+    }
+    TEST_ASSERTM(high == 4, String(high));
+    TEST_ASSERT(checkBatchLists(client));
+    TEST_END();
+}
+
+void Test::testAggregation() {
+    TEST_INIT("testAggregation");
+    Point series("vibration");
+    series.addTag("device", "d 1");
+    Aggregator aggregator(series, 1000, AggregateFunction::Mean | AggregateFunction::Min | AggregateFunction::Max | AggregateFunction::Count | AggregateFunction::Last, 2);
+    Point point("vibration");
+    point.addTag("device", "d 1");
+    TEST_ASSERT(aggregator.matches(point));
+    Point other("vibration");
+    other.addTag("device", "d2");
+    TEST_ASSERT(!aggregator.matches(other));
+    for (int i = 0; i < 50; i++) {
+        point.clearFields();
+        point.addField("x", i);
+        point.addField("state", "running");
+        point.addField("on", i % 4 == 0);
+        point.addField("a,b", -i*0.5);
+        aggregator.add(point, 100 + i*20);
+    }
+    TEST_ASSERTM(aggregator.getPoints() == 50, String(aggregator.getPoints()));
+    TEST_ASSERT(!aggregator.isDue(1099));
+    TEST_ASSERT(aggregator.isDue(1100));
+    // series point doesn't change the aggregated one
+    series.addField("x", 1);
+    Point &aggregated = aggregator.close(1150);
+    String line = aggregated.toLineProtocol();
+    TEST_ASSERTM(line == "vibration,device=d\\ 1 x_mean=24.50,x_min=0i,x_max=49i,x_count=50i,x_last=49i,on_mean=0.26,on_min=0.00,on_max=1.00,on_count=50i,on_last=0.00,"
+        "a\\,b_mean=-12.25,a\\,b_min=-24.50,a\\,b_max=0.00,a\\,b_count=50i,a\\,b_last=-24.50", line);
+    TEST_ASSERT(aggregator.getPoints() == 0);
+    TEST_ASSERT(!aggregator.isDue(2099));
+    // windows are aligned to the first point
+    point.clearFields();
+    point.addField("x", 1.5);
+    aggregator.add(point, 3500);
+    TEST_ASSERT(!aggregator.isDue(4099));
+    TEST_ASSERT(aggregator.isDue(4100));
+    line = aggregator.close(4100).toLineProtocol();
+    TEST_ASSERTM(line == "vibration,device=d\\ 1 x_mean=1.50,x_min=1.50,x_max=1.50,x_count=1i,x_last=1.50", line);
+    // integers are aggregated exactly
+    Aggregator integers(series, 1000, AggregateFunction::Min | AggregateFunction::Max | AggregateFunction::Last, 2);
+    const long long big = 9007199254740993LL;
+    for (int i = 0; i < 3; i++) {
+        point.clearFields();
+        point.addField("n", big + i);
+        point.addField("u", 9223372036854775807ULL - i);
+        integers.add(point, 100);
+    }
+    line = integers.close(1100).toLineProtocol();
+    TEST_ASSERTM(line == "vibration,device=d\\ 1 n_min=9007199254740993i,n_max=9007199254740995i,n_last=9007199254740995i,"
+        "u_min=9223372036854775805i,u_max=9223372036854775807i,u_last=9223372036854775805i", line);
+    // aggregated point is stamped with the window start
+    point.clearFields();
+    point.addField("x", 1);
+    integers.add(point, 5000);
+    unsigned long long start = time(nullptr) - 3;
+    Point &stamped = integers.close(8000, WritePrecision::S);
+    TEST_ASSERTM(stamped.hasTime(), stamped.toLineProtocol());
+    unsigned long long stamp = strtoull(stamped.getTime().c_str(), nullptr, 10);
+    TEST_ASSERTM(stamp >= start - 1 && stamp <= start + 1, stamped.getTime() + " vs " + String((unsigned long)start));
+    TEST_ASSERT(!integers.close(9000).hasTime());
+
+    // client writes one point per window
+    InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    client.setWriteOptions(WriteOptions().batchSize(10).bufferSize(100));
+    TEST_ASSERT(client.aggregateSeries(series, 200, AggregateFunction::Mean | AggregateFunction::Max));
+    for (int i = 0; i < 10; i++) {
+        point.clearFields();
+        point.addField("x", i);
+        TEST_ASSERT(client.writePoint(point));
+    }
+    other.addField("x", 1);
+    TEST_ASSERT(client.writePoint(other));
+    TEST_ASSERTM(client._bufferedPoints == 1, String(client._bufferedPoints));
+    delay(250);
+    TEST_ASSERT(client.checkBuffer());
+    TEST_ASSERTM(client._bufferedPoints == 2, String(client._bufferedPoints));
+    TEST_ASSERTM(!strcmp(client._writeBuffer[0]->line(client._lineBuffer, 1), "vibration,device=d\\ 1 x_mean=4.50,x_max=9i"), client._writeBuffer[0]->line(client._lineBuffer, 1));
+    // stopped aggregation writes accumulated window
+    TEST_ASSERT(client.writePoint(point));
+    TEST_ASSERT(client.aggregateSeries(series, 0));
+    TEST_ASSERTM(client._bufferedPoints == 3, String(client._bufferedPoints));
+    TEST_ASSERT(client.writePoint(point));
+    TEST_ASSERTM(client._bufferedPoints == 4, String(client._bufferedPoints));
+    TEST_ASSERTM(!strcmp(client._writeBuffer[0]->line(client._lineBuffer, 3), "vibration,device=d\\ 1 x=9i"), client._writeBuffer[0]->line(client._lineBuffer, 3));
+    // aggregated point is written to the bucket of the points
+    InfluxDBClient bucketClient(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    bucketClient.setWriteOptions(WriteOptions().batchSize(10).bufferSize(100));
+    TEST_ASSERT(bucketClient.aggregateSeries(series, 1000, AggregateFunction::Max));
+    for (int i = 0; i < 3; i++) {
+        point.clearFields();
+        point.addField("x", i);
+        TEST_ASSERT(bucketClient.writePoint(point, "debug"));
+    }
+    TEST_ASSERT(bucketClient.aggregateSeries(series, 0));
+    TEST_ASSERTM(bucketClient._bufferedPoints == 1, String(bucketClient._bufferedPoints));
+    int16_t index = bucketClient.getLaneBatch(WritePriority::Normal, 1);
+    TEST_ASSERT(index >= 0);
+    TEST_ASSERTM(bucketClient._writeBuffer[index]->pointer == 1, String(bucketClient._writeBuffer[index]->pointer));
+    TEST_ASSERTM(!strcmp(bucketClient._writeBuffer[index]->line(bucketClient._lineBuffer, 0), "vibration,device=d\\ 1 x_max=2i"), bucketClient._writeBuffer[index]->line(bucketClient._lineBuffer, 0));
+    TEST_END();
+}
+
+void Test::testChangeFilter() {
+    TEST_INIT("testChangeFilter");
+    ChangeFilter filter(16, 0.5, 0.1, 10000);
+    TEST_ASSERT(filter.isValid());
+    Point point("env");
+    point.addTag("room", "kitchen");
+    point.addField("temp", 20.0);
+    point.addField("state", "heating");
+    // the first point is always written
+    TEST_ASSERT(filter.check(point, 0));
+    TEST_ASSERT(!filter.check(point, 100));
+    point.clearFields();
+    point.addField("temp", 20.4);
+    point.addField("state", "heating");
+    TEST_ASSERT(!filter.check(point, 200));
+    // relative deadband of 20.0 is greater than absolute
+    point.clearFields();
+    point.addField("temp", 21.9);
+    point.addField("state", "heating");
+    TEST_ASSERT(!filter.check(point, 300));
+    point.clearFields();
+    point.addField("temp", 22.1);
+    point.addField("state", "heating");
+    TEST_ASSERT(filter.check(point, 400));
+    // deadband is relative to the last written value
+    point.clearFields();
+    point.addField("temp", 19.8);
+    point.addField("state", "heating");
+    TEST_ASSERT(filter.check(point, 500));
+    // string field changed
+    point.clearFields();
+    point.addField("temp", 20.3);
+    point.addField("state", "idle");
+    TEST_ASSERT(filter.check(point, 600));
+    TEST_ASSERT(!filter.check(point, 700));
+    // new field
+    point.addField("hum", 40);
+    TEST_ASSERT(filter.check(point, 800));
+    // series are separated by tags
+    Point other("env");
+    other.addTag("room", "hall");
+    other.addField("temp", 20.3);
+    other.addField("state", "idle");
+    TEST_ASSERT(filter.check(other, 900));
+    TEST_ASSERT(!filter.check(other, 1000));
+    // heartbeat
+    TEST_ASSERT(!filter.check(point, 10799));
+    TEST_ASSERT(filter.check(point, 10800));
+    TEST_ASSERT(!filter.check(point, 10900));
+    TEST_ASSERTM(filter.getSuppressed() == 7, String(filter.getSuppressed()));
+    // full table forgets fields, which are then written again
+    ChangeFilter small(2, 0, 0, 0);
+    char name[10];
+    for (int i = 0; i < 10; i++) {
+        Point p("m");
+        sprintf(name, "f%d", i);
+        p.addField(name, 1);
+        TEST_ASSERT(small.check(p, i));
+    }
+    Point last("m");
+    last.addField("f9", 1);
+    TEST_ASSERT(!small.check(last, 20));
+    // series with colliding FNV-1a hashes are told apart
+    Point liquid("liquid");
+    liquid.addField("f", 1);
+    Point costarring("costarring");
+    costarring.addField("f", 1);
+    TEST_ASSERT(small.check(liquid, 30));
+    TEST_ASSERT(small.check(costarring, 31));
+    // value of changed type is written
+    last.clearFields();
+    last.addField("f9", "1");
+    TEST_ASSERT(small.check(last, 32));
+
+    InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    client.setWriteOptions(WriteOptions().batchSize(10).bufferSize(100).sendOnChange(1));
+    for (int i = 0; i < 10; i++) {
+        point.clearFields();
+        point.addField("temp", 20.0 + i*0.3);
+        TEST_ASSERT(client.writePoint(point));
+    }
+    // 20.0, 21.2, 22.4
+    TEST_ASSERTM(client._bufferedPoints == 3, String(client._bufferedPoints));
+    TEST_ASSERTM(client.getSuppressedPoints() == 7, String(client.getSuppressedPoints()));
+    TEST_ASSERTM(!strcmp(client._writeBuffer[0]->line(client._lineBuffer, 1), "env,room=kitchen temp=21.20"), client._writeBuffer[0]->line(client._lineBuffer, 1));
+    // disabled filter
+    client.setWriteOptions(WriteOptions().batchSize(10).bufferSize(100));
+    TEST_ASSERT(client.writePoint(point));
+    TEST_ASSERTM(client._bufferedPoints == 4, String(client._bufferedPoints));
+    TEST_END();
+}
+
+void Test::testFanOut() {
+    TEST_INIT("testFanOut");
+    InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    client.setWriteOptions(WriteOptions().batchSize(2).bufferSize(8).maxRetryAttempts(2));
+    TEST_ASSERT(!client.addWriteTarget("ftp://127.0.0.1:998", Test::orgName, "mirror", Test::token));
+    TEST_ASSERTM(client.getLastErrorMessage() == "Invalid parameters", client.getLastErrorMessage());
+    TEST_ASSERT(client.addWriteTarget(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, "mirror", Test::token));
+    TEST_ASSERT(client.addWriteTarget(INFLUXDB_CLIENT_TESTING_BAD_URL "/", Test::orgName, "backup", Test::token));
+    TEST_ASSERT(client.getWriteTargetsCount() == 2);
+    char line[60];
+    for (int i = 0; i < 6; i++) {
+        sprintf(line, "test1,tag=a index=%02di", i);
+        TEST_ASSERTM(client.bufferRecord(line, strlen(line)), String(i));
+    }
+    // lines are stored once for all targets
+    TEST_ASSERTM(client._bufferedPoints == 6, String(client._bufferedPoints));
+    TEST_ASSERTM(client.getPendingBatches(0) == 3 && client.getPendingBatches(1) == 3 && client.getPendingBatches(2) == 3, String(client.getPendingBatches(1)));
+    // batch written to the server waits for the targets
+    int16_t index = client.nextBatchToWrite();
+    TEST_ASSERT(index == 0);
+    client.detachBatch(index);
+    TEST_ASSERT(!client.handleWriteResult(index, 204));
+    TEST_ASSERTM(client._bufferedPoints == 6, String(client._bufferedPoints));
+    TEST_ASSERT(client.nextBatchToWrite() == 1);
+    TEST_ASSERT(client.nextBatchToWrite(false, 1) == 0);
+    // each target keeps its own progress
+    TEST_ASSERT(!client.handleTargetResult(0, 0, 204));
+    TEST_ASSERT(client.nextBatchToWrite(false, 1) == 1);
+    TEST_ASSERT(client.nextBatchToWrite(false, 2) == 0);
+    TEST_ASSERTM(client._bufferedPoints == 6, String(client._bufferedPoints));
+    TEST_ASSERT(!client.handleTargetResult(1, 0, 204));
+    TEST_ASSERTM(client._bufferedPoints == 4, String(client._bufferedPoints));
+    TEST_ASSERTM(client.getPendingBatches(0) == 2 && client.getPendingBatches(1) == 2, String(client.getPendingBatches(1)));
+    // failing target pauses, others continue
+    TEST_ASSERT(client.handleTargetResult(0, 1, 503, 30));
+    TEST_ASSERTM(client.getTargetPauseRemaining(*client._targets[0]) > 29000, String(client.getTargetPauseRemaining(*client._targets[0])));
+    TEST_ASSERT(client.getRemainingRetryTime() == 0);
+    TEST_ASSERT(!client.handleTargetResult(1, 1, 204));
+    TEST_ASSERT(client.handleTargetResult(0, 1, 503));
+    // batch is dropped for the target after max retries
+    TEST_ASSERT(!client.handleTargetResult(0, 1, 503));
+    TEST_ASSERTM(client.getPendingBatches(1) == 1 && client.getPendingBatches(0) == 2, String(client.getPendingBatches(1)));
+    TEST_ASSERT(client._targets[0]->failedWrites == 0);
+    index = client.nextBatchToWrite(false, 1);
+    TEST_ASSERT(index == 2);
+    TEST_ASSERT(!client.handleTargetResult(0, index, 204));
+    index = client.nextBatchToWrite();
+    TEST_ASSERT(index == 1);
+    client.detachBatch(index);
+    TEST_ASSERT(!client.handleWriteResult(index, 204));
+    TEST_ASSERTM(client._bufferedPoints == 2, String(client._bufferedPoints));
+    index = client.nextBatchToWrite();
+    TEST_ASSERT(index == 2);
+    client.detachBatch(index);
+    TEST_ASSERT(!client.handleWriteResult(index, 204));
+    TEST_ASSERTM(client.getPendingBatches(0) == 0 && client.getPendingBatches(2) == 1, String(client.getPendingBatches(2)));
+    // removed targets don't hold batches anymore
+    client.removeWriteTargets();
+    TEST_ASSERT(client.getWriteTargetsCount() == 0);
+    TEST_ASSERTM(client._bufferedPoints == 0, String(client._bufferedPoints));
+    TEST_ASSERT(client.isBufferEmpty());
+    TEST_END();
+}
+
+void Test::testBucketRouting() {
+    TEST_INIT("testBucketRouting");
+    InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    client.setWriteOptions(WriteOptions().batchSize(2).bufferSize(12));
+    TEST_ASSERT(client.routeMeasurement("debug*", "debug"));
+    TEST_ASSERT(client.routeMeasurement("event", "events"));
+    TEST_ASSERT(client.addWriteTarget(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, "mirror", Test::token));
+    TEST_ASSERT(client.bufferRecord("test1,tag=a index=0i", 20));
+    // lines of buckets are interleaved, but batched separately. Full batches fail to be written to the bad url and stay in the buffer
+    client.writeRecord("debug_wifi,tag=a rssi=-60i");
+    client.writeRecord("event,tag=a code=1i");
+    client.writeRecord("events,tag=a code=2i");
+    client.writeRecord("debug\\ heap,tag=a free=100i", "debug");
+    client.writeRecord("test1,tag=a index=1i", "events");
+    Point point("event");
+    point.addTag("tag", "b");
+    point.addField("code", 3);
+    client.writePoint(point);
+    client.writePoint(point, Test::bucketName);
+    TEST_ASSERTM(client._bufferedPoints == 8, String(client._bufferedPoints));
+    const char *expected[][2] = { 
+        { "test1,tag=a index=0i", "events,tag=a code=2i" }, 
+        { "debug_wifi,tag=a rssi=-60i", "debug\\ heap,tag=a free=100i" },
+        { "event,tag=a code=1i", "test1,tag=a index=1i" }, 
+        { "event,tag=b code=3i", nullptr },
+        { "event,tag=b code=3i", nullptr } };
+    uint8_t routes[] = { 0, 1, 2, 2, 0 };
+    int16_t found[] = { -1, -1, -1, -1, -1 };
+    for(int i=0;i<client._writeBufferSize;i++) {
+        if(client.isBatchEmpty(i)) {
+            continue;
+        }
+        InfluxDBClient::Batch *batch = client._writeBuffer[i];
+        for(int j=0;j<5;j++) {
+            if(!strcmp(batch->line(client._lineBuffer, 0), expected[j][0]) && found[j] == -1) {
+                found[j] = i;
+                TEST_ASSERTM(batch->route == routes[j], String(j) + ": " + String(batch->route));
+                TEST_ASSERTM(batch->pointer == (expected[j][1] ? 2 : 1) , String(j) + ": " + String(batch->pointer));
+                if(expected[j][1]) {
+                    TEST_ASSERTM(!strcmp(batch->line(client._lineBuffer, 1), expected[j][1]), batch->line(client._lineBuffer, 1));
+                }
+                // only the default bucket is mirrored
+                TEST_ASSERTM(batch->pending == (routes[j] ? 1 : 3), String(j) + ": " + String(batch->pending));
+                break;
+            }
+        }
+    }
+    for(int j=0;j<5;j++) {
+        TEST_ASSERTM(found[j] >= 0, String(j));
+    }
+    TEST_ASSERT(client.init());
+    TEST_ASSERTM(client.getWriteUrl(client._writeBuffer[found[0]]).endsWith(String("bucket=") + Test::bucketName), client.getWriteUrl(client._writeBuffer[found[0]]));
+    TEST_ASSERTM(client.getWriteUrl(client._writeBuffer[found[1]]).endsWith("bucket=debug"), client.getWriteUrl(client._writeBuffer[found[1]]));
+    TEST_ASSERTM(client.getWriteUrl(client._writeBuffer[found[2]]).endsWith("bucket=events"), client.getWriteUrl(client._writeBuffer[found[2]]));
+    // bucket added later has url as well
+    client.writeRecord("test1,tag=a index=2i", "other");
+    int16_t index = client.getLaneBatch(WritePriority::Normal, 3);
+    TEST_ASSERT(index >= 0);
+    TEST_ASSERTM(client.getWriteUrl(client._writeBuffer[index]).endsWith("bucket=other"), client.getWriteUrl(client._writeBuffer[index]));
+    for(int i=0;i<4;i++) {
+        TEST_ASSERT(client.routeMeasurement("m" + String(i), "b" + String(i)));
+    }
+    TEST_ASSERT(!client.routeMeasurement("m4", "b4"));
+    TEST_ASSERTM(client.getLastErrorMessage() == "Too many buckets", client.getLastErrorMessage());
+    TEST_ASSERT(!client.writeRecord("test1,tag=a index=3i", "b4"));
+    TEST_END();
+}
+
+void Test::testMemoryStats() {
+    TEST_INIT("testMemoryStats");
+    MemoryStats base = InfluxDBClient::getMemoryStats();
+    {
+        // typical point takes less than its line protocol and the fixed overhead, including the line cache
+        Point point("environment");
+        point.addTag("device", "esp32-livingroom");
+        point.addTag("sensor", "bme280");
+        point.addField("temperature", 21.5);
+        point.addField("humidity", 45.25);
+        point.addField("pressure", 1013);
+        point.setTime(1600000000000ull);
+        MemoryStats stats = InfluxDBClient::getMemoryStats();
+        uint32_t used = stats.points.current - base.points.current;
+        TEST_ASSERTM(used >= point.toLineProtocol().length(), String(used));
+        TEST_ASSERTM(used <= point.toLineProtocol().length() + 128 + sizeof(Point) + sizeof(String), String(used));
+        TEST_ASSERTM(stats.points.allocations > base.points.allocations, String(stats.points.allocations));
+        TEST_ASSERTM(stats.points.peak >= stats.points.current, String(stats.points.peak));
+        // copies share data
+        Point copy = point;
+        TEST_ASSERTM(InfluxDBClient::getMemoryStats().points.current == stats.points.current, String(InfluxDBClient::getMemoryStats().points.current));
+        // fields growing within an accounting block don't change counters
+        point.clearFields();
+        point.addField("a", 1);
+        stats = InfluxDBClient::getMemoryStats();
+        point.addField("b", 2);
+        TEST_ASSERTM(InfluxDBClient::getMemoryStats().points.allocations == stats.points.allocations, String(InfluxDBClient::getMemoryStats().points.allocations));
+        TEST_ASSERTM(InfluxDBClient::getMemoryStats().points.current == stats.points.current, String(InfluxDBClient::getMemoryStats().points.current));
+    }
+    TEST_ASSERTM(InfluxDBClient::getMemoryStats().points.current == base.points.current, String(InfluxDBClient::getMemoryStats().points.current));
+    {
+        // buffer of 100 points in batches of 10 takes at most twice the lines and the batches
+        InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+        client.setWriteOptions(WriteOptions().batchSize(10).bufferSize(100));
+        uint32_t linesBytes = 0;
+        for(int i=0;i<100;i++) {
+            String line = "test1,tag=a,device=esp index=" + String(i) + "i";
+            linesBytes += line.length();
+            TEST_ASSERT(client.bufferRecord(line.c_str(), line.length()));
+        }
+        MemoryStats stats = InfluxDBClient::getMemoryStats();
+        uint32_t used = stats.writeBuffer.current - base.writeBuffer.current;
+        uint32_t budget = 2*linesBytes + 10*(sizeof(InfluxDBClient::Batch) + 10*sizeof(InfluxDBClient::Line) + sizeof(InfluxDBClient::Batch *));
+        TEST_ASSERTM(used >= linesBytes && used <= budget, String(used) + " vs " + String(budget));
+        TEST_ASSERTM(stats.writeBuffer.peak >= stats.writeBuffer.current, String(stats.writeBuffer.peak));
+        // non-TLS connection needs only the client objects
+        TEST_ASSERT(client.init());
+        used = InfluxDBClient::getMemoryStats().http.current - base.http.current;
+        TEST_ASSERTM(used > 0 && used <= sizeof(HTTPService) + sizeof(HTTPClient) + sizeof(WiFiClient), String(used));
+    }
+    MemoryStats stats = InfluxDBClient::getMemoryStats();
+    TEST_ASSERTM(stats.writeBuffer.current == base.writeBuffer.current, String(stats.writeBuffer.current));
+    TEST_ASSERTM(stats.http.current == base.http.current, String(stats.http.current));
+    {
+        // query values account their raw value
+        FluxValue value(new FluxString("esp32-livingroom", FluxDatatypeString));
+        uint32_t used = InfluxDBClient::getMemoryStats().query.current - base.query.current;
+        TEST_ASSERTM(used >= 2*strlen("esp32-livingroom") && used <= 2*strlen("esp32-livingroom") + sizeof(FluxString), String(used));
+    }
+    TEST_ASSERTM(InfluxDBClient::getMemoryStats().query.current == base.query.current, String(InfluxDBClient::getMemoryStats().query.current));
+    TEST_ASSERTM(InfluxDBClient::getMemoryStats().total.current == base.total.current, String(InfluxDBClient::getMemoryStats().total.current));
+    // peaks can be reset to measure next workload
+    InfluxDBClient::resetMemoryPeaks();
+    stats = InfluxDBClient::getMemoryStats();
+    TEST_ASSERTM(stats.writeBuffer.peak == stats.writeBuffer.current, String(stats.writeBuffer.peak));
+    TEST_ASSERTM(stats.total.peak == stats.total.current, String(stats.total.peak));
+    TEST_END();
+}
+
+void Test::testPointSchema() {
+    TEST_INIT("testPointSchema");
+    PointSchema<2, 4> schema("my env", {"site", "dev id"}, {"temp", "hum", "on", "note"});
+    TEST_ASSERT(schema.isValid());
+    auto line = schema.encode({"a,b=c", "esp 1"}, {21.5, 45, true, "say \"hi\""}, 1600000000123ull);
+    Point point("my env");
+    point.addTag("site", "a,b=c");
+    point.addTag("dev id", "esp 1");
+    point.addField("temp", 21.5);
+    point.addField("hum", 45);
+    point.addField("on", true);
+    point.addField("note", "say \"hi\"");
+    point.setTime(1600000000123ull);
+    TEST_ASSERTM(point.toLineProtocol() == line.c_str(), line.c_str());
+    TEST_ASSERTM(line.length() == strlen(line.c_str()), String(line.length()));
+    // null tag and NaN field are omitted
+    line = schema.encode({nullptr, "esp1"}, {NAN, 45u, false, String("x")});
+    TEST_ASSERTM(!strcmp(line.c_str(), "my\\ env,dev\\ id=esp1 hum=45i,on=false,note=\"x\""), line.c_str());
+    line = schema.encode({"a", "b"}, {NAN, (float)NAN, 1.5, 2.5});
+    TEST_ASSERTM(!strcmp(line.c_str(), "my\\ env,site=a,dev\\ id=b on=1.50,note=2.50"), line.c_str());
+    // no field, wrong count of values
+    line = schema.encode({"a", "b"}, {NAN, NAN, NAN, NAN});
+    TEST_ASSERTM(line.length() == 0 && !line.c_str()[0], line.c_str());
+    TEST_ASSERT(schema.encode({"a"}, {1, 2, 3, 4}).length() == 0);
+    // wrong count of names
+    PointSchema<1, 1> invalid("m", {"t1", "t2"}, {"f"});
+    TEST_ASSERT(!invalid.isValid());
+    TEST_ASSERT(invalid.encode({"a"}, {1}).length() == 0);
+    // line must fit into the buffer
+    PointSchema<1, 1, 20> small("m", {"tag"}, {"field"});
+    TEST_ASSERTM(!strcmp(small.encode({"abc"}, {1}).c_str(), "m,tag=abc field=1i"), small.encode({"abc"}, {1}).c_str());
+    TEST_ASSERT(small.encode({"abcd"}, {1000}).length() == 0);
+    // encoding doesn't allocate
+    MemoryStats before = InfluxDBClient::getMemoryStats();
+    line = schema.encode({"site", "esp1"}, {22.5, 44, true, "ok"}, 1600000000123ull);
+    TEST_ASSERT(InfluxDBClient::getMemoryStats().total.allocations == before.total.allocations);
+    // benchmark against point with the same data
+    const int count = 1000;
+    uint32_t start = micros();
+    size_t length = 0;
+    for(int i=0;i<count;i++) {
+        Point p("environment");
+        p.addTag("site", "office");
+        p.addTag("device", "esp32-livingroom");
+        p.addField("temperature", 21.5 + i%10);
+        p.addField("humidity", 40 + i%20);
+        p.addField("pressure", 1013.25);
+        p.addField("ok", true);
+        p.setTime(1600000000000ull + i);
+        length += p.toLineProtocol().length();
+    }
+    uint32_t tookPoint = micros() - start;
+    PointSchema<2, 4> env("environment", {"site", "device"}, {"temperature", "humidity", "pressure", "ok"});
+    start = micros();
+    size_t schemaLength = 0;
+    for(int i=0;i<count;i++) {
+        schemaLength += env.encode({"office", "esp32-livingroom"}, {21.5 + i%10, 40 + i%20, 1013.25, true}, 1600000000000ull + i).length();
+    }
+    uint32_t tookSchema = micros() - start;
+    TEST_ASSERTM(schemaLength == length, String(schemaLength) + " vs " + String(length));
+    Serial.printf("  %d lines: Point %7uus, PointSchema %7uus\n", count, tookPoint, tookSchema);
+    TEST_END();
+}
+
+void Test::testNumberFormat() {
+    TEST_INIT("testNumberFormat");
+    char buff[MaxNumberLength + 1], ref[64];
+    long long integers[] = { 0, 1, -1, 9, 10, 99, 100, -12345, 2147483647, -2147483648LL, 9223372036854775807LL, -9223372036854775807LL - 1 };
+    for(long long i : integers) {
+        snprintf(ref, sizeof(ref), "%lld", i);
+        TEST_ASSERTM(formatInteger(buff, i) == strlen(ref) && !strcmp(buff, ref), buff);
+    }
+    TEST_ASSERTM(formatUnsigned(buff, 18446744073709551615ULL) == 20 && !strcmp(buff, "18446744073709551615"), buff);
+    // fixed decimals as printf, away from halves
+    double decimals[] = { 0, 1, -1, 0.001, 21.5, -21.49, 1013.26, 3.14159265, -0.004, 123456789.987654, 1e-9 };
+    for(double d : decimals) {
+        for(int p = 0; p < 8; p++) {
+            snprintf(ref, sizeof(ref), "%.*f", p, d);
+            TEST_ASSERTM(formatDecimal(buff, d, p) == strlen(ref) && !strcmp(buff, ref), String(buff) + " vs " + ref);
+        }
+    }
+    // halves round away from zero, as String(value, decimalPlaces)
+    TEST_ASSERTM(formatDecimal(buff, 0.5, 0) == 1 && !strcmp(buff, "1"), buff);
+    TEST_ASSERTM(formatDecimal(buff, -2.25, 1) == 4 && !strcmp(buff, "-2.3"), buff);
+    // too large for fixed notation
+    formatDecimal(buff, 1e300, 2);
+    TEST_ASSERTM(!strcmp(buff, "1e+300"), buff);
+    formatDecimal(buff, INFINITY, 2);
+    TEST_ASSERTM(!strcmp(buff, "inf"), buff);
+    // shortest round-trip
+    const char *shortest[][2] = { { "0.1", "0.1" }, { "21.5", "21.5" }, { "-0", "0" }, { "100", "100" }, { "0.3333333333333333", "0.3333333333333333" }, 
+        { "1e20", "1e+20" }, { "1.5e-10", "0.00000000015" }, { "1.7976931348623157e308", "1.7976931348623157e+308" }, { "5e-324", "5e-324" },
+        { "0.3", "0.3" }, { "9007199254740994", "9007199254740994" }, { "123456789012345680000", "1.2345678901234568e+20" } };
+    for(auto &t : shortest) {
+        uint8_t len = formatShortest(buff, strtod(t[0], nullptr));
+        TEST_ASSERTM(len == strlen(t[1]) && !strcmp(buff, t[1]), String(t[0]) + ": " + buff);
+    }
+    formatShortest(buff, 0.1f);
+    TEST_ASSERTM(!strcmp(buff, "0.1"), buff);
+    formatShortest(buff, 1.0/3);
+    TEST_ASSERT(strtod(buff, nullptr) == 1.0/3);
+    srand(1);
+    for(int i = 0; i < 2000; i++) {
+        double d = (rand() - RAND_MAX/2) * pow(10, rand() % 40 - 20) / (rand() + 1.0);
+        uint8_t len = formatShortest(buff, d);
+        TEST_ASSERTM(strtod(buff, nullptr) == d, buff);
+        TEST_ASSERTM(len <= MaxNumberLength, buff);
+        // no representation with less significant digits parses back
+        int digits = 0, zeroes = 0;
+        for(const char *c = buff; *c && *c != 'e'; c++) {
+            if(*c == '0' && !digits) {
+                continue;
+            }
+            if(*c >= '0' && *c <= '9') {
+                // trailing zeroes of integers are not significant
+                zeroes = *c == '0' ? zeroes + 1 : 0;
+                digits++;
+            }
+        }
+        if(!strchr(buff, '.')) {
+            digits -= zeroes;
+        }
+        snprintf(ref, sizeof(ref), "%.*g", digits - 1, d);
+        TEST_ASSERTM(digits == 1 || strtod(ref, nullptr) != d, String(buff) + " vs " + ref);
+    }
+    // point fields
+    Point point("test");
+    point.addField("f", 0.1f, DecimalPlacesShortest);
+    point.addField("d", 1013.2567, DecimalPlacesShortest);
+    point.addField("r", 1013.2567);
+    point.addField("i", -9223372036854775807LL - 1);
+    point.addField("u", 18446744073709551615ULL);
+    point.addField("c", (unsigned char)200);
+    point.setTime(1600000000123456789ULL);
+    TEST_ASSERTM(point.toLineProtocol() == "test f=0.1,d=1013.2567,r=1013.26,i=-9223372036854775808i,u=18446744073709551615i,c=200i 1600000000123456789", point.toLineProtocol());
+    // benchmark against printf
+    const int count = 10000;
+    uint32_t start = micros();
+    size_t total = 0;
+    for(int i = 0; i < count; i++) {
+        total += snprintf(ref, sizeof(ref), "%.*f", 2, i*1.37);
+    }
+    uint32_t tookRef = micros() - start;
+    start = micros();
+    size_t totalFast = 0;
+    for(int i = 0; i < count; i++) {
+        totalFast += formatDecimal(buff, i*1.37, 2);
+    }
+    uint32_t took = micros() - start;
+    TEST_ASSERTM(total == totalFast, String(total) + " vs " + String(totalFast));
+    start = micros();
+    for(int i = 0; i < count; i++) {
+        formatShortest(buff, i*1.37);
+    }
+    uint32_t tookShortest = micros() - start;
+    Serial.printf("  %d doubles: snprintf %7uus, formatDecimal %7uus, formatShortest %7uus\n", count, tookRef, took, tookShortest);
+    TEST_END();
+}
+
+void Test::testKeyCache() {
+    TEST_INIT("testKeyCache");
+    // keys of previous tests are removed
+    KeyCache::clear();
+    TEST_ASSERT(KeyCache::getCount() == 0 && KeyCache::getBytes() == 0);
+    uint16_t count = 0, bytes = 0;
+    Point point("test");
+    point.addTag("cached key", "a b");
+    TEST_ASSERTM(KeyCache::getCount() == count + 1, String(KeyCache::getCount()));
+    // key and its escaped form are kept
+    TEST_ASSERTM(KeyCache::getBytes() == bytes + 10 + 11, String(KeyCache::getBytes()));
+    // same key from other memory is found
+    String name = "cached";
+    name += " key";
+    point.addField(name, 1);
+    point.addField(F("flash,key"), 2);
+    point.addField(F("flash,key"), 3);
+    point.addField("plain", 4);
+    point.addField(String("plain"), 5);
+    TEST_ASSERTM(point.toLineProtocol() == "test,cached\\ key=a\\ b cached\\ key=1i,flash\\,key=2i,flash\\,key=3i,plain=4i,plain=5i", point.toLineProtocol());
+    TEST_ASSERTM(KeyCache::getCount() == count + 3, String(KeyCache::getCount()));
+    // benchmark against escaping each time
+    const int count2 = 10000;
+    String dest;
+    dest.reserve(32);
+    uint32_t start = micros();
+    for(int i = 0; i < count2; i++) {
+        dest = "";
+        char *s = escapeKey("temperature");
+        dest += s;
+        delete [] s;
+    }
+    uint32_t tookRef = micros() - start;
+    start = micros();
+    for(int i = 0; i < count2; i++) {
+        dest = "";
+        KeyCache::append(dest, "temperature");
+    }
+    uint32_t took = micros() - start;
+    TEST_ASSERTM(dest == "temperature", dest);
+    Serial.printf("  %d keys: escapeKey %7uus, KeyCache %7uus\n", count2, tookRef, took);
+    // keys are escaped, when the cache is full
+    for(int i = 0; i < INFLUXDB_CLIENT_KEY_CACHE_SIZE + 1; i++) {
+        Point p("test");
+        p.addField("key " + String(i), i);
+        TEST_ASSERTM(p.toLineProtocol() == "test key\\ " + String(i) + "=" + String(i) + "i", p.toLineProtocol());
+    }
+    TEST_ASSERTM(KeyCache::getCount() <= INFLUXDB_CLIENT_KEY_CACHE_SIZE, String(KeyCache::getCount()));
+    TEST_ASSERTM(KeyCache::getBytes() <= INFLUXDB_CLIENT_KEY_CACHE_BYTES, String(KeyCache::getBytes()));
+    point.clearFields();
+    point.addField(F("full,key"), 1);
+    point.addField("plain", 2);
+    TEST_ASSERTM(point.toLineProtocol() == "test,cached\\ key=a\\ b full\\,key=1i,plain=2i", point.toLineProtocol());
+    // key not fitting into the memory doesn't take an entry
+    KeyCache::clear();
+    String big;
+    for(int i = 0; i < 199; i++) {
+        big += 'k';
+    }
+    // keys of 201 bytes, which don't need escaping
+    for(int i = 10; i < 10 + INFLUXDB_CLIENT_KEY_CACHE_BYTES/201; i++) {
+        Point p("test");
+        p.addField(big + String(i), i);
+    }
+    count = KeyCache::getCount();
+    bytes = KeyCache::getBytes();
+    TEST_ASSERTM(count == INFLUXDB_CLIENT_KEY_CACHE_BYTES/201, String(count));
+    for(int i = 50; i < 70; i++) {
+        Point p("test");
+        p.addField(big + String(i), i);
+    }
+    TEST_ASSERTM(KeyCache::getCount() == count && KeyCache::getBytes() == bytes, String(KeyCache::getCount()) + "," + String(KeyCache::getBytes()));
+    // names given as String and converted to String are accepted
+    struct Name {
+        operator String() const { return "converted"; }
+    };
+    point.clearFields();
+    point.addTag(String("sum ") + "tag", String("v"));
+    point.addField(Name(), 1);
+    point.addField(String("sum ") + 1, 2.5, 1);
+    TEST_ASSERTM(point.toLineProtocol() == "test,cached\\ key=a\\ b,sum\\ tag=v converted=1i,sum\\ 1=2.5", point.toLineProtocol());
+    TEST_END();
+}
+
+void Test::testPointReset() {
+    TEST_INIT("testPointReset");
+    InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    client.setWriteOptions(WriteOptions().batchSize(100).bufferSize(100).writePrecision(WritePrecision::NS));
+    Point point("sensor");
+    point.addTag("location", "lab");
+    point.addField("temp", 20.5);
+    point.addField("hum", 40);
+    point.setTime(WritePrecision::S);
+    TEST_ASSERT(point.hasTime());
+    point.reset();
+    // measurement and tags are kept
+    TEST_ASSERT(!point.hasFields() && !point.hasTime() && point.hasTags());
+    TEST_ASSERTM(point.getTime() == "", point.getTime());
+    point.addField("temp", 21.5);
+    TEST_ASSERTM(point.toLineProtocol() == "sensor,location=lab temp=21.50", point.toLineProtocol());
+    point.setTime(1600000000ULL);
+    TEST_ASSERTM(point.toLineProtocol() == "sensor,location=lab temp=21.50 1600000000", point.toLineProtocol());
+    MemoryStats stats;
+    for(int i = 0; i < 20; i++) {
+        if(i == 2) {
+            // memory has grown to the size of a sample
+            stats = InfluxDBClient::getMemoryStats();
+        }
+        point.reset();
+        point.addField("temp", 20 + (i%10)*0.1);
+        point.addField("hum", 400 + i);
+        point.setTime(WritePrecision::S);
+        TEST_ASSERT(client.writePoint(point));
+        String line = point.toLineProtocol();
+        TEST_ASSERTM(line.startsWith("sensor,location=lab temp=2") && line.indexOf(",hum=" + String(400 + i) + "i ") > 0, line);
+        // zeroes were added to the seconds
+        TEST_ASSERTM(point.getTime().length() == 19, point.getTime());
+    }
+    MemoryStats after = InfluxDBClient::getMemoryStats();
+    TEST_ASSERTM(after.points.allocations == stats.points.allocations, String(after.points.allocations) + " vs " + String(stats.points.allocations));
+    TEST_ASSERTM(after.points.current == stats.points.current, String(after.points.current) + " vs " + String(stats.points.current));
+    // clearing fields releases memory
+    point.clearFields();
+    TEST_ASSERTM(InfluxDBClient::getMemoryStats().points.current < after.points.current, String(InfluxDBClient::getMemoryStats().points.current));
+    TEST_ASSERTM(point.toLineProtocol() == "sensor,location=lab", point.toLineProtocol());
+    TEST_END();
+}
+
+void Test::testSeriesPrefix() {
+    TEST_INIT("testSeriesPrefix");
+    InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    client.setWriteOptions(WriteOptions().batchSize(100).bufferSize(100).addDefaultTag("site", "office"));
+    Point point("sensor");
+    point.addTag("location", "lab");
+    point.addField("temp", 20.5);
+    MemoryStats stats = InfluxDBClient::getMemoryStats();
+    TEST_ASSERTM(client.pointToLineProtocol(point) == "sensor,site=office,location=lab temp=20.50", client.pointToLineProtocol(point));
+    TEST_ASSERTM(point.toLineProtocol() == "sensor,location=lab temp=20.50", point.toLineProtocol());
+    // printing doesn't keep the line in the point
+    TEST_ASSERTM(InfluxDBClient::getMemoryStats().points.current == stats.points.current, String(InfluxDBClient::getMemoryStats().points.current));
+    for(int i = 0; i < 10; i++) {
+        if(i == 2) {
+            stats = InfluxDBClient::getMemoryStats();
+        }
+        point.reset();
+        point.addField("temp", 20.5 + (i%5));
+        point.setTime(1600000000ULL + i);
+        TEST_ASSERT(client.writePoint(point));
+    }
+    // prefix is encoded once and the line is kept by the point
+    MemoryStats after = InfluxDBClient::getMemoryStats();
+    TEST_ASSERTM(after.points.allocations == stats.points.allocations, String(after.points.allocations) + " vs " + String(stats.points.allocations));
+    TEST_ASSERTM(client._writeBuffer[0]->pointer == 10, String(client._writeBuffer[0]->pointer));
+    const char *line = client._writeBuffer[0]->line(client._lineBuffer, 9);
+    TEST_ASSERTM(!strcmp(line, "sensor,site=office,location=lab temp=24.50 1600000009"), line);
+    // cached prefix is used for printing
+    TEST_ASSERTM(client.pointToLineProtocol(point) == line, client.pointToLineProtocol(point));
+    TEST_ASSERTM(point.toLineProtocol() == "sensor,location=lab temp=24.50 1600000009", point.toLineProtocol());
+    // changing tags rebuilds the prefix
+    point.addTag("floor", "2");
+    TEST_ASSERT(client.writePoint(point));
+    line = client._writeBuffer[0]->line(client._lineBuffer, 10);
+    TEST_ASSERTM(!strcmp(line, "sensor,site=office,location=lab,floor=2 temp=24.50 1600000009"), line);
+    // changing default tags rebuilds the prefix
+    client.setWriteOptions(WriteOptions().batchSize(100).bufferSize(100).addDefaultTag("site", "home"));
+    TEST_ASSERT(client.writePoint(point));
+    // changing options may reset the buffer, last line is checked
+    line = client._writeBuffer[0]->line(client._lineBuffer, client._writeBuffer[0]->pointer - 1);
+    TEST_ASSERTM(!strcmp(line, "sensor,site=home,location=lab,floor=2 temp=24.50 1600000009"), line);
+    client.setWriteOptions(WriteOptions().batchSize(100).bufferSize(100).clearDefaultTags());
+    point.clearTags();
+    TEST_ASSERT(client.writePoint(point));
+    line = client._writeBuffer[0]->line(client._lineBuffer, client._writeBuffer[0]->pointer - 1);
+    TEST_ASSERTM(!strcmp(line, "sensor temp=24.50 1600000009"), line);
+    // copies share the prefix
+    Point copy = point;
+    copy.addTag("location", "hall");
+    TEST_ASSERTM(client.pointToLineProtocol(point) == "sensor,location=hall temp=24.50 1600000009", client.pointToLineProtocol(point));
+    TEST_END();
+}
+
+void Test::testAsyncWriteFullSocket() {
+    TEST_INIT("testAsyncWriteFullSocket");
+    WiFiServer server(INFLUXDB_CLIENT_TESTING_SILENT_PORT);
+    server.begin();
+    InfluxDBClient client("http://127.0.0.1:" + String(INFLUXDB_CLIENT_TESTING_SILENT_PORT), Test::orgName, Test::bucketName, Test::token);
+    client.setWriteOptions(WriteOptions().batchSize(100).bufferSize(200).asyncWrite(10, 1000));
+    char line[200];
+    uint32_t maxTook = 0;
+    // batch is larger than socket buffers, sending stops when they are full
+    for(int i = 0; i < 100; i++) {
+        sprintf(line, "test1,tag=%0150d index=%di", i, i);
+        uint32_t start = millis();
+        TEST_ASSERTM(client.writeRecord(line), client.getLastErrorMessage());
+        uint32_t took = millis() - start;
+        if(took > maxTook) {
+            maxTook = took;
+        }
+    }
+    for(int i = 0; i < 20; i++) {
+        uint32_t start = millis();
+        client.poll();
+        uint32_t took = millis() - start;
+        if(took > maxTook) {
+            maxTook = took;
+        }
+    }
+    // each call works at most the budget, with margin for a slow device
+    TEST_ASSERTM(maxTook < 10 + 50, String(maxTook));
+    TEST_ASSERTM(client.getPendingWrites() == 1, String(client.getPendingWrites()));
+    server.end();
+    TEST_END();
+}
+
+void Test::testWriterTaskLatency() {
+    TEST_INIT("testWriterTaskLatency");
+    WiFiServer server(INFLUXDB_CLIENT_TESTING_SILENT_PORT);
+    server.begin();
+    // server doesn't accept, fill its backlog, so connecting waits the whole connect timeout
+    WiFiClient backlog[10];
+    int backlogCount = 0;
+    while(backlogCount < 10 && backlog[backlogCount].connect("127.0.0.1", INFLUXDB_CLIENT_TESTING_SILENT_PORT, 100)) {
+        backlogCount++;
+    }
+    TEST_ASSERTM(backlogCount < 10, String(backlogCount));
+    InfluxDBClient client("http://127.0.0.1:" + String(INFLUXDB_CLIENT_TESTING_SILENT_PORT), Test::orgName, Test::bucketName, Test::token);
+    const uint16_t connectTimeout = 1000;
+    client.setWriteOptions(WriteOptions().batchSize(10).bufferSize(1000).asyncWrite(10, connectTimeout));
+    TEST_ASSERTM(client.startWriterTask(16384, 1), client.getLastErrorMessage());
+    char line[50];
+    for(int i = 0; i < 10; i++) {
+        sprintf(line, "test1 index=%di", i);
+        TEST_ASSERT(client.writeRecord(line));
+    }
+    // task starts connecting
+    delay(50);
+    const int count = 200;
+    uint32_t totalQueued = 0, maxQueued = 0, maxStatus = 0;
+    uint32_t loopStart = millis();
+    for(int i = 0; i < count; i++) {
+        sprintf(line, "test1 index=%di", 10 + i);
+        uint32_t start = micros();
+        TEST_ASSERT(client.writeRecord(line));
+        uint32_t took = micros() - start;
+        totalQueued += took;
+        if(took > maxQueued) {
+            maxQueued = took;
+        }
+        // status is read while the task waits for the connection
+        start = micros();
+        bool empty = client.isBufferEmpty();
+        String error = client.getLastErrorMessage();
+        client.getRemainingRetryTime();
+        took = micros() - start;
+        TEST_ASSERT(!empty);
+        if(took > maxStatus) {
+            maxStatus = took;
+        }
+        delay(1);
+    }
+    // measured within a single connect
+    TEST_ASSERTM(millis() - loopStart < connectTimeout - 50, String(millis() - loopStart));
+    Serial.printf("  %d lines, task connecting %ums: enqueue avg %uus max %uus, status read max %uus\n", 
+        count, connectTimeout, totalQueued/count, maxQueued, maxStatus);
+    // neither writing nor reading status waits for the task, with margin for a slow device
+    TEST_ASSERTM(maxQueued < 50000, String(maxQueued));
+    TEST_ASSERTM(maxStatus < 50000, String(maxStatus));
+    TEST_ASSERT(client.getWriterQueueDropped() == 0);
+    client.stopWriterTask();
+    for(int i = 0; i < backlogCount; i++) {
+        backlog[i].stop();
+    }
+    server.end();
+    TEST_END();
+}
+
 void Test::testServerTempDownBatchsize5() {
     TEST_INIT("testServerTempDownBatchsize5");
     InfluxDBClient client;
@@ -2230,34 +4111,34 @@ void Test::testRetryInterval() {
     String rec = "test1,direction=permanent-set,x-code=502,SSID=bonitoo.io,device_name=ESP32,device_id=4272205360 temperature=28.60,humidity=86i,code=69i,door=false,status=\"failed\",index=0";
     TEST_ASSERT(!client.writeRecord(rec));
     TEST_ASSERT(!client.canSendRequest());
-    TEST_ASSERTM(client._retryTime == 2, String(client._retryTime));
+    TEST_ASSERTM(client._writeBuffer[0]->retryDelay == 2000, String(client._writeBuffer[0]->retryDelay));
     TEST_ASSERTM(client._writeBuffer[0]->retryCount == 1, String(client._writeBuffer[0]->retryCount));
     delay(2000);
     rec = "test1,direction=permanent-unset,SSID=bonitoo.io,device_name=ESP32,device_id=4272205360 temperature=28.60,humidity=86i,code=69i,door=false,status=\"failed\",index=2";
     TEST_ASSERT(!client.writeRecord(rec));
     TEST_ASSERT(!client.canSendRequest());
-    TEST_ASSERTM(client._retryTime == 4, String(client._retryTime));
+    TEST_ASSERTM(client._writeBuffer[0]->retryDelay == 4000, String(client._writeBuffer[0]->retryDelay));
     TEST_ASSERTM(client._writeBuffer[0]->retryCount == 2, String(client._writeBuffer[0]->retryCount));
     delay(4000);
     rec = "test1,SSID=bonitoo.io,device_name=ESP32,device_id=4272205360 temperature=28.60,humidity=86i,code=69i,door=false,status=\"failed\",index=3";
     TEST_ASSERT(!client.writeRecord(rec));
     TEST_ASSERT(!client.canSendRequest());
-    TEST_ASSERTM(client._retryTime == 8, String(client._retryTime));
+    TEST_ASSERTM(client._writeBuffer[0]->retryDelay == 8000, String(client._writeBuffer[0]->retryDelay));
     TEST_ASSERTM(client._writeBuffer[0]->retryCount == 3, String(client._writeBuffer[0]->retryCount));
     delay(8000);
     rec = "test1,SSID=bonitoo.io,device_name=ESP32,device_id=4272205360 temperature=28.60,humidity=86i,code=69i,door=false,status=\"failed\",index=4";
     TEST_ASSERT(!client.writeRecord(rec));
-    TEST_ASSERT(!client.canSendRequest());
-    TEST_ASSERTM(client._retryTime == 2, String(client._retryTime));
-    TEST_ASSERT(!client._writeBuffer[0]);
+    // dropped batch doesn't delay the next one
+    TEST_ASSERT(client.canSendRequest());
+    TEST_ASSERT(client.isBatchEmpty(0));
     TEST_ASSERTM(client._writeBuffer[1]->retryCount == 0, String(client._writeBuffer[1]->retryCount));
 
     delay(2000);
     rec = "test1,SSID=bonitoo.io,device_name=ESP32,device_id=4272205360 temperature=28.60,humidity=86i,code=69i,door=false,status=\"failed\",index=5";
     TEST_ASSERT(!client.writeRecord(rec));
     TEST_ASSERT(!client.canSendRequest());
-    TEST_ASSERTM(client._retryTime == 2, String(client._retryTime));
-    TEST_ASSERT(!client._writeBuffer[0]);
+    TEST_ASSERTM(client._writeBuffer[1]->retryDelay == 2000, String(client._writeBuffer[1]->retryDelay));
+    TEST_ASSERT(client.isBatchEmpty(0));
     TEST_ASSERTM(client._writeBuffer[1]->retryCount == 1, String(client._writeBuffer[1]->retryCount));
 
     delay(2000);
@@ -2274,6 +4155,75 @@ void Test::testRetryInterval() {
     deleteAll(Test::apiUrl);
 }
 
+void Test::testRetryBackoff() {
+    TEST_INIT("testRetryBackoff");
+    InfluxDBClient client(INFLUXDB_CLIENT_TESTING_BAD_URL, Test::orgName, Test::bucketName, Test::token);
+    client.setHTTPOptions(HTTPOptions().httpReadTimeout(500));
+    WriteOptions wo = WriteOptions().batchSize(2).bufferSize(10).retryInterval(5).maxRetryInterval(300);
+    // by default the interval is multiplied by itself, without jitter, as in previous versions
+    client.setWriteOptions(wo);
+    TEST_ASSERTM(client.getRetryDelay(1) == 5000, String(client.getRetryDelay(1)));
+    TEST_ASSERTM(client.getRetryDelay(2) == 25000, String(client.getRetryDelay(2)));
+    TEST_ASSERTM(client.getRetryDelay(3) == 125000, String(client.getRetryDelay(3)));
+    TEST_ASSERTM(client.getRetryDelay(4) == 300000, String(client.getRetryDelay(4)));
+    client.setWriteOptions(wo.retryBackoff(2, false));
+    // exponential, capped by max retry interval
+    TEST_ASSERTM(client.getRetryDelay(1) == 5000, String(client.getRetryDelay(1)));
+    TEST_ASSERTM(client.getRetryDelay(2) == 10000, String(client.getRetryDelay(2)));
+    TEST_ASSERTM(client.getRetryDelay(3) == 20000, String(client.getRetryDelay(3)));
+    TEST_ASSERTM(client.getRetryDelay(6) == 160000, String(client.getRetryDelay(6)));
+    TEST_ASSERTM(client.getRetryDelay(7) == 300000, String(client.getRetryDelay(7)));
+    TEST_ASSERTM(client.getRetryDelay(255) == 300000, String(client.getRetryDelay(255)));
+    client.setWriteOptions(wo.retryBackoff(1, false));
+    TEST_ASSERTM(client.getRetryDelay(5) == 5000, String(client.getRetryDelay(5)));
+    // full jitter spreads retries between zero and the backoff
+    client.setWriteOptions(wo.retryBackoff(2, true));
+    uint32_t first = client.getRetryDelay(3);
+    bool differs = false;
+    for(int i = 0; i < 50; i++) {
+        uint32_t d = client.getRetryDelay(3);
+        TEST_ASSERTM(d <= 20000, String(d));
+        differs = differs || d != first;
+    }
+    TEST_ASSERT(differs);
+
+    client.setWriteOptions(wo.retryBackoff(2, false));
+    char line[50];
+    for (int i = 0; i < 4; i++) {
+        sprintf(line, "test1,tag=a index=%03di", i);
+        TEST_ASSERT(client.bufferRecord(line, strlen(line)));
+    }
+    // failure pauses all writes
+    TEST_ASSERT(client.handleWriteResult(0, 500));
+    TEST_ASSERTM(client._writeBuffer[0]->retryDelay == 5000, String(client._writeBuffer[0]->retryDelay));
+    TEST_ASSERTM(client.getWritePauseRemaining() > 4900, String(client.getWritePauseRemaining()));
+    TEST_ASSERTM(client.getRemainingRetryTime() == 5, String(client.getRemainingRetryTime()));
+    TEST_ASSERT(!client.canSendRequest());
+    // until another batch is written, then the failed batch waits on its own
+    TEST_ASSERT(!client.handleWriteResult(1, 204));
+    TEST_ASSERTM(client.getWritePauseRemaining() == 0, String(client.getWritePauseRemaining()));
+    TEST_ASSERTM(client.nextBatchToWrite() == -1, String(client.nextBatchToWrite()));
+    // it is the oldest one, so it is written first in synchronous mode
+    TEST_ASSERTM(client.getRemainingRetryTime() == 5, String(client.getRemainingRetryTime()));
+    for (int i = 4; i < 6; i++) {
+        sprintf(line, "test1,tag=a index=%03di", i);
+        TEST_ASSERT(client.bufferRecord(line, strlen(line)));
+    }
+    TEST_ASSERTM(client.nextBatchToWrite() == 2, String(client.nextBatchToWrite()));
+    // wait requested by server is not canceled by a successful write
+    TEST_ASSERT(client.handleWriteResult(0, 503));
+    TEST_ASSERTM(client._writeBuffer[0]->retryDelay == 10000, String(client._writeBuffer[0]->retryDelay));
+    TEST_ASSERT(client.handleWriteResult(0, 429, 20));
+    TEST_ASSERTM(client._writeBuffer[0]->retryDelay == 20000, String(client._writeBuffer[0]->retryDelay));
+    TEST_ASSERT(!client.handleWriteResult(2, 204));
+    TEST_ASSERTM(client.getWritePauseRemaining() > 19000, String(client.getWritePauseRemaining()));
+    // queries are not blocked by retrying of writes
+    FluxQueryResult q = client.query("select");
+    TEST_ASSERTM(q.getError().indexOf("retry strategy") < 0, q.getError());
+    q.close();
+    TEST_END();
+}
+
 void Test::testDefaultTags() {
     TEST_INIT("testDefaultTags");
 
@@ -2517,7 +4467,7 @@ void Test::testNonRetry() {
     client->setWriteOptions(wo);
     client->setHTTPOptions(HTTPOptions().connectionReuse(true));
     TEST_ASSERT(!client->writeRecord(lines[0]));
-    TEST_ASSERT(!client->_writeBuffer[0]);
+    TEST_ASSERT(client->isBatchEmpty(0));
 
     TEST_ASSERT(waitServer(Test::managementUrl, true));
     TEST_ASSERT(client->validateConnection());
@@ -2585,6 +4535,283 @@ void Test::testLargeBatch() {
     deleteAll(Test::apiUrl);
 }
 
+void Test::testWriteCompression() {
+    TEST_INIT("testWriteCompression");
+    TEST_ASSERT(waitServer(Test::managementUrl, true));
+    InfluxDBClient client(Test::apiUrl, Test::orgName, Test::bucketName, Test::token);
+    client.setWriteOptions(WriteOptions().batchSize(50).bufferSize(100).compression(Compression::Gzip));
+    TEST_ASSERT(client.validateConnection());
+    for (int i = 0; i < 120; i++) {
+        Point *p = createPoint("test1");
+        p->addField("index", i);
+        TEST_ASSERTM(client.writePoint(*p), client.getLastErrorMessage());
+        delete p;
+    }
+    TEST_ASSERTM(client.flushBuffer(), client.getLastErrorMessage());
+    TEST_ASSERT(client.isBufferEmpty());
+    // server inflates and verifies the body
+    String url = String(Test::apiUrl) + "/test/content-encoding";
+    WiFiClient wifiClient;
+    HTTPClient http;
+    TEST_ASSERT(http.begin(wifiClient, url));
+    TEST_ASSERT(http.GET() == 200);
+    String encoding = http.getString();
+    TEST_ASSERTM(encoding == "gzip", encoding);
+    http.end();
+    TEST_ASSERT(http.begin(wifiClient, String(Test::apiUrl) + "/test/query-http-version"));
+    TEST_ASSERT(http.GET() == 200);
+    String version = http.getString();
+#if defined(INFLUXDB_CLIENT_HTTP_ACCEPT_ENCODING)
+    TEST_ASSERTM(version == "1.1", version);
+#else
+    TEST_ASSERTM(version == "1.0", version);
+#endif
+    http.end();
+
+    String query = "select";
+    FluxQueryResult q = client.query(query);
+    int count = countLines(q);
+    TEST_ASSERTM(q.getError()=="", q.getError());
+    TEST_ASSERTM(count == 120, String(count));
+    TEST_END();
+    deleteAll(Test::apiUrl);
+}
+
+void Test::testQueryCompression(bool chunked) {
+    TEST_INIT("testQueryCompression");
+    TEST_ASSERT(waitServer(Test::managementUrl, true));
+    InfluxDBClient client(Test::apiUrl, Test::orgName, Test::bucketName, Test::token);
+    client.setHTTPOptions(HTTPOptions().queryCompression(Compression::Gzip));
+    if(chunked) {
+        String record = "a,direction=chunked a=1";
+        client.writeRecord(record);
+    }
+    FluxQueryResult flux = client.query("testquery-multiTables");
+    int count = 0;
+    while(flux.next()) {
+        count++;
+    }
+    TEST_ASSERTM(flux.getError() == "", flux.getError());
+    TEST_ASSERTM(count == 8, String(count));
+    flux.close();
+
+    String url = String(Test::apiUrl) + "/test/accept-encoding";
+    WiFiClient wifiClient;
+    HTTPClient http;
+    TEST_ASSERT(http.begin(wifiClient, url));
+    TEST_ASSERT(http.GET() == 200);
+    String encoding = http.getString();
+    TEST_ASSERTM(encoding == "gzip", encoding);
+    http.end();
+
+    // error response is compressed as well
+    flux = client.query("testquery-flux-error");
+    TEST_ASSERT(!flux.next());
+    TEST_ASSERTM(flux.getError() == "{\"code\":\"invalid\",\"message\":\"compilation failed: loc 4:17-4:86: expected an operator between two expressions\"}", flux.getError());
+    flux.close();
+    TEST_END();
+    deleteAll(Test::apiUrl);
+}
+
+void Test::testAsyncWrite() {
+    TEST_INIT("testAsyncWrite");
+    TEST_ASSERT(waitServer(Test::managementUrl, true));
+    InfluxDBClient client(Test::apiUrl, Test::orgName, Test::bucketName, Test::token);
+    client.setHTTPOptions(HTTPOptions().connectionReuse(true));
+    client.setWriteOptions(WriteOptions().batchSize(1).bufferSize(20).asyncWrite(20, 2000));
+    TEST_ASSERT(client.validateConnection());
+    // server replies after 1s
+    uint32_t start = millis();
+    TEST_ASSERTM(client.writeRecord("test1,direction=slow,delay=1000 a=1"), client.getLastErrorMessage());
+    for (int i = 0; i < 10; i++) {
+        Point *p = createPoint("test1");
+        p->addField("index", i);
+        TEST_ASSERTM(client.writePoint(*p), client.getLastErrorMessage());
+        delete p;
+    }
+    // writing doesn't wait for the response
+    uint32_t time = millis() - start;
+    TEST_ASSERTM(time < 500, String(time));
+    TEST_ASSERT(!client.isBufferEmpty());
+    TEST_ASSERT(client.getPendingWrites() == 1);
+    int polls = 0;
+    while(!client.isBufferEmpty() && polls < 1000) {
+        TEST_ASSERTM(client.poll(), client.getLastErrorMessage());
+        polls++;
+        delay(10);
+    }
+    TEST_ASSERT(client.isBufferEmpty());
+    TEST_ASSERT(client.getPendingWrites() == 0);
+    time = millis() - start;
+    TEST_ASSERTM(time >= 1000, String(time));
+
+    // flush waits for pending write
+    for (int i = 0; i < 5; i++) {
+        Point *p = createPoint("test1");
+        p->addField("index", 10 + i);
+        TEST_ASSERTM(client.writePoint(*p), client.getLastErrorMessage());
+        delete p;
+    }
+    TEST_ASSERTM(client.flushBuffer(), client.getLastErrorMessage());
+    TEST_ASSERT(client.isBufferEmpty());
+
+    String query = "select";
+    FluxQueryResult q = client.query(query);
+    int count = countLines(q);
+    TEST_ASSERTM(q.getError()=="", q.getError());
+    TEST_ASSERTM(count == 15, String(count));
+
+    // write error is reported by poll
+    client.setWriteOptions(WriteOptions().batchSize(1).bufferSize(20).asyncWrite(20, 2000).maxRetryAttempts(0));
+    TEST_ASSERT(client.writeRecord("test1,direction=status,x-code=400 a=1"));
+    polls = 0;
+    bool success = true;
+    while(!client.isBufferEmpty() && polls < 1000) {
+        success = client.poll() && success;
+        polls++;
+        delay(10);
+    }
+    TEST_ASSERT(!success);
+    TEST_ASSERTM(client.getLastStatusCode() == 400, String(client.getLastStatusCode()));
+    TEST_ASSERTM(client.getLastErrorMessage() == "bad request", client.getLastErrorMessage());
+    TEST_END();
+    deleteAll(Test::apiUrl);
+}
+
+void Test::testWriterTask() {
+    TEST_INIT("testWriterTask");
+    TEST_ASSERT(waitServer(Test::managementUrl, true));
+    InfluxDBClient client(Test::apiUrl, Test::orgName, Test::bucketName, Test::token);
+    client.setHTTPOptions(HTTPOptions().connectionReuse(true));
+    client.setWriteOptions(WriteOptions().batchSize(10).bufferSize(100));
+    TEST_ASSERT(client.validateConnection());
+    const int count = 100;
+    // inline writing for comparison
+    uint32_t maxInline = 0, totalInline = 0;
+    for (int i = 0; i < count; i++) {
+        Point *p = createPoint("test1");
+        p->addField("index", i);
+        uint32_t start = micros();
+        TEST_ASSERTM(client.writePoint(*p), client.getLastErrorMessage());
+        uint32_t took = micros() - start;
+        delete p;
+        totalInline += took;
+        if(took > maxInline) {
+            maxInline = took;
+        }
+    }
+    TEST_ASSERTM(client.flushBuffer(), client.getLastErrorMessage());
+
+    TEST_ASSERTM(client.startWriterTask(4096, 10), client.getLastErrorMessage());
+    TEST_ASSERT(client.isWriterTaskRunning());
+    // server replies after 500ms, which doesn't block writing
+    TEST_ASSERT(client.writeRecord("test1,direction=slow,delay=500 a=1"));
+    uint32_t maxQueued = 0, totalQueued = 0;
+    for (int i = 0; i < count; i++) {
+        Point *p = createPoint("test1");
+        p->addField("index", count + i);
+        uint32_t start = micros();
+        TEST_ASSERT(client.writePoint(*p));
+        uint32_t took = micros() - start;
+        delete p;
+        totalQueued += took;
+        if(took > maxQueued) {
+            maxQueued = took;
+        }
+        delay(1);
+    }
+    Serial.printf("  enqueue latency: inline avg %uus max %uus, writer task avg %uus max %uus\n", 
+        totalInline/count, maxInline, totalQueued/count, maxQueued);
+    TEST_ASSERTM(maxQueued < 100000, String(maxQueued));
+    TEST_ASSERT(client.getWriterQueueDropped() == 0);
+    // checkBuffer is done by the task
+    TEST_ASSERT(client.checkBuffer());
+    TEST_ASSERTM(client.flushBuffer(), client.getLastErrorMessage());
+    TEST_ASSERT(client.isBufferEmpty());
+
+    // query uses its own connection, the task keeps running
+    FluxQueryResult q = client.query("select");
+    int lines = countLines(q);
+    TEST_ASSERTM(q.getError()=="", q.getError());
+    // the slow direction line is not stored
+    TEST_ASSERTM(lines == 2*count, String(lines));
+
+    // lines remaining in the queue are kept in the buffer
+    client.stopWriterTask();
+    TEST_ASSERT(!client.isWriterTaskRunning());
+    TEST_ASSERTM(client.writeRecord("test1,direction=slow,delay=500 a=2"), client.getLastErrorMessage());
+    TEST_ASSERTM(client.startWriterTask(64, 1000), client.getLastErrorMessage());
+    TEST_ASSERT(client.writeRecord("test1 a=3"));
+    // queue full
+    TEST_ASSERT(!client.writeRecord("test1,tag=too_long_for_the_queue_full_of_the_previous_line a=4"));
+    TEST_ASSERT(client.getWriterQueueDropped() == 1);
+    client.stopWriterTask();
+    TEST_ASSERT(client.getWriterQueueDropped() == 0);
+    TEST_ASSERT(!client.isBufferEmpty());
+    TEST_ASSERTM(client.flushBuffer(), client.getLastErrorMessage());
+    q = client.query("select");
+    lines = countLines(q);
+    TEST_ASSERTM(lines == 2*count + 1, String(lines));
+    TEST_END();
+    deleteAll(Test::apiUrl);
+}
+
+void Test::testPipelinedWrites() {
+    TEST_INIT("testPipelinedWrites");
+    TEST_ASSERT(waitServer(Test::managementUrl, true));
+    InfluxDBClient client(Test::apiUrl, Test::orgName, Test::bucketName, Test::token);
+    client.setHTTPOptions(HTTPOptions().connectionReuse(true));
+    client.setWriteOptions(WriteOptions().batchSize(5).bufferSize(50).asyncWrite(20, 2000).maxInFlight(3));
+    TEST_ASSERT(client.validateConnection());
+    uint32_t start = millis();
+    // server replies to the first batch after 1s, next batches are written meanwhile
+    TEST_ASSERTM(client.writeRecord("test1,direction=slow,delay=1000 a=1"), client.getLastErrorMessage());
+    for (int i = 0; i < 14; i++) {
+        Point *p = createPoint("test1");
+        p->addField("index", i);
+        TEST_ASSERTM(client.writePoint(*p), client.getLastErrorMessage());
+        delete p;
+    }
+    TEST_ASSERT(client.getPendingWrites() > 0);
+    int polls = 0;
+    while(client.getPendingWrites() > 1 && polls < 500) {
+        TEST_ASSERTM(client.poll(), client.getLastErrorMessage());
+        polls++;
+        delay(1);
+    }
+    // later batches are acknowledged, the first one is still in the buffer
+    TEST_ASSERTM(client.getPendingWrites() == 1, String(client.getPendingWrites()));
+    TEST_ASSERTM(client._bufferedPoints == 5, String(client._bufferedPoints));
+    TEST_ASSERT(client._batchPointer == 0);
+    while(!client.isBufferEmpty() && polls < 1000) {
+        TEST_ASSERTM(client.poll(), client.getLastErrorMessage());
+        polls++;
+        delay(10);
+    }
+    TEST_ASSERT(client.isBufferEmpty());
+    uint32_t time = millis() - start;
+    TEST_ASSERTM(time >= 1000, String(time));
+
+    // synchronous flushing writes batches at once too
+    client.setWriteOptions(WriteOptions().batchSize(5).bufferSize(50).maxInFlight(3));
+    for (int i = 0; i < 12; i++) {
+        Point *p = createPoint("test1");
+        p->addField("index", 14 + i);
+        TEST_ASSERTM(client.writePoint(*p), client.getLastErrorMessage());
+        delete p;
+    }
+    TEST_ASSERTM(client.flushBuffer(), client.getLastErrorMessage());
+    TEST_ASSERT(client.isBufferEmpty());
+
+    // slow direction line is not stored
+    FluxQueryResult q = client.query("select");
+    int count = countLines(q);
+    TEST_ASSERTM(q.getError()=="", q.getError());
+    TEST_ASSERTM(count == 26, String(count));
+    TEST_END();
+    deleteAll(Test::apiUrl);
+}
+
 void Test::testQueryWithParams() {
     TEST_INIT("testQueryWithParams");
     TEST_ASSERT(waitServer(Test::managementUrl, true));
@@ -2609,3 +4836,30 @@ void Test::setServerUrl(InfluxDBClient &client, String serverUrl) {
     client._service->_apiURL = serverUrl + "/api/v2/";
     client.setUrls();
 }
+
+bool Test::checkBatchLists(InfluxDBClient &client) {
+    // each non-empty batch is linked once, in the order of sequence, in the list of its priority
+    uint32_t linked = 0, bytes = 0;
+    for(int p=0;p<3;p++) {
+        InfluxDBClient::Batch *older = nullptr;
+        for(InfluxDBClient::Batch *batch = client._oldestBatches[p]; batch; batch = batch->newer) {
+            if(batch->isEmpty() || (uint8_t)batch->priority != p || batch->older != older || client._writeBuffer[batch->index] != batch
+                || (older && (int32_t)(batch->sequence - older->sequence) <= 0)) {
+                return false;
+            }
+            linked++;
+            bytes += batch->dataLength();
+            older = batch;
+        }
+        if(client._newestBatches[p] != older) {
+            return false;
+        }
+    }
+    uint32_t nonEmpty = 0;
+    for(int i=0;i<client._writeBufferSize;i++) {
+        if(!client.isBatchEmpty(i)) {
+            nonEmpty++;
+        }
+    }
+    return linked == nonEmpty && linked == client._linkedBatches && bytes == client._bufferedBytes;
+}
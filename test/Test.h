@@ -36,6 +36,7 @@ public:
     static void run();
 private: //helpers
     static void setServerUrl(InfluxDBClient &client, String serverUrl);
+    static bool checkBatchLists(InfluxDBClient &client);
 private: // tests
     static void testUtils();
     static void testOptions();
@@ -43,6 +44,12 @@ private: // tests
     static void testPoint();
     static void testOldAPI();
     static void testBatch();
+    static void testWriteBuffer();
+    static void testBatchPerformance();
+    static void testGzipStream();
+    static void testGunzipStream();
+    static void testLineQueue();
+    static void testLineQueueProducers();
     static void testLineProtocol();
     static void testUseServerTimestamp();
     static void testFluxTypes();
@@ -68,9 +75,27 @@ private: // tests
     static void testRetryOnFailedConnectionWithFlush();
     static void testBufferOverwriteBatchsize1();
     static void testBufferOverwriteBatchsize5();
+    static void testBufferBytes();
+    static void testFlushBytes();
+    static void testAdaptiveBatchSize();
+    static void testPriorityLanes();
+    static void testOverflowPolicy();
+    static void testAggregation();
+    static void testChangeFilter();
+    static void testFanOut();
+    static void testBucketRouting();
+    static void testMemoryStats();
+    static void testPointSchema();
+    static void testNumberFormat();
+    static void testKeyCache();
+    static void testPointReset();
+    static void testSeriesPrefix();
+    static void testAsyncWriteFullSocket();
+    static void testWriterTaskLatency();
     static void testServerTempDownBatchsize5();
     static void testRetriesOnServerOverload();
     static void testRetryInterval();
+    static void testRetryBackoff();
     static void testDefaultTags();
     static void testUrlEncode();
     static void testRepeatedInit();
@@ -80,6 +105,12 @@ private: // tests
     static void testFlushing();
     static void testNonRetry();
     static void testLargeBatch();
+    static void testWriteCompression();
+    static void testQueryCompression(bool chunked);
+    static void testAsyncWrite();
+    static void testWriterTask();
+    static void testPipelinedWrites();
+    static void testConcurrentWrites();
     static void testQueryWithParams();
 };
 
@@ -62,4 +62,19 @@ bool compareTm(tm &tm1, tm &tm2);
 // Waits for server in desired state (up - true, down - false)
 bool waitServer(const String &url, bool state);
 
+// Stream reading bytes from memory buffer
+class MemoryStream : public Stream {
+  public:
+    MemoryStream(const uint8_t *data, size_t size):_data(data),_size(size) {}
+    virtual int available() override { return _size - _pos; }
+    virtual int read() override { return _pos < _size ? _data[_pos++] : -1; }
+    virtual int peek() override { return _pos < _size ? _data[_pos] : -1; }
+    virtual void flush() override {}
+    virtual size_t write(uint8_t) override { return 0; }
+  private:
+    const uint8_t *_data;
+    size_t _size;
+    size_t _pos = 0;
+};
+
 #endif //_TEST_SUPPORT_H_
@@ -1,5 +1,6 @@
 const express = require('express');
 const readline = require('readline');
+const zlib = require('zlib');
 var os = require('os');
 const e = require('express');
 
@@ -9,8 +10,12 @@ const port = 999;
 const mgmtPort = 998;
 var pointsdb = []; 
 var lastUserAgent = '';
+var lastContentEncoding = '';
+var lastAcceptEncoding = '';
+var lastQueryHttpVersion = '';
 var chunked = false;
 var delay = 0;
+var responseDelay = 0;
 var permanentError = 0;
 const prefix = '';
 var server = undefined;
@@ -72,20 +77,43 @@ mgmtApp.post('/log', (req,res) => {
 
 
 app.use (function(req, res, next) {
-    var data='';
-    req.setEncoding('utf8');
+    var chunks=[];
     req.on('data', function(chunk) { 
-       data += chunk;
+       chunks.push(chunk);
     });
 
     req.on('end', function() {
-        req.body = data;
+        var data = Buffer.concat(chunks);
+        var encoding = req.get('Content-Encoding');
+        if(encoding === 'gzip') {
+            try {
+                // verifies also CRC and size
+                data = zlib.gunzipSync(data);
+            } catch(err) {
+                console.log('Invalid gzip body: ' + err);
+                res.status(400).send('invalid gzip body: ' + err);
+                return;
+            }
+        }
+        if(req.method === 'POST') {
+            lastContentEncoding = encoding ? encoding : '';
+        }
+        req.body = data.toString('utf8');
         next();
     });
 });
 app.get(prefix + '/test/user-agent', (req,res) => {
     res.status(200).send(lastUserAgent);
 })
+app.get(prefix + '/test/content-encoding', (req,res) => {
+    res.status(200).send(lastContentEncoding);
+})
+app.get(prefix + '/test/accept-encoding', (req,res) => {
+    res.status(200).send(lastAcceptEncoding);
+})
+app.get(prefix + '/test/query-http-version', (req,res) => {
+    res.status(200).send(lastQueryHttpVersion);
+})
 app.get(prefix + '/ready', (req,res) => {
     lastUserAgent = req.get('User-Agent');
     res.status(200).send("<html><body><h1>OK</h1></body></html>");
@@ -169,6 +197,11 @@ app.post(prefix + '/api/v2/write', (req,res) => {
                             console.log("Set permanentError: " + permanentError);
                             res.status(permanentError).send("bad request");
                             break;
+                        case 'slow':
+                            // respond later, without blocking other requests
+                            responseDelay = parseInt(point.tags.delay);
+                            console.log("Set response delay: " + responseDelay);
+                            break;
                         case 'check-precision':
                             const precision = req.query['precision'];
                             if(precision !== point.tags['precision'] && !(!precision && point.tags['precision']=='no')) {
@@ -185,7 +218,12 @@ app.post(prefix + '/api/v2/write', (req,res) => {
                 pointsdb.push(item);
             })
             if(res.statusCode < 299) {
-                res.status(204).end();  
+                if(responseDelay) {
+                    setTimeout(() => res.status(204).end(), responseDelay);
+                    responseDelay = 0;
+                } else {
+                    res.status(204).end();  
+                }
             }
         } else {
             res.status(204).end();
@@ -349,20 +387,29 @@ app.post(prefix+'/api/v2/query', (req,res) => {
             console.log('query: ' + pointsdb.length + ' points');
             data = convertToCSV(pointsdb);
         }
+        lastAcceptEncoding = req.get('Accept-Encoding') || '';
+        lastQueryHttpVersion = req.httpVersion;
         if(data.length > 0) {
             if(delay) {
                 sleep(delay);
                 delay = 0;
             }
             //console.log(data);
+            if(lastAcceptEncoding.split(',')[0].trim() === 'gzip') {
+                // compressed-response mode, like InfluxDB, consider only the first encoding
+                data = zlib.gzipSync(data);
+                res.set("Content-Encoding","gzip");
+                res.set("Content-Type","text/csv; charset=utf-8");
+            }
 
             if(chunked) {
                 var i = data.length/3;
                 res.set("Transfer-Encoding","chunked");
                 res.status(status);
-                res.write(data.substring(0, i+1));
-                res.write(data.substring(i+1, 2*i+1));
-                res.write(data.substring(2*i+1));
+                // slice works for both string and compressed buffer
+                res.write(data.slice(0, Math.floor(i+1)));
+                res.write(data.slice(Math.floor(i+1), Math.floor(2*i+1)));
+                res.write(data.slice(Math.floor(2*i+1)));
                 res.end();
                 chunked = false;
             } else {